@@ -3,22 +3,28 @@
 
 #include "AI/EnvQueryGenerator_CoverPoints.h"
 
+#include "AI/EnvQueryItemType_CoverPoint.h"
 #include "CoverRecastNavMesh.h"
 #include "CoverSystemStatics.h"
 #include "NavigationSystem.h"
 #include "EnvironmentQuery/Contexts/EnvQueryContext_Querier.h"
-#include "EnvironmentQuery/Items/EnvQueryItemType_Point.h"
 
 #define LOCTEXT_NAMESPACE "EnvQueryGenerator"
 
 UEnvQueryGenerator_CoverPoints::UEnvQueryGenerator_CoverPoints()
 	: Super()
 {
-	ItemType = UEnvQueryItemType_Point::StaticClass();
+	ItemType = UEnvQueryItemType_CoverPoint::StaticClass();
 	SearchRadius.DefaultValue = 1000.0f;
 	SearchCenter = UEnvQueryContext_Querier::StaticClass();
+	MaxItems.DefaultValue = 0;
+	SortMode = ECoverPointSortMode::None;
+	bExcludeReservedCover = true;
 }
 
+// first search radius of ECoverPointSortMode::Distance as a fraction of SearchRadius, doubled until enough cover points are found
+static const float DistanceSortInitialRadiusFraction = 0.125f;
+
 void UEnvQueryGenerator_CoverPoints::GenerateItems(FEnvQueryInstance& QueryInstance) const
 {
 	//do not call super - checkNoEntry
@@ -44,11 +50,13 @@ void UEnvQueryGenerator_CoverPoints::GenerateItems(FEnvQueryInstance& QueryInsta
 
 	SearchRadius.BindData(QueryOwner, QueryInstance.QueryID);
 	const float RadiusValue = SearchRadius.GetValue();
+	MaxItems.BindData(QueryOwner, QueryInstance.QueryID);
+	const int32 MaxItemsValue = MaxItems.GetValue() > 0 ? MaxItems.GetValue() : MAX_int32;
 	
 	TArray<AActor*> ContextActors;
 	QueryInstance.PrepareContext(SearchCenter, ContextActors);
 
-	TArray<FVector> MatchingCoverPoints;
+	TArray<TPair<FVector, const ACoverRecastNavMesh*>> Centers;
 	for (int32 ContextIndex = 0; ContextIndex < ContextActors.Num(); ++ContextIndex)
 	{
 		INavAgentInterface* NavAgent = Cast<INavAgentInterface>(ContextActors[ContextIndex]);
@@ -60,13 +68,106 @@ void UEnvQueryGenerator_CoverPoints::GenerateItems(FEnvQueryInstance& QueryInsta
 	
 		if (const ACoverRecastNavMesh* NavData = UCoverSystemStatics::FindNavigationData<ACoverRecastNavMesh>(*NavSys, NavAgent))
 		{
-			FSphere QuerySphere(ContextActors[ContextIndex]->GetActorLocation(), RadiusValue);
-			NavData->FindCoverPoints(QuerySphere, MatchingCoverPoints);
+			Centers.Emplace(ContextActors[ContextIndex]->GetActorLocation(), NavData);
+		}
+	}
+
+	// search centers close to each other find the same cover points, they are deduplicated by location since handles are per navmesh
+	TSet<FVector> FoundLocations;
+	TArray<FCoverPointOctreeElement> MatchingCoverPoints;
+	auto GatherCoverPointsLambda = [&](const float Radius)
+	{
+		for (const TPair<FVector, const ACoverRecastNavMesh*>& Center : Centers)
+		{
+			Center.Value->ForEachCoverPoint(FSphere(Center.Key, Radius), [&](const FCoverPointOctreeElement& CoverPoint)
+			{
+				if (bExcludeReservedCover && Center.Value->IsCoverAreaReserved(CoverPoint.Data->Location, QueryOwner))
+				{
+					INC_DWORD_STAT(STAT_CoverReservationsPrefiltered);
+					return true;
+				}
+
+				bool bAlreadyFound = false;
+				FoundLocations.Add(CoverPoint.Data->Location, &bAlreadyFound);
+				if (!bAlreadyFound)
+				{
+					MatchingCoverPoints.Add(CoverPoint);
+				}
+
+				// without sorting any cover points will do
+				return SortMode != ECoverPointSortMode::None || MatchingCoverPoints.Num() < MaxItemsValue;
+			});
+
+			if (SortMode == ECoverPointSortMode::None && MatchingCoverPoints.Num() >= MaxItemsValue)
+				return;
+		}
+	};
+
+	if (SortMode == ECoverPointSortMode::Distance && MaxItemsValue < MAX_int32)
+	{
+		// once the search holds MaxItems cover points, the nearest MaxItems are all inside it
+		float Radius = RadiusValue * DistanceSortInitialRadiusFraction;
+		while (true)
+		{
+			Radius = FMath::Min(Radius, RadiusValue);
+			GatherCoverPointsLambda(Radius);
+			if (MatchingCoverPoints.Num() >= MaxItemsValue || Radius >= RadiusValue)
+				break;
+
+			Radius *= 2.0f;
+		}
+	}
+	else
+	{
+		GatherCoverPointsLambda(RadiusValue);
+	}
+
+	if (SortMode != ECoverPointSortMode::None)
+	{
+		struct FSortKey
+		{
+			bool bCrouchCover;
+			float DistanceSq;
+			int32 CoverPointIdx;
+		};
+
+		// compute the keys once instead of in every comparison
+		TArray<FSortKey> SortKeys;
+		SortKeys.Reserve(MatchingCoverPoints.Num());
+		for (int32 CoverPointIdx = 0; CoverPointIdx < MatchingCoverPoints.Num(); ++CoverPointIdx)
+		{
+			const FCoverPointOctreeData& CoverPointData = *MatchingCoverPoints[CoverPointIdx].Data;
+			float DistanceSq = MAX_flt;
+			for (const TPair<FVector, const ACoverRecastNavMesh*>& Center : Centers)
+			{
+				DistanceSq = FMath::Min(DistanceSq, FVector::DistSquared(Center.Key, CoverPointData.Location));
+			}
+
+			const bool bCrouchCover = SortMode == ECoverPointSortMode::CoverHeight && CoverPointData.Metadata.Height != ECoverHeight::Standing;
+			SortKeys.Add({ bCrouchCover, DistanceSq, CoverPointIdx });
+		}
+
+		SortKeys.Sort([](const FSortKey& A, const FSortKey& B)
+		{
+			return A.bCrouchCover != B.bCrouchCover ? B.bCrouchCover : A.DistanceSq < B.DistanceSq;
+		});
+
+		TArray<FCoverPointOctreeElement> SortedCoverPoints;
+		SortedCoverPoints.Reserve(FMath::Min(SortKeys.Num(), MaxItemsValue));
+		for (int32 KeyIdx = 0; KeyIdx < SortKeys.Num() && KeyIdx < MaxItemsValue; ++KeyIdx)
+		{
+			SortedCoverPoints.Add(MatchingCoverPoints[SortKeys[KeyIdx].CoverPointIdx]);
 		}
+
+		MatchingCoverPoints = MoveTemp(SortedCoverPoints);
+	}
+	else if (MatchingCoverPoints.Num() > MaxItemsValue)
+	{
+		MatchingCoverPoints.SetNum(MaxItemsValue);
 	}
 	
 	ProcessItems(QueryInstance, MatchingCoverPoints);
-	QueryInstance.AddItemData<UEnvQueryItemType_Point>(MatchingCoverPoints);
+	QueryInstance.AddItemData<UEnvQueryItemType_CoverPoint>(MatchingCoverPoints);
 }
 
 FText UEnvQueryGenerator_CoverPoints::GetDescriptionTitle() const
@@ -87,8 +188,10 @@ FText UEnvQueryGenerator_CoverPoints::GetDescriptionDetails() const
 {
 	FFormatNamedArguments Args;
 	Args.Add(TEXT("Radius"), FText::FromString(SearchRadius.ToString()));
+	Args.Add(TEXT("MaxItems"), FText::FromString(MaxItems.ToString()));
+	Args.Add(TEXT("SortMode"), UEnum::GetDisplayValueAsText(SortMode));
 	
-	return FText::Format(LOCTEXT("ActorsOfClassDescription", "radius: {Radius}"), Args);;
+	return FText::Format(LOCTEXT("CoverPointsDescription", "radius: {Radius}, max items: {MaxItems}, sort: {SortMode}"), Args);
 }
 
 #undef LOCTEXT_NAMESPACE
\ No newline at end of file
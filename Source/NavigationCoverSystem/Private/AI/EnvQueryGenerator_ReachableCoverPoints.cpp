@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/EnvQueryGenerator_ReachableCoverPoints.h"
+
+#include "AI/EnvQueryItemType_CoverPoint.h"
+#include "CoverRecastNavMesh.h"
+#include "CoverSystemStatics.h"
+#include "NavigationSystem.h"
+#include "EnvironmentQuery/Contexts/EnvQueryContext_Querier.h"
+
+#define LOCTEXT_NAMESPACE "EnvQueryGenerator"
+
+UEnvQueryGenerator_ReachableCoverPoints::UEnvQueryGenerator_ReachableCoverPoints()
+	: Super()
+{
+	ItemType = UEnvQueryItemType_CoverPoint::StaticClass();
+	MaxPathCost.DefaultValue = 2000.0f;
+	SearchCenter = UEnvQueryContext_Querier::StaticClass();
+	MaxItems.DefaultValue = 0;
+	bExcludeReservedCover = true;
+}
+
+void UEnvQueryGenerator_ReachableCoverPoints::GenerateItems(FEnvQueryInstance& QueryInstance) const
+{
+	UObject* QueryOwner = QueryInstance.Owner.Get();
+	if (QueryOwner == nullptr)
+	{
+		return;
+	}
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(QueryInstance.World);
+	if (NavSys == nullptr)
+	{
+		return;
+	}
+
+	MaxPathCost.BindData(QueryOwner, QueryInstance.QueryID);
+	const float MaxPathCostValue = MaxPathCost.GetValue();
+	MaxItems.BindData(QueryOwner, QueryInstance.QueryID);
+	const int32 MaxItemsValue = MaxItems.GetValue() > 0 ? MaxItems.GetValue() : MAX_int32;
+
+	TArray<AActor*> ContextActors;
+	QueryInstance.PrepareContext(SearchCenter, ContextActors);
+
+	// cheapest path cost of each cover point over all search centers
+	TArray<FEnvQueryCoverPointItem> ReachedCoverPoints;
+	TMap<FVector, int32> LocationToReachedIdx;
+	TMap<NavNodeRef, FCoverPolyReach> ReachedPolys;
+	for (AActor* ContextActor : ContextActors)
+	{
+		INavAgentInterface* NavAgent = Cast<INavAgentInterface>(ContextActor);
+		if (NavAgent == nullptr)
+		{
+			UE_LOG(LogEQS, Error, TEXT("UEnvQueryGenerator_ReachableCoverPoints::GenerateItems ContextActor does not implement INavAgentInterface and cannot be used to query navigation system!"));
+			continue;
+		}
+
+		const ACoverRecastNavMesh* NavData = UCoverSystemStatics::FindNavigationData<ACoverRecastNavMesh>(*NavSys, NavAgent);
+		const FVector CenterLocation = NavAgent->GetNavAgentLocation();
+		if (!NavData)
+			continue;
+
+		const FSharedConstNavQueryFilter QueryFilter = UNavigationQueryFilter::GetQueryFilter(*NavData, QueryOwner, FilterClass);
+		if (!NavData->FindReachablePolys(CenterLocation, MaxPathCostValue, ReachedPolys, QueryFilter))
+			continue;
+
+		TArray<NavNodeRef> PolyRefs;
+		ReachedPolys.GetKeys(PolyRefs);
+		TArray<FCoverPointOctreeElement> CoverPoints;
+		NavData->FindCoverPointsOnPolys(PolyRefs, CoverPoints);
+
+		for (const FCoverPointOctreeElement& CoverPoint : CoverPoints)
+		{
+			// the NodeRef can be updated by a tile regeneration since the cover points were found
+			const FCoverPolyReach* Reach = ReachedPolys.Find(CoverPoint.Data->NodeRef);
+			if (!Reach)
+				continue;
+
+			if (bExcludeReservedCover && NavData->IsCoverAreaReserved(CoverPoint.Data->Location, QueryOwner))
+			{
+				INC_DWORD_STAT(STAT_CoverReservationsPrefiltered);
+				continue;
+			}
+			
+			const FVector CoverGroundLocation = CoverPoint.Data->Location - FVector(0.0f, 0.0f, UCoverSystemStatics::CoverPointGroundOffset);
+			const float PathCost = Reach->Cost + FVector::Dist(Reach->EntryLocation, CoverGroundLocation) * Reach->CostPerUnit;
+			if (PathCost > MaxPathCostValue)
+				continue;
+
+			if (const int32* ReachedIdx = LocationToReachedIdx.Find(CoverPoint.Data->Location))
+			{
+				FEnvQueryCoverPointItem& Item = ReachedCoverPoints[*ReachedIdx];
+				Item.PathCost = FMath::Min(Item.PathCost, PathCost);
+			}
+			else
+			{
+				LocationToReachedIdx.Add(CoverPoint.Data->Location, ReachedCoverPoints.Emplace(CoverPoint, PathCost));
+			}
+		}
+	}
+
+	ReachedCoverPoints.Sort([](const FEnvQueryCoverPointItem& A, const FEnvQueryCoverPointItem& B) { return A.PathCost < B.PathCost; });
+	if (ReachedCoverPoints.Num() > MaxItemsValue)
+	{
+		ReachedCoverPoints.SetNum(MaxItemsValue);
+	}
+
+	QueryInstance.AddItemData<UEnvQueryItemType_CoverPoint>(ReachedCoverPoints);
+}
+
+FText UEnvQueryGenerator_ReachableCoverPoints::GetDescriptionTitle() const
+{
+	FFormatNamedArguments Args;
+	Args.Add(TEXT("DescriptionTitle"), Super::GetDescriptionTitle());
+	Args.Add(TEXT("DescribeContext"), UEnvQueryTypes::DescribeContext(SearchCenter));
+
+	return FText::Format(LOCTEXT("DescriptionGenerateReachableCoverAroundContext", "{DescriptionTitle}: generate set of reachable cover points around {DescribeContext}"), Args);
+}
+
+FText UEnvQueryGenerator_ReachableCoverPoints::GetDescriptionDetails() const
+{
+	FFormatNamedArguments Args;
+	Args.Add(TEXT("MaxPathCost"), FText::FromString(MaxPathCost.ToString()));
+	Args.Add(TEXT("MaxItems"), FText::FromString(MaxItems.ToString()));
+
+	return FText::Format(LOCTEXT("ReachableCoverPointsDescription", "max path cost: {MaxPathCost}, max items: {MaxItems}"), Args);
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/EnvQueryItemType_CoverPoint.h"
+
+UEnvQueryItemType_CoverPoint::UEnvQueryItemType_CoverPoint()
+{
+	ValueSize = sizeof(FEnvQueryCoverPointItem);
+}
+
+const FEnvQueryCoverPointItem& UEnvQueryItemType_CoverPoint::GetValue(const uint8* RawData)
+{
+	return GetValueFromMemory<FEnvQueryCoverPointItem>(RawData);
+}
+
+void UEnvQueryItemType_CoverPoint::SetValue(uint8* RawData, const FEnvQueryCoverPointItem& Value)
+{
+	SetValueInMemory<FEnvQueryCoverPointItem>(RawData, Value);
+}
+
+void UEnvQueryItemType_CoverPoint::SetValue(uint8* RawData, const FCoverPointOctreeElement& Value)
+{
+	SetValueInMemory<FEnvQueryCoverPointItem>(RawData, FEnvQueryCoverPointItem(Value));
+}
+
+FVector UEnvQueryItemType_CoverPoint::GetItemLocation(const uint8* RawData) const
+{
+	return GetValue(RawData).Location;
+}
@@ -3,10 +3,14 @@
 
 #include "AI/EnvQueryTest_Cover.h"
 
+#include "CoverQueryResultCache.h"
 #include "CoverRecastNavMesh.h"
 #include "CoverSystemStatics.h"
+#include "CoverVisibilityTable.h"
 #include "EngineUtils.h"
 #include "AI/EnvQueryContext_CoverTargetQuerier.h"
+#include "AI/EnvQueryItemType_CoverPoint.h"
+#include "Async/ParallelFor.h"
 #include "Components/CapsuleComponent.h"
 #include "EnvironmentQuery/Items/EnvQueryItemType_VectorBase.h"
 #include "GameFramework/Character.h"
@@ -28,6 +32,160 @@ static TAutoConsoleVariable<bool> CVarDrawEnvQueryCoverLeanTrace(
 	ECVF_Cheat);
 #endif
 
+bool FCoverSweepProvider::Sweep(FHitResult& OutHit, const FVector& Start, const FVector& End, const ECollisionChannel TraceChannel,
+	const FCollisionShape& CollisionShape, const FCollisionQueryParams& Params)
+{
+	INC_DWORD_STAT(STAT_CoverTestSweeps);
+	return World->SweepSingleByChannel(OutHit, Start, End, FQuat::Identity, TraceChannel, CollisionShape, Params);
+}
+
+/**
+ * A sweep of a cover point and target pair submitted through the async trace API
+ */
+struct FCoverAsyncSweep
+{
+	bool bDone = false;
+	bool bHit = false;
+	FHitResult HitResult;
+};
+
+/**
+ * The sweeps of a cover point and target pair, in the order the evaluation asks for them
+ */
+struct FCoverAsyncPair
+{
+	TArray<FCoverAsyncSweep> Sweeps;
+
+	// Unset if the target no longer exists
+	TOptional<ECoverQueryResult> Result;
+	bool bResolved = false;
+
+	bool IsWaiting() const
+	{
+		return Sweeps.Num() > 0 && !Sweeps.Last().bDone;
+	}
+};
+
+/**
+ * Cover points, sweeps and results of a query evaluated with UEnvQueryTest_Cover::bAsyncSweeps
+ */
+struct FCoverAsyncEvaluation : public TSharedFromThis<FCoverAsyncEvaluation, ESPMode::ThreadSafe>
+{
+	TArray<FEnvQueryCoverPointItem> CoverPoints;
+
+	// Index into CoverPoints of each item of the query, INDEX_NONE if the item isn't a cover point
+	TArray<int32> ItemToCoverPoint;
+
+	// CoverPoints.Num() * number of targets, cover point major
+	TArray<FCoverAsyncPair> Pairs;
+
+	uint64 LastAdvanceFrame = 0;
+
+	// Items finished with blocking sweeps by the time slices after the first one of the frame, and the same of the previous frame
+	int32 NumBlockedItems = 0;
+	int32 NumBlockedItemsLastFrame = 0;
+};
+
+/**
+ * Replays the evaluation of a pair with the sweep results received so far.
+ * The first sweep without a result is submitted or finished by blocking, depending on the advance mode, after that the evaluation is pending
+ * and every sweep reports no hit, the result of the evaluation is then discarded.
+ */
+class FCoverAsyncSweepProvider : public FCoverSweepProvider
+{
+public:
+	FCoverAsyncSweepProvider(UWorld* InWorld, FCoverAsyncEvaluation& InEvaluation, const int32 InPairIdx, const ECoverAsyncAdvance InMode)
+		: FCoverSweepProvider(InWorld), Evaluation(InEvaluation), PairIdx(InPairIdx), Mode(InMode), NextSweepIdx(0), bPending(false)
+	{
+	}
+
+	virtual bool Sweep(FHitResult& OutHit, const FVector& Start, const FVector& End, const ECollisionChannel TraceChannel,
+		const FCollisionShape& CollisionShape, const FCollisionQueryParams& Params) override
+	{
+		if (bPending)
+			return false;
+
+		TArray<FCoverAsyncSweep>& Sweeps = Evaluation.Pairs[PairIdx].Sweeps;
+		const int32 SweepIdx = NextSweepIdx++;
+		if (!Sweeps.IsValidIndex(SweepIdx))
+		{
+			if (Mode == ECoverAsyncAdvance::Collect)
+			{
+				bPending = true;
+				return false;
+			}
+
+			Sweeps.AddDefaulted();
+			if (Mode == ECoverAsyncAdvance::Submit)
+			{
+				SubmitSweep(SweepIdx, Start, End, TraceChannel, CollisionShape, Params);
+				bPending = true;
+				return false;
+			}
+		}
+
+		FCoverAsyncSweep& AsyncSweep = Sweeps[SweepIdx];
+		if (!AsyncSweep.bDone)
+		{
+			if (Mode != ECoverAsyncAdvance::Block)
+			{
+				bPending = true;
+				return false;
+			}
+
+			// the async result is ignored when it arrives
+			INC_DWORD_STAT(STAT_CoverTestSweeps);
+			INC_DWORD_STAT(STAT_CoverTestBlockingSweeps);
+			AsyncSweep.bHit = World->SweepSingleByChannel(AsyncSweep.HitResult, Start, End, FQuat::Identity, TraceChannel, CollisionShape, Params);
+			AsyncSweep.bDone = true;
+		}
+
+		OutHit = AsyncSweep.HitResult;
+		return AsyncSweep.bHit;
+	}
+
+	virtual bool IsPending() const override { return bPending; }
+
+protected:
+	void SubmitSweep(const int32 SweepIdx, const FVector& Start, const FVector& End, const ECollisionChannel TraceChannel,
+		const FCollisionShape& CollisionShape, const FCollisionQueryParams& Params) const
+	{
+		INC_DWORD_STAT(STAT_CoverTestSweeps);
+		INC_DWORD_STAT(STAT_CoverTestAsyncSweeps);
+		
+		// the query can finish or be aborted before the result arrives
+		const TWeakPtr<FCoverAsyncEvaluation, ESPMode::ThreadSafe> WeakEvaluation = Evaluation.AsShared();
+		const int32 SweepPairIdx = PairIdx;
+		FTraceDelegate TraceDelegate = FTraceDelegate::CreateLambda([WeakEvaluation, SweepPairIdx, SweepIdx](const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+		{
+			const TSharedPtr<FCoverAsyncEvaluation, ESPMode::ThreadSafe> PinnedEvaluation = WeakEvaluation.Pin();
+			if (!PinnedEvaluation.IsValid())
+				return;
+
+			FCoverAsyncSweep& AsyncSweep = PinnedEvaluation->Pairs[SweepPairIdx].Sweeps[SweepIdx];
+			if (AsyncSweep.bDone)
+				return;
+
+			// same as UWorld::SweepSingleByChannel, only a blocking hit counts
+			AsyncSweep.bDone = true;
+			AsyncSweep.bHit = TraceDatum.OutHits.Num() > 0 && TraceDatum.OutHits[0].bBlockingHit;
+			if (AsyncSweep.bHit)
+			{
+				AsyncSweep.HitResult = TraceDatum.OutHits[0];
+			}
+		});
+
+		World->AsyncSweepByChannel(EAsyncTraceType::Single, Start, End, FQuat::Identity, TraceChannel, CollisionShape, Params,
+			FCollisionResponseParams::DefaultResponseParam, &TraceDelegate);
+	}
+
+	FCoverAsyncEvaluation& Evaluation;
+	const int32 PairIdx;
+	const ECoverAsyncAdvance Mode;
+	int32 NextSweepIdx;
+	bool bPending;
+};
+
 UEnvQueryTest_Cover::UEnvQueryTest_Cover()
 	: Super()
 {
@@ -49,14 +207,41 @@ UEnvQueryTest_Cover::UEnvQueryTest_Cover()
 
 	CoverPointMaxObjectHitDistance = 100.0f;
 	CoverOutOffset.DefaultValue = 100.0f;
+	bUseCoverMetadata = true;
+	bUseProtectionMask = true;
+	ProtectionMaskHeightTolerance = 25.0f;
+	bUseVisibilityTable = true;
+	VisibilityTableSnapDistance = 100.0f;
+	bUseResultCache = true;
+	ResultCacheTargetTolerance = 25.0f;
+	bParallelEvaluation = false;
+	ParallelBatchSize = 128;
+	bAsyncSweeps = false;
+	bShareSquadEvaluation = true;
+	bPrefilter = true;
+	PrefilterFacingThreshold = 0.25f;
+	bPrefilterApproximate = false;
+	PrefilterMaxTargetDistance = 0.0f;
+	PrefilterOutOfRangeResult = ECoverQueryResult::Obstruction;
+	PrefilterMaxElevationAngle = 0.0f;
+	ScoreAggregation = ECoverScoreAggregation::Mean;
+	PrimaryTargetWeight = 2.0f;
+	SquadEvaluationFrame = MAX_uint64;
 
 	//by default don't discard any values, include all
 	FloatValueMin.DefaultValue = 0.0f;
 	FloatValueMax.DefaultValue = 1.0f;
 }
 
+// the EQS manager runs the slices of a query in consecutive frames, anything older than this was aborted
+static const double RunningQueryTimeout = 10.0;
+
 void UEnvQueryTest_Cover::RunTest(FEnvQueryInstance& QueryInstance) const
 {
+	SCOPE_CYCLE_COUNTER(STAT_FindCover);
+	INC_DWORD_STAT(STAT_FindCoverHistoricalCount);
+	SCOPE_SECONDS_ACCUMULATOR(STAT_FindCoverTotalTimeSpent);
+	
 	UObject* QueryOwner = QueryInstance.Owner.Get();
 	BoolValue.BindData(QueryOwner, QueryInstance.QueryID);
 	FloatValueMin.BindData(QueryOwner, QueryInstance.QueryID);
@@ -113,6 +298,643 @@ void UEnvQueryTest_Cover::RunTest(FEnvQueryInstance& QueryInstance) const
 	 * end initialise character variables
 	 */
 	
+	// a new test starts from the first item, anything left from an aborted query with the same id is discarded
+	if (QueryInstance.CurrentTestStartingItem == 0)
+	{
+		RunningQueryTargets.Remove(QueryInstance.QueryID);
+	}
+
+	// queries that were aborted mid-test never get their last slice, the queries of a removed querier are aborted with it
+	const double CurrentTime = FPlatformTime::Seconds();
+	for (auto QueryTargetsIt = RunningQueryTargets.CreateIterator(); QueryTargetsIt; ++QueryTargetsIt)
+	{
+		if (!QueryTargetsIt.Value().Owner.IsValid() || CurrentTime - QueryTargetsIt.Value().StartTime > RunningQueryTimeout)
+		{
+			QueryTargetsIt.RemoveCurrent();
+		}
+	}
+
+	FCoverTestQueryTargets* QueryTargets = RunningQueryTargets.Find(QueryInstance.QueryID);
+	if (!QueryTargets)
+	{
+		QueryTargets = &RunningQueryTargets.Add(QueryInstance.QueryID);
+		QueryTargets->Owner = QueryInstance.Owner;
+		PrepareQueryTargets(QueryInstance, NavData, *QueryTargets);
+	}
+
+	const int32 StartingItem = QueryInstance.CurrentTestStartingItem;
+
+	FCoverEvaluationParams Params;
+	Params.World = World;
+	Params.StandingEyeHeight = CharacterStandingEyeHeight;
+	Params.CrouchingEyeHeight = CharacterCrouchingEyeHeight;
+	Params.bTestCrouchHeight = bTestCrouchHeight;
+	Params.VisibilityTable = bUseVisibilityTable && NavData->GetCoverVisibilityTable().IsEnabled() ? &NavData->GetCoverVisibilityTable() : nullptr;
+	Params.ResultCache = bUseResultCache && NavData->GetCoverQueryResultCache().IsEnabled() ? &NavData->GetCoverQueryResultCache() : nullptr;
+	Params.SettingsHash = Params.ResultCache ? GetResultCacheSettingsHash() : 0;
+
+	const int32 NumTargets = QueryTargets->Actors.Num();
+
+	// the async sweeps score the cover points over several frames
+	FCoverSquadEvaluation* SquadEvaluation = bShareSquadEvaluation && !bAsyncSweeps ? &FindSquadEvaluation(*QueryTargets, Params) : nullptr;
+	
+	if (bAsyncSweeps)
+	{
+		RunAsyncEvaluation(QueryInstance, NavData, *QueryTargets, Params, MinThresholdValue, MaxThresholdValue);
+	}
+	else if (bParallelEvaluation && FApp::ShouldUseThreadingForPerformance())
+	{
+		// gather the cover points of the next batch of items, the item iterator skips the same discarded items
+		TArray<int32> ItemToCoverPoint;
+		ItemToCoverPoint.Init(INDEX_NONE, QueryInstance.Items.Num());
+		TArray<FEnvQueryCoverPointItem> CoverPoints;
+		TMap<int32, float> SharedItemScores;
+		
+		FCoverPointOctreeElement ScratchElement;
+		FEnvQueryCoverPointItem Element;
+		int32 ItemIdx = QueryInstance.CurrentTestStartingItem;
+		for (; ItemIdx < QueryInstance.Items.Num() && CoverPoints.Num() < ParallelBatchSize; ++ItemIdx)
+		{
+			if (QueryInstance.Items[ItemIdx].IsValid() && GetItemCoverPoint(QueryInstance, ItemIdx, NavData, ScratchElement, Element))
+			{
+				const float* SharedScore = SquadEvaluation ? SquadEvaluation->Scores.Find(Element.Handle.Id) : nullptr;
+				if (SharedScore)
+				{
+					SharedItemScores.Add(ItemIdx, *SharedScore);
+				}
+				else
+				{
+					ItemToCoverPoint[ItemIdx] = CoverPoints.Add(Element);
+				}
+			}
+		}
+		const int32 BatchEndItem = ItemIdx;
+
+		TArray<TOptional<ECoverQueryResult>> Results;
+		EvaluateCoverPointsPrimaryFirst(CoverPoints, *QueryTargets, Params, Results);
+
+		// write the scores in the same order as the serial evaluation
+		for (FEnvQueryInstance::ItemIterator It(this, QueryInstance); It; ++It)
+		{
+			// the next time slice starts from here
+			if (It.GetIndex() >= BatchEndItem)
+				break;
+			
+			if (const float* SharedScore = SharedItemScores.Find(It.GetIndex()))
+			{
+				INC_DWORD_STAT(STAT_CoverTestSquadSharedScores);
+				It.SetScore(TestPurpose, FilterType, *SharedScore, MinThresholdValue, MaxThresholdValue);
+				continue;
+			}
+
+			const int32 CoverPointIdx = ItemToCoverPoint[It.GetIndex()];
+			if (CoverPointIdx == INDEX_NONE)
+				continue;
+
+			FCoverScoreAggregator Aggregator(ScoreAggregation, PrimaryTargetWeight);
+			for (int32 TargetIdx = 0; TargetIdx < NumTargets && !Aggregator.IsFinal(); ++TargetIdx)
+			{
+				const TOptional<ECoverQueryResult>& CoverResult = Results[CoverPointIdx * NumTargets + TargetIdx];
+				if (CoverResult.IsSet())
+				{
+					const bool bPrimaryTarget = QueryTargets->PrimaryTargets[TargetIdx];
+					Aggregator.Add(GetTargetScore(CoverResult.GetValue(), bPrimaryTarget), bPrimaryTarget);
+				}
+			}
+
+			if (Aggregator.HasScore())
+			{
+				if (SquadEvaluation)
+				{
+					SquadEvaluation->Scores.Add(CoverPoints[CoverPointIdx].Handle.Id, Aggregator.GetScore());
+				}
+
+				It.SetScore(TestPurpose, FilterType, Aggregator.GetScore(), MinThresholdValue, MaxThresholdValue);
+			}
+		}
+	}
+	else
+	{
+		// stops when the time limit of the EQS step is reached, the next step resumes from the first unfinished item
+		// the items are copied into the same locals, nothing is allocated per item
+		FCoverPointOctreeElement ScratchElement;
+		FEnvQueryCoverPointItem Element;
+		for (FEnvQueryInstance::ItemIterator It(this, QueryInstance); It; ++It)
+		{
+			//UEnvQueryTest_Trace
+			if (!GetItemCoverPoint(QueryInstance, It.GetIndex(), NavData, ScratchElement, Element))
+			{
+				continue;
+			}
+
+			if (SquadEvaluation)
+			{
+				if (const float* SharedScore = SquadEvaluation->Scores.Find(Element.Handle.Id))
+				{
+					INC_DWORD_STAT(STAT_CoverTestSquadSharedScores);
+					It.SetScore(TestPurpose, FilterType, *SharedScore, MinThresholdValue, MaxThresholdValue);
+					continue;
+				}
+			}
+			
+			FCoverScoreAggregator Aggregator(ScoreAggregation, PrimaryTargetWeight);
+			for (int32 TargetIdx = 0; TargetIdx < NumTargets; ++TargetIdx)
+			{
+				if (Aggregator.IsFinal())
+				{
+					INC_DWORD_STAT_BY(STAT_CoverTestSkippedPairs, NumTargets - TargetIdx);
+					break;
+				}
+
+				ECoverQueryResult CoverResult;
+				if (EvaluateCoverPointForTarget(Element, *QueryTargets, TargetIdx, Params, CoverResult))
+				{
+					const bool bPrimaryTarget = QueryTargets->PrimaryTargets[TargetIdx];
+					Aggregator.Add(GetTargetScore(CoverResult, bPrimaryTarget), bPrimaryTarget);
+				}
+			}
+
+			if (Aggregator.HasScore())
+			{
+				if (SquadEvaluation)
+				{
+					SquadEvaluation->Scores.Add(Element.Handle.Id, Aggregator.GetScore());
+				}
+
+				It.SetScore(TestPurpose, FilterType, Aggregator.GetScore(), MinThresholdValue, MaxThresholdValue);
+			}
+		}
+	}
+
+	// the iterator stores where it stopped when it goes out of scope.
+	// EQS also ends the test when the query found its single result, or when a time slice didn't finish any item
+	if (QueryInstance.CurrentTestStartingItem >= QueryInstance.Items.Num() || QueryInstance.bFoundSingleResult
+		|| QueryInstance.CurrentTestStartingItem == StartingItem)
+	{
+		RunningQueryTargets.Remove(QueryInstance.QueryID);
+	}
+}
+
+void UEnvQueryTest_Cover::RunAsyncEvaluation(FEnvQueryInstance& QueryInstance, const ACoverRecastNavMesh* NavData, FCoverTestQueryTargets& QueryTargets,
+	const FCoverEvaluationParams& Params, const float MinThresholdValue, const float MaxThresholdValue) const
+{
+	const int32 NumTargets = QueryTargets.Actors.Num();
+	
+	if (!QueryTargets.AsyncEvaluation.IsValid())
+	{
+		// first time slice, gather the cover points of the remaining items
+		const TSharedRef<FCoverAsyncEvaluation, ESPMode::ThreadSafe> NewEvaluation = MakeShared<FCoverAsyncEvaluation, ESPMode::ThreadSafe>();
+		NewEvaluation->ItemToCoverPoint.Init(INDEX_NONE, QueryInstance.Items.Num());
+		FCoverPointOctreeElement ScratchElement;
+		FEnvQueryCoverPointItem Element;
+		for (int32 ItemIdx = QueryInstance.CurrentTestStartingItem; ItemIdx < QueryInstance.Items.Num(); ++ItemIdx)
+		{
+			if (QueryInstance.Items[ItemIdx].IsValid() && GetItemCoverPoint(QueryInstance, ItemIdx, NavData, ScratchElement, Element))
+			{
+				NewEvaluation->ItemToCoverPoint[ItemIdx] = NewEvaluation->CoverPoints.Add(Element);
+			}
+		}
+		
+		NewEvaluation->Pairs.SetNum(NewEvaluation->CoverPoints.Num() * NumTargets);
+		QueryTargets.AsyncEvaluation = NewEvaluation;
+	}
+
+	FCoverAsyncEvaluation& Evaluation = *QueryTargets.AsyncEvaluation;
+	const bool bFirstSliceOfFrame = Evaluation.LastAdvanceFrame != GFrameCounter;
+	if (bFirstSliceOfFrame)
+	{
+		// the results of the sweeps submitted on earlier frames are in, the follow up sweeps are submitted once the items of this slice are scored
+		Evaluation.LastAdvanceFrame = GFrameCounter;
+		Evaluation.NumBlockedItemsLastFrame = Evaluation.NumBlockedItems;
+		Evaluation.NumBlockedItems = 0;
+		for (int32 CoverPointIdx = 0; CoverPointIdx < Evaluation.CoverPoints.Num(); ++CoverPointIdx)
+		{
+			AdvanceAsyncCoverPoint(Evaluation, CoverPointIdx, QueryTargets, Params, ECoverAsyncAdvance::Collect);
+		}
+	}
+
+	auto IsCoverPointResolved = [&Evaluation, NumTargets](const int32 CoverPointIdx) -> bool
+	{
+		for (int32 TargetIdx = 0; TargetIdx < NumTargets; ++TargetIdx)
+		{
+			if (!Evaluation.Pairs[CoverPointIdx * NumTargets + TargetIdx].bResolved)
+				return false;
+		}
+		
+		return true;
+	};
+
+	// score the items in order as far as their sweeps are done
+	bool bProgressed = false;
+	for (FEnvQueryInstance::ItemIterator It(this, QueryInstance); It; ++It)
+	{
+		const int32 CoverPointIdx = Evaluation.ItemToCoverPoint[It.GetIndex()];
+		if (CoverPointIdx == INDEX_NONE)
+		{
+			bProgressed = true;
+			continue;
+		}
+
+		if (!IsCoverPointResolved(CoverPointIdx))
+		{
+			// the next time slice starts from here
+			if (bProgressed)
+				break;
+
+			// EQS ends the test if a time slice doesn't finish any item, it can't wait for the next frame.
+			// finish this one with blocking sweeps, on top of the results received so far
+			AdvanceAsyncCoverPoint(Evaluation, CoverPointIdx, QueryTargets, Params, ECoverAsyncAdvance::Block);
+			if (!bFirstSliceOfFrame)
+			{
+				++Evaluation.NumBlockedItems;
+			}
+		}
+
+		// the skipped pairs have no result
+		FCoverScoreAggregator Aggregator(ScoreAggregation, PrimaryTargetWeight);
+		for (int32 TargetIdx = 0; TargetIdx < NumTargets; ++TargetIdx)
+		{
+			const FCoverAsyncPair& Pair = Evaluation.Pairs[CoverPointIdx * NumTargets + TargetIdx];
+			if (Pair.Result.IsSet())
+			{
+				const bool bPrimaryTarget = QueryTargets.PrimaryTargets[TargetIdx];
+				Aggregator.Add(GetTargetScore(Pair.Result.GetValue(), bPrimaryTarget), bPrimaryTarget);
+			}
+		}
+
+		if (Aggregator.HasScore())
+		{
+			It.SetScore(TestPurpose, FilterType, Aggregator.GetScore(), MinThresholdValue, MaxThresholdValue);
+		}
+		
+		bProgressed = true;
+	}
+
+	if (!bFirstSliceOfFrame)
+		return;
+
+	// the later time slices of the frame finish the next items with blocking sweeps, their async sweeps would be thrown away.
+	// expect as many of them as in the last frame and submit the follow up sweeps of the items after them
+	int32 NumSkippedItems = 0;
+	for (int32 ItemIdx = QueryInstance.CurrentTestStartingItem; ItemIdx < QueryInstance.Items.Num(); ++ItemIdx)
+	{
+		const int32 CoverPointIdx = Evaluation.ItemToCoverPoint[ItemIdx];
+		if (CoverPointIdx == INDEX_NONE || IsCoverPointResolved(CoverPointIdx))
+			continue;
+
+		if (NumSkippedItems < Evaluation.NumBlockedItemsLastFrame)
+		{
+			++NumSkippedItems;
+			continue;
+		}
+
+		AdvanceAsyncCoverPoint(Evaluation, CoverPointIdx, QueryTargets, Params, ECoverAsyncAdvance::Submit);
+	}
+}
+
+void UEnvQueryTest_Cover::AdvanceAsyncPair(FCoverAsyncEvaluation& Evaluation, const int32 PairIdx, const FCoverTestQueryTargets& QueryTargets,
+	const FCoverEvaluationParams& Params, const ECoverAsyncAdvance Mode) const
+{
+	FCoverAsyncPair& Pair = Evaluation.Pairs[PairIdx];
+	if (Pair.bResolved || (Mode != ECoverAsyncAdvance::Block && Pair.IsWaiting()))
+		return;
+
+	const int32 NumTargets = QueryTargets.Actors.Num();
+	const FEnvQueryCoverPointItem& CoverPoint = Evaluation.CoverPoints[PairIdx / NumTargets];
+	const int32 TargetIdx = PairIdx % NumTargets;
+
+	// the cache was already checked when the pair was first evaluated
+	FCoverEvaluationParams ReplayParams = Params;
+	if (Pair.Sweeps.Num() > 0)
+	{
+		ReplayParams.ResultCache = nullptr;
+	}
+
+	FCoverAsyncSweepProvider Sweeper(Params.World, Evaluation, PairIdx, Mode);
+	ECoverQueryResult CoverResult;
+	if (EvaluateCoverPointForTarget(CoverPoint, QueryTargets, TargetIdx, ReplayParams, CoverResult, nullptr, &Sweeper))
+	{
+		Pair.Result = CoverResult;
+		Pair.bResolved = true;
+
+		if (Params.ResultCache && !ReplayParams.ResultCache)
+		{
+			Params.ResultCache->Add(MakeResultCacheKey(CoverPoint, QueryTargets, TargetIdx, Params), CoverPoint.TileIndex, CoverPoint.Location,
+				QueryTargets.EyeLocations[TargetIdx], CoverResult);
+		}
+	}
+	else if (!Sweeper.IsPending())
+	{
+		// the target no longer exists
+		Pair.bResolved = true;
+	}
+}
+
+void UEnvQueryTest_Cover::AdvanceAsyncCoverPoint(FCoverAsyncEvaluation& Evaluation, const int32 CoverPointIdx, const FCoverTestQueryTargets& QueryTargets,
+	const FCoverEvaluationParams& Params, const ECoverAsyncAdvance Mode) const
+{
+	const int32 NumTargets = QueryTargets.Actors.Num();
+	const int32 FirstPairIdx = CoverPointIdx * NumTargets;
+
+	FCoverScoreAggregator Aggregator(ScoreAggregation, PrimaryTargetWeight);
+	bool bPrimaryTargetsResolved = true;
+	for (int32 TargetIdx = 0; TargetIdx < NumTargets; ++TargetIdx)
+	{
+		FCoverAsyncPair& Pair = Evaluation.Pairs[FirstPairIdx + TargetIdx];
+		const bool bPrimaryTarget = QueryTargets.PrimaryTargets[TargetIdx];
+		
+		// the other targets are only submitted once the primary targets didn't discard the cover point
+		if (!bPrimaryTarget && !bPrimaryTargetsResolved)
+			return;
+
+		if (Aggregator.IsFinal())
+		{
+			// the sweeps still in flight are ignored when they arrive
+			if (!Pair.bResolved)
+			{
+				INC_DWORD_STAT(STAT_CoverTestSkippedPairs);
+				Pair.bResolved = true;
+			}
+
+			continue;
+		}
+
+		AdvanceAsyncPair(Evaluation, FirstPairIdx + TargetIdx, QueryTargets, Params, Mode);
+		if (!Pair.bResolved)
+		{
+			bPrimaryTargetsResolved &= !bPrimaryTarget;
+		}
+		else if (Pair.Result.IsSet())
+		{
+			Aggregator.Add(GetTargetScore(Pair.Result.GetValue(), bPrimaryTarget), bPrimaryTarget);
+		}
+	}
+}
+
+float UEnvQueryTest_Cover::GetTargetScore(const ECoverQueryResult CoverResult, const bool bPrimaryTarget)
+{
+	if (CoverResult == ECoverQueryResult::Found)
+		return 1.0f;
+
+	//we failed the cover test, need to check if it was for a primary target, if so we discard this point
+	//score negative one if this is not valid cover for the primary target
+	if (bPrimaryTarget)
+		return -1.0f;
+
+	//we don't care if we can't shoot the other targets as long as we are behind cover
+	//if we only failed because we couldn't target them, we still accept it as a valid cover
+	return CoverResult > ECoverQueryResult::NotFound ? 1.0f : 0.0f;
+}
+
+bool UEnvQueryTest_Cover::PrefilterCoverPoint(const FEnvQueryCoverPointItem& CoverPoint, const FVector& TestTargetLocation, const bool bPrimaryTarget,
+	ECoverQueryResult& OutResult) const
+{
+	const FEnvQueryCoverPointItem& Data = CoverPoint;
+	const FVector CoverGroundLocation = Data.Location - FVector(0.0f, 0.0f, UCoverSystemStatics::CoverPointGroundOffset);
+	const FVector ToTarget = TestTargetLocation - CoverGroundLocation;
+	const float DistanceSq2D = ToTarget.SizeSquared2D();
+
+	if (PrefilterMaxTargetDistance > 0.0f && DistanceSq2D + FMath::Square(ToTarget.Z - UCoverSystemStatics::StandingCoverHeight) > FMath::Square(PrefilterMaxTargetDistance))
+	{
+		INC_DWORD_STAT(STAT_CoverTestPrefilterRange);
+		OutResult = PrefilterOutOfRangeResult;
+		return true;
+	}
+
+	// both failures score the same for a primary target
+	const bool bCanRejectFailure = bPrimaryTarget || bPrefilterApproximate;
+	if (bCanRejectFailure && Data.bForceField)
+	{
+		INC_DWORD_STAT(STAT_CoverTestPrefilterForceField);
+		OutResult = ECoverQueryResult::NotFound;
+		return true;
+	}
+
+	if (!bUseCoverMetadata || Data.Metadata.FacingNormal.IsNearlyZero() || DistanceSq2D < KINDA_SMALL_NUMBER)
+		return false;
+
+	// the cover object is on the other side of the cover point
+	const FVector TestDir = ToTarget.GetSafeNormal2D();
+	if (bCanRejectFailure && FVector::DotProduct(Data.Metadata.FacingNormal, TestDir) >= PrefilterFacingThreshold)
+	{
+		INC_DWORD_STAT(STAT_CoverTestPrefilterFacing);
+		OutResult = ECoverQueryResult::NotFound;
+		return true;
+	}
+
+	if (PrefilterMaxElevationAngle > 0.0f)
+	{
+		// assume the taller cover if the height was traced with other settings, which rejects fewer cover points
+		const bool bCrouchCover = CanUseGeneratedHeight(Data.Metadata) && Data.Metadata.Height == ECoverHeight::Crouch;
+		const float CoverTopHeight = bCrouchCover ? UCoverSystemStatics::CrouchCoverHeight : UCoverSystemStatics::StandingCoverHeight;
+		const float ElevationAngle = FMath::RadiansToDegrees(FMath::Atan2(ToTarget.Z - CoverTopHeight, FMath::Sqrt(DistanceSq2D)));
+		if (ElevationAngle > PrefilterMaxElevationAngle)
+		{
+			INC_DWORD_STAT(STAT_CoverTestPrefilterElevation);
+			OutResult = ECoverQueryResult::NotFound;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+FCoverQueryCacheKey UEnvQueryTest_Cover::MakeResultCacheKey(const FEnvQueryCoverPointItem& CoverPoint, const FCoverTestQueryTargets& Targets, const int32 TargetIdx,
+	const FCoverEvaluationParams& Params) const
+{
+	const AActor* TestActor = Targets.Actors[TargetIdx].Get();
+	return FCoverQueryCacheKey(CoverPoint.Handle, Targets.EyeLocations[TargetIdx], ResultCacheTargetTolerance, TestActor ? TestActor->GetUniqueID() : 0,
+		Params.StandingEyeHeight, Params.CrouchingEyeHeight, Params.SettingsHash);
+}
+
+bool UEnvQueryTest_Cover::EvaluateCoverPointForTarget(const FEnvQueryCoverPointItem& CoverPoint, const FCoverTestQueryTargets& Targets, const int32 TargetIdx,
+	const FCoverEvaluationParams& Params, ECoverQueryResult& OutResult, TArray<FCoverQueryCacheInsert>* DeferredCacheInserts, FCoverSweepProvider* Sweeper) const
+{
+	// the target was destroyed since the first slice
+	AActor* TestActor = Targets.Actors[TargetIdx].Get();
+	if (!TestActor)
+		return false;
+	
+	const FCoverHandle* TestActorCoverPoint = Targets.CoverPoints[TargetIdx].IsValid() ? &Targets.CoverPoints[TargetIdx] : nullptr;
+	const FVector& TestLocation = Targets.EyeLocations[TargetIdx];
+
+	if (bPrefilter && PrefilterCoverPoint(CoverPoint, TestLocation, Targets.PrimaryTargets[TargetIdx], OutResult))
+		return true;
+
+	const FCoverQueryCacheKey CacheKey = MakeResultCacheKey(CoverPoint, Targets, TargetIdx, Params);
+	if (Params.ResultCache && Params.ResultCache->Find(CacheKey, CoverPoint.TileIndex, OutResult))
+		return true;
+
+	FCoverSweepProvider BlockingSweeper(Params.World);
+	FCoverSweepProvider& EvaluationSweeper = Sweeper ? *Sweeper : BlockingSweeper;
+	
+	OutResult = EvaluateCoverPoint(&CoverPoint, Params.StandingEyeHeight, TestActor, TestLocation, true, EvaluationSweeper, Params.VisibilityTable, TestActorCoverPoint);
+	if (OutResult < ECoverQueryResult::Found_NoView && Params.bTestCrouchHeight)
+	{
+		const ECoverQueryResult CrouchCoverResult = EvaluateCrouchCoverPoint(&CoverPoint, Params.StandingEyeHeight, Params.CrouchingEyeHeight, TestActor, TestLocation,
+			EvaluationSweeper, Params.VisibilityTable, TestActorCoverPoint);
+
+		if (CrouchCoverResult > OutResult)
+			OutResult = CrouchCoverResult;
+	}
+
+	// the result was made up from the sweeps that aren't done yet
+	if (EvaluationSweeper.IsPending())
+		return false;
+
+	INC_DWORD_STAT(STAT_CoverTestEvaluatedPairs);
+
+	if (Params.ResultCache)
+	{
+		if (DeferredCacheInserts)
+		{
+			DeferredCacheInserts->Emplace(CacheKey, CoverPoint.TileIndex, CoverPoint.Location, TestLocation, OutResult);
+		}
+		else
+		{
+			Params.ResultCache->Add(CacheKey, CoverPoint.TileIndex, CoverPoint.Location, TestLocation, OutResult);
+		}
+	}
+
+	return true;
+}
+
+void UEnvQueryTest_Cover::EvaluateCoverPointsParallel(const TArray<FEnvQueryCoverPointItem>& CoverPoints, const FCoverTestQueryTargets& Targets,
+	const FCoverEvaluationParams& Params, TArray<TOptional<ECoverQueryResult>>& OutResults, const TArray<int32>* PairIndices) const
+{
+	const int32 NumTargets = Targets.Actors.Num();
+	OutResults.Reset();
+	OutResults.SetNum(CoverPoints.Num() * NumTargets);
+	
+	const int32 NumPairs = PairIndices ? PairIndices->Num() : OutResults.Num();
+	if (NumPairs == 0)
+		return;
+
+	// a few chunks per worker to balance cover points that take more sweeps than others
+	const int32 NumWorkers = FMath::Min(FTaskGraphInterface::Get().GetNumWorkerThreads() + 1, NumPairs);
+	const int32 ChunkSize = FMath::Max(1, NumPairs / (NumWorkers * 4));
+	const int32 NumChunks = FMath::DivideAndRoundUp(NumPairs, ChunkSize);
+
+	// reused by a worker for all the chunks it takes. the hit results and collision params of the sweeps are stack locals of the evaluation,
+	// the cache inserts are the only allocation worth keeping
+	struct FWorkerScratch
+	{
+		TArray<FCoverQueryCacheInsert> CacheInserts;
+	};
+	
+	TArray<FWorkerScratch> WorkerScratches;
+	WorkerScratches.SetNum(NumWorkers);
+	
+	// the workers take the next chunk until there are none left
+	FThreadSafeCounter NextChunk;
+	ParallelFor(NumWorkers, [&](const int32 WorkerIdx)
+	{
+		FWorkerScratch& Scratch = WorkerScratches[WorkerIdx];
+		Scratch.CacheInserts.Reserve(Params.ResultCache ? ChunkSize : 0);
+
+		for (int32 ChunkIdx = NextChunk.Increment() - 1; ChunkIdx < NumChunks; ChunkIdx = NextChunk.Increment() - 1)
+		{
+			const int32 PairEnd = FMath::Min((ChunkIdx + 1) * ChunkSize, NumPairs);
+			for (int32 Idx = ChunkIdx * ChunkSize; Idx < PairEnd; ++Idx)
+			{
+				// each pair writes its own slot, so the results don't depend on the scheduling
+				const int32 PairIdx = PairIndices ? (*PairIndices)[Idx] : Idx;
+				ECoverQueryResult CoverResult;
+				if (EvaluateCoverPointForTarget(CoverPoints[PairIdx / NumTargets], Targets, PairIdx % NumTargets, Params, CoverResult, &Scratch.CacheInserts))
+				{
+					OutResults[PairIdx] = CoverResult;
+				}
+			}
+		}
+
+		// each worker adds its results to the cache under one lock, instead of once per result
+		if (Params.ResultCache)
+		{
+			Params.ResultCache->Add(Scratch.CacheInserts);
+		}
+	});
+}
+
+void UEnvQueryTest_Cover::EvaluateCoverPointsPrimaryFirst(const TArray<FEnvQueryCoverPointItem>& CoverPoints, const FCoverTestQueryTargets& Targets,
+	const FCoverEvaluationParams& Params, TArray<TOptional<ECoverQueryResult>>& OutResults) const
+{
+	const int32 NumTargets = Targets.Actors.Num();
+
+	// the primary targets first, the other targets only for the cover points they didn't discard
+	const int32 NumPrimaryTargets = Targets.NumPrimaryTargets;
+	TArray<int32> PairIndices;
+	PairIndices.Reserve(CoverPoints.Num() * NumPrimaryTargets);
+	for (int32 CoverPointIdx = 0; CoverPointIdx < CoverPoints.Num(); ++CoverPointIdx)
+	{
+		for (int32 TargetIdx = 0; TargetIdx < NumPrimaryTargets; ++TargetIdx)
+		{
+			PairIndices.Add(CoverPointIdx * NumTargets + TargetIdx);
+		}
+	}
+
+	EvaluateCoverPointsParallel(CoverPoints, Targets, Params, OutResults, &PairIndices);
+
+	if (NumPrimaryTargets < NumTargets)
+	{
+		PairIndices.Reset();
+		for (int32 CoverPointIdx = 0; CoverPointIdx < CoverPoints.Num(); ++CoverPointIdx)
+		{
+			FCoverScoreAggregator Aggregator(ScoreAggregation, PrimaryTargetWeight);
+			for (int32 TargetIdx = 0; TargetIdx < NumPrimaryTargets; ++TargetIdx)
+			{
+				const TOptional<ECoverQueryResult>& CoverResult = OutResults[CoverPointIdx * NumTargets + TargetIdx];
+				if (CoverResult.IsSet())
+				{
+					Aggregator.Add(GetTargetScore(CoverResult.GetValue(), true), true);
+				}
+			}
+
+			if (Aggregator.IsFinal())
+			{
+				INC_DWORD_STAT_BY(STAT_CoverTestSkippedPairs, NumTargets - NumPrimaryTargets);
+				continue;
+			}
+
+			for (int32 TargetIdx = NumPrimaryTargets; TargetIdx < NumTargets; ++TargetIdx)
+			{
+				PairIndices.Add(CoverPointIdx * NumTargets + TargetIdx);
+			}
+		}
+
+		TArray<TOptional<ECoverQueryResult>> SecondaryResults;
+		EvaluateCoverPointsParallel(CoverPoints, Targets, Params, SecondaryResults, &PairIndices);
+		for (const int32 PairIdx : PairIndices)
+		{
+			OutResults[PairIdx] = SecondaryResults[PairIdx];
+		}
+	}
+}
+
+bool UEnvQueryTest_Cover::GetItemCoverPoint(FEnvQueryInstance& QueryInstance, const int32 ItemIndex, const ACoverRecastNavMesh* NavData,
+	FCoverPointOctreeElement& ScratchElement, FEnvQueryCoverPointItem& OutCoverPoint) const
+{
+	// cover point items carry their cover data, no need to look them up under the octree lock
+	if (QueryInstance.ItemType && QueryInstance.ItemType->IsChildOf(UEnvQueryItemType_CoverPoint::StaticClass()))
+	{
+		const FEnvQueryCoverPointItem& Item = UEnvQueryItemType_CoverPoint::GetValue(QueryInstance.RawData.GetData() + QueryInstance.Items[ItemIndex].DataOffset);
+		if (!Item.Handle.IsValid())
+			return false;
+
+		OutCoverPoint = Item;
+		return true;
+	}
+
+	// the element shares the octree's data, the lookup doesn't copy it
+	if (!NavData->GetCoverPointOctreeElement(ScratchElement, GetItemLocation(QueryInstance, ItemIndex)))
+		return false;
+
+	OutCoverPoint = FEnvQueryCoverPointItem(ScratchElement);
+	return true;
+}
+
+void UEnvQueryTest_Cover::PrepareQueryTargets(FEnvQueryInstance& QueryInstance, const ACoverRecastNavMesh* NavData, FCoverTestQueryTargets& OutTargets) const
+{
+	UObject* QueryOwner = QueryInstance.Owner.Get();
 	UseTraceFromContext.BindData(QueryOwner, QueryInstance.QueryID);
 	const float bUseTraceFromContext = UseTraceFromContext.GetValue();
 
@@ -138,55 +960,84 @@ void UEnvQueryTest_Cover::RunTest(FEnvQueryInstance& QueryInstance) const
 	{
 		QueryInstance.PrepareContext(PrimaryTargetContext, PrimaryTargets);
 	}
+
+	const bool bSnapToCoverPoints = bUseVisibilityTable && NavData->GetCoverVisibilityTable().IsEnabled();
 	
-	for (FEnvQueryInstance::ItemIterator It(this, QueryInstance); It; ++It)
+	// the primary targets first, they can discard a cover point before the other targets are evaluated
+	ContextActors.StableSort([&PrimaryTargets](const AActor& A, const AActor& B)
 	{
-		//UEnvQueryTest_Trace
-		const FVector ItemLocation = GetItemLocation(QueryInstance, It.GetIndex());
-		FCoverPointOctreeElement Element;
-		if (!NavData->GetCoverPointOctreeElement(Element, ItemLocation))
-		{
-			continue;
-		}
-		
-		for (const auto TestActor : ContextActors)
-		{
-			const bool bPrimaryTarget = PrimaryTargets.Num() > 0 && PrimaryTargets.Contains(TestActor);
-			
-			FVector OutLocation;
-			FRotator OutRotation;
-			TestActor->GetActorEyesViewPoint(OutLocation, OutRotation);
+		return PrimaryTargets.Contains(&A) && !PrimaryTargets.Contains(&B);
+	});
 
-			ECoverQueryResult CoverResult = EvaluateCoverPoint(&Element, CharacterStandingEyeHeight, TestActor, OutLocation, true, World);
-			if (CoverResult < ECoverQueryResult::Found_NoView && bTestCrouchHeight)
-			{
-				const ECoverQueryResult OldCoverResult = CoverResult;
-				CoverResult = EvaluateCrouchCoverPoint(&Element, CharacterStandingEyeHeight, CharacterCrouchingEyeHeight, TestActor, OutLocation, World);
+	OutTargets.StartTime = FPlatformTime::Seconds();
+	OutTargets.NumPrimaryTargets = 0;
+	for (AActor* ContextActor : ContextActors)
+	{
+		FVector EyeLocation;
+		FRotator EyeRotation;
+		ContextActor->GetActorEyesViewPoint(EyeLocation, EyeRotation);
 
-				if (CoverResult < OldCoverResult)
-					CoverResult = OldCoverResult;
-			}
-			
-			if (CoverResult == ECoverQueryResult::Found)
-			{
-				It.SetScore(TestPurpose, FilterType, 1.0f, MinThresholdValue, MaxThresholdValue);
-			}
-			//we failed the cover test, need to check if it was for a primary target, if so we discard this point
-			//set score to negative one if this is not valid cover for the primary target
-			else if (bPrimaryTarget)
-			{
-				It.SetScore(TestPurpose, FilterType, -1.0f, MinThresholdValue, MaxThresholdValue);
-			}
-			else //if !Success && !bPrimaryTarget
+		// snap the targets to their nearest cover point once, instead of for every item
+		// the table traces to the standing height of the cover points
+		FCoverHandle TargetCoverHandle;
+		if (bSnapToCoverPoints)
+		{
+			const FVector TargetCoverLocation = EyeLocation - FVector(0.0f, 0.0f, UCoverSystemStatics::StandingCoverHeight - UCoverSystemStatics::CoverPointGroundOffset);
+			FCoverPointOctreeElement TargetCoverPoint;
+			if (NavData->FindNearestCoverPoint(TargetCoverPoint, TargetCoverLocation, VisibilityTableSnapDistance))
 			{
-				//we don't care if we can't shoot the other targets as long as we are behind cover
-				//if we only failed because we couldn't target them, we still accept it as a valid cover
-				It.SetScore(TestPurpose, FilterType, CoverResult > ECoverQueryResult::NotFound ? 1.0f : 0.0f, MinThresholdValue, MaxThresholdValue);
+				TargetCoverHandle = TargetCoverPoint.Handle;
 			}
 		}
+
+		OutTargets.Actors.Add(ContextActor);
+		OutTargets.EyeLocations.Add(EyeLocation);
+		OutTargets.CoverPoints.Add(TargetCoverHandle);
+		const bool bPrimaryTarget = PrimaryTargets.Contains(ContextActor);
+		OutTargets.PrimaryTargets.Add(bPrimaryTarget);
+		OutTargets.NumPrimaryTargets += bPrimaryTarget ? 1 : 0;
 	}
 }
 
+bool FCoverSquadEvaluation::Matches(const FCoverTestQueryTargets& Targets, const FCoverEvaluationParams& Params, const float InCoverOutOffset) const
+{
+	const float InCrouchingEyeHeight = Params.bTestCrouchHeight ? Params.CrouchingEyeHeight : -1.0f;
+	if (StandingEyeHeight != Params.StandingEyeHeight || CrouchingEyeHeight != InCrouchingEyeHeight || CoverOutOffset != InCoverOutOffset
+		|| Actors != Targets.Actors || EyeLocations != Targets.EyeLocations || PrimaryTargets != Targets.PrimaryTargets)
+		return false;
+
+	return true;
+}
+
+FCoverSquadEvaluation& UEnvQueryTest_Cover::FindSquadEvaluation(const FCoverTestQueryTargets& Targets, const FCoverEvaluationParams& Params) const
+{
+	// the targets move between frames
+	if (SquadEvaluationFrame != GFrameCounter)
+	{
+		SquadEvaluationFrame = GFrameCounter;
+		SquadEvaluations.Reset();
+	}
+
+	const float OutOffset = CoverOutOffset.GetValue();
+	FCoverSquadEvaluation* SquadEvaluation = SquadEvaluations.FindByPredicate([&](const FCoverSquadEvaluation& Candidate)
+	{
+		return Candidate.Matches(Targets, Params, OutOffset);
+	});
+
+	if (!SquadEvaluation)
+	{
+		SquadEvaluation = &SquadEvaluations.AddDefaulted_GetRef();
+		SquadEvaluation->Actors = Targets.Actors;
+		SquadEvaluation->EyeLocations = Targets.EyeLocations;
+		SquadEvaluation->PrimaryTargets = Targets.PrimaryTargets;
+		SquadEvaluation->StandingEyeHeight = Params.StandingEyeHeight;
+		SquadEvaluation->CrouchingEyeHeight = Params.bTestCrouchHeight ? Params.CrouchingEyeHeight : -1.0f;
+		SquadEvaluation->CoverOutOffset = OutOffset;
+	}
+
+	return *SquadEvaluation;
+}
+
 FText UEnvQueryTest_Cover::GetDescriptionTitle() const
 {
 
@@ -210,10 +1061,11 @@ FText UEnvQueryTest_Cover::GetDescriptionDetails() const
 	return GetDescriptionTitle();
 }
 
-ECoverQueryResult UEnvQueryTest_Cover::EvaluateCoverPoint(const FCoverPointOctreeElement* CoverPoint, const float CoverTestHeight,
-	AActor* TestTargetActor, const FVector& TestTargetLocation, const bool bTestHitByLean, UWorld* World) const
+ECoverQueryResult UEnvQueryTest_Cover::EvaluateCoverPoint(const FEnvQueryCoverPointItem* CoverPoint, const float CoverTestHeight,
+	AActor* TestTargetActor, const FVector& TestTargetLocation, const bool bTestHitByLean, FCoverSweepProvider& Sweeper,
+	const FCoverVisibilityTable* VisibilityTable, const FCoverHandle* TestTargetCoverPoint) const
 {
-	const FVector CoverLocation = CoverPoint->Data->Location;
+	const FVector CoverLocation = CoverPoint->Location;
 	const FVector CoverLocationInTestHeight = FVector(CoverLocation.X, CoverLocation.Y, CoverLocation.Z - UCoverSystemStatics::CoverPointGroundOffset + CoverTestHeight);
 
 	const FVector TestDir = (TestTargetLocation - CoverLocationInTestHeight).GetSafeNormal2D();
@@ -231,26 +1083,44 @@ ECoverQueryResult UEnvQueryTest_Cover::EvaluateCoverPoint(const FCoverPointOctre
 	//with this collision channel, we should only be hitting cover
 	ECollisionChannel CollisionChannel = UEngineTypes::ConvertToCollisionChannel(CoverTraceChannel);
 
+	// the generator already found that the cover doesn't reach this height, so the cover sweep can't hit it
+	const bool bBelowCoverHeight = CanUseGeneratedHeight(CoverPoint->Metadata) && CoverPoint->Metadata.Height == ECoverHeight::Crouch
+		&& CoverTestHeight >= UCoverSystemStatics::StandingCoverHeight;
+	
+	// the generated protection masks already know what the cover sweep would hit in most directions
+	const ECoverProtection MaskProtection = bBelowCoverHeight ? ECoverProtection::Unknown : GetProtectionFromMask(CoverPoint, CoverTestHeight, TestDir);
+	
 	// check if we can hit the enemy straight from the cover point. if we can, then the cover point is no good
-	if (!World->SweepSingleByChannel(HitResult, CoverLocationInTestHeight, CoverTestEndLocation, FQuat::Identity,  CollisionChannel, SphereCollisionShape, CollisionQueryParams))
+	if (MaskProtection == ECoverProtection::Open || (MaskProtection == ECoverProtection::Unknown && (bBelowCoverHeight
+		|| !Sweeper.Sweep(HitResult, CoverLocationInTestHeight, CoverTestEndLocation, CollisionChannel, SphereCollisionShape, CollisionQueryParams))))
 	{
 #if DEBUG_RENDERING
-		if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread())
+		if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread() && IsInGameThread())
 		{
-			DrawDebugLine(World, CoverLocationInTestHeight, CoverTestEndLocation, FColor::Blue, true, -1, 0, 10.0f);
+			DrawDebugLine(Sweeper.GetWorld(), CoverLocationInTestHeight, CoverTestEndLocation, FColor::Blue, true, -1, 0, 10.0f);
 		}
 #endif
 
+		// the table already traced the line of sight to the cover point the target is standing at
+		const ECoverVisibility TableVisibility = VisibilityTable && TestTargetCoverPoint
+			? VisibilityTable->GetVisibility(CoverPoint->Handle, *TestTargetCoverPoint, CoverTestHeight, ProtectionMaskHeightTolerance, CollisionChannel)
+			: ECoverVisibility::Unknown;
+		if (TableVisibility == ECoverVisibility::Hidden)
+			return ECoverQueryResult::Obstruction;
+		
+		if (TableVisibility == ECoverVisibility::Visible)
+			return ECoverQueryResult::NotFound;
+
 		//not hitting anything means it hit our player (shouldn't be colliding with the player from the cover channel)
-		if (World->SweepSingleByChannel(HitResult, CoverLocationInTestHeight, TestTargetLocation, FQuat::Identity,  CollisionChannel, SphereCollisionShape, CollisionQueryParams))
+		if (Sweeper.Sweep(HitResult, CoverLocationInTestHeight, TestTargetLocation, CollisionChannel, SphereCollisionShape, CollisionQueryParams))
 		{
 			const AActor* HitActor = HitResult.GetActor();
 			if (HitActor != TestTargetActor && !HitActor->IsA<APawn>())
 			{
 #if DEBUG_RENDERING
-				if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread())
+				if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread() && IsInGameThread())
 				{
-					DrawDebugLine(World, CoverLocationInTestHeight, TestTargetLocation, FColor::Green, true, -1, 0, 10.0f);
+					DrawDebugLine(Sweeper.GetWorld(), CoverLocationInTestHeight, TestTargetLocation, FColor::Green, true, -1, 0, 10.0f);
 				}
 #endif				
 				return ECoverQueryResult::Obstruction;
@@ -258,9 +1128,9 @@ ECoverQueryResult UEnvQueryTest_Cover::EvaluateCoverPoint(const FCoverPointOctre
 		}
 
 #if DEBUG_RENDERING
-		if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread())
+		if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread() && IsInGameThread())
 		{
-			DrawDebugLine(World, CoverLocationInTestHeight, TestTargetLocation, FColor::Black, true, -1, 0, 10.0f);
+			DrawDebugLine(Sweeper.GetWorld(), CoverLocationInTestHeight, TestTargetLocation, FColor::Black, true, -1, 0, 10.0f);
 		}
 #endif
 		
@@ -273,17 +1143,18 @@ ECoverQueryResult UEnvQueryTest_Cover::EvaluateCoverPoint(const FCoverPointOctre
 	//we can also use a small CoverPointMaxObjectHitDistance too, but using the cover object is more accurate
 	//#NOTE maybe remove cover object check, it could be that the cover is large and curves around, so we still need to use CoverPointMaxObjectHitDistance
 	const AActor* HitActor = HitResult.GetActor();
-	if (!CoverPoint->Data->bForceField && HitActor != TestTargetActor && !HitActor->IsA<APawn>()
-		&& (HitActor == CoverPoint->Data->CoverObject && HitResult.Distance <= CoverPointMaxObjectHitDistance)) 
+	const bool bProtected = MaskProtection == ECoverProtection::Protected || (MaskProtection == ECoverProtection::Unknown
+		&& HitActor != TestTargetActor && !HitActor->IsA<APawn>() && (HitActor == CoverPoint->CoverObject && HitResult.Distance <= CoverPointMaxObjectHitDistance));
+	if (!CoverPoint->bForceField && bProtected) 
 	{
 #if DEBUG_RENDERING
-		if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread())
+		if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread() && IsInGameThread())
 		{
-			DrawDebugLine(World, CoverLocationInTestHeight, CoverTestEndLocation, FColor::Red, true, -1, 0, 10.0f);
+			DrawDebugLine(Sweeper.GetWorld(), CoverLocationInTestHeight, CoverTestEndLocation, FColor::Red, true, -1, 0, 10.0f);
 		}
 #endif
 		
-		if (!bTestHitByLean || CheckHitByLeaning(HitResult, CoverLocationInTestHeight, TestTargetActor, TestTargetLocation, World))
+		if (!bTestHitByLean || CheckHitByLeaning(CoverPoint, HitResult, CoverLocationInTestHeight, TestTargetActor, TestTargetLocation, Sweeper))
 		{
 			return ECoverQueryResult::Found;	
 		}
@@ -294,9 +1165,58 @@ ECoverQueryResult UEnvQueryTest_Cover::EvaluateCoverPoint(const FCoverPointOctre
 	return ECoverQueryResult::NotFound;
 }
 
-bool UEnvQueryTest_Cover::CheckHitByLeaning(const FHitResult& CoverHitResult, const FVector& CoverLocation,
-                                            AActor* TestTargetActor, const FVector& TestTargetLocation,
-                                            UWorld* World) const
+uint32 UEnvQueryTest_Cover::GetResultCacheSettingsHash() const
+{
+	uint32 Hash = GetTypeHash(static_cast<uint8>(CoverTraceChannel));
+	Hash = HashCombine(Hash, GetTypeHash(static_cast<uint8>(TargetTraceChannel)));
+	Hash = HashCombine(Hash, GetTypeHash(CoverPointMaxObjectHitDistance));
+	Hash = HashCombine(Hash, GetTypeHash(CoverOutOffset.GetValue()));
+	Hash = HashCombine(Hash, GetTypeHash(ProtectionMaskHeightTolerance));
+	Hash = HashCombine(Hash, GetTypeHash(VisibilityTableSnapDistance));
+	Hash = HashCombine(Hash, GetTypeHash(bUseCoverMetadata));
+	Hash = HashCombine(Hash, GetTypeHash(bUseProtectionMask));
+	return HashCombine(Hash, GetTypeHash(bUseVisibilityTable));
+}
+
+ECoverProtection UEnvQueryTest_Cover::GetProtectionFromMask(const FEnvQueryCoverPointItem* CoverPoint, const float CoverTestHeight, const FVector& TestDir) const
+{
+	// the masks are generated with the metadata facing, which is needed for the lean check instead of the sweep's impact normal
+	if (!bUseProtectionMask || !bUseCoverMetadata || !FMath::IsNearlyEqual(CoverPointMaxObjectHitDistance, UCoverSystemStatics::CoverProtectionDistance))
+		return ECoverProtection::Unknown;
+
+	// the masks were swept on the generator's channel, which may hit other objects than the test's
+	const FCoverPointMetadata& Metadata = CoverPoint->Metadata;
+	if (Metadata.TraceChannel != UEngineTypes::ConvertToCollisionChannel(CoverTraceChannel))
+		return ECoverProtection::Unknown;
+
+	// the standing masks are only swept for standing-height cover, they're empty otherwise rather than open
+	if (FMath::Abs(CoverTestHeight - UCoverSystemStatics::StandingCoverHeight) <= ProtectionMaskHeightTolerance)
+		return Metadata.Height == ECoverHeight::Standing ? Metadata.GetProtection(ECoverHeight::Standing, TestDir) : ECoverProtection::Unknown;
+
+	if (FMath::Abs(CoverTestHeight - UCoverSystemStatics::CrouchCoverHeight) <= ProtectionMaskHeightTolerance)
+		return Metadata.GetProtection(ECoverHeight::Crouch, TestDir);
+
+	// too far from the generated heights, let the sweep decide
+	return ECoverProtection::Unknown;
+}
+
+bool UEnvQueryTest_Cover::CanUseGeneratedHeight(const FCoverPointMetadata& Metadata) const
+{
+	// a shorter trace could have missed cover the sweep hits
+	return bUseCoverMetadata && Metadata.TraceChannel == UEngineTypes::ConvertToCollisionChannel(CoverTraceChannel)
+		&& Metadata.HeightTraceDistance >= CoverPointMaxObjectHitDistance * 1.5f;
+}
+
+bool UEnvQueryTest_Cover::CanUseGeneratedLean(const FCoverPointMetadata& Metadata) const
+{
+	// the lean locations aren't checked for crouch-height cover, it never can lean
+	return bUseCoverMetadata && Metadata.TraceChannel == UEngineTypes::ConvertToCollisionChannel(CoverTraceChannel)
+		&& Metadata.Height == ECoverHeight::Standing && FMath::IsNearlyEqual(Metadata.LeanOffset, CoverOutOffset.GetValue());
+}
+
+bool UEnvQueryTest_Cover::CheckHitByLeaning(const FEnvQueryCoverPointItem* CoverPoint, const FHitResult& CoverHitResult,
+                                            const FVector& CoverLocation, AActor* TestTargetActor, const FVector& TestTargetLocation,
+                                            FCoverSweepProvider& Sweeper) const
 {
 	FHitResult HitResult(1.0f);
 	FCollisionShape SphereCollisionShape;
@@ -308,62 +1228,80 @@ bool UEnvQueryTest_Cover::CheckHitByLeaning(const FHitResult& CoverHitResult, co
 	//with this collision channel, we should only be hitting cover
 	ECollisionChannel CollisionChannel = UEngineTypes::ConvertToCollisionChannel(CoverTraceChannel);
 
+	// the generated facing is on the XY plane, same as the one used for the generated lean availability
+	const FCoverPointMetadata& Metadata = CoverPoint->Metadata;
+	const FVector CoverNormal = bUseCoverMetadata ? Metadata.FacingNormal : CoverHitResult.ImpactNormal;
+	
 	// calculate our reach for when leaning out of cover
-	const FVector LeanCheckOffset = UCoverSystemStatics::GetPerpendicularVector(CoverHitResult.ImpactNormal).GetUnsafeNormal() * CoverOutOffset.GetValue();
+	const FVector LeanCheckOffset = UCoverSystemStatics::GetPerpendicularVector(CoverNormal).GetUnsafeNormal() * CoverOutOffset.GetValue();
+	const bool bUseGeneratedLean = CanUseGeneratedLean(Metadata);
 
-	auto CheckHitLambda = [&](const FVector& CoverLeanStart) -> bool
+	auto CheckHitLambda = [&](const FVector& CoverLeanStart, const bool bCanLean) -> bool
 	{
 #if DEBUG_RENDERING
-		if (CVarDrawEnvQueryCoverLeanTrace.GetValueOnAnyThread())
+		if (CVarDrawEnvQueryCoverLeanTrace.GetValueOnAnyThread() && IsInGameThread())
 		{
-			DrawDebugLine(World, CoverLocation, CoverLeanStart, FColor::Purple, true, -1, 0, 5.0f);
+			DrawDebugLine(Sweeper.GetWorld(), CoverLocation, CoverLeanStart, FColor::Purple, true, -1, 0, 5.0f);
 		}
 #endif
 
-		//move 10 units back from the lean check location and trace to see if we start in penetrating
-		const FVector CheckPenetrating = CoverLeanStart + CoverHitResult.ImpactNormal * 10.0f;
-		const bool bCheckPenetrating = World->SweepSingleByChannel(HitResult, CheckPenetrating, CoverLeanStart, FQuat::Identity, CollisionChannel, SphereCollisionShape, CollisionQueryParams);
-		if (bCheckPenetrating || HitResult.bStartPenetrating)
+		if (bUseGeneratedLean)
 		{
-			return false;
+			// the generator already did the penetration check below
+			if (!bCanLean)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			//move 10 units back from the lean check location and trace to see if we start in penetrating
+			const FVector CheckPenetrating = CoverLeanStart + CoverNormal * 10.0f;
+			const bool bCheckPenetrating = Sweeper.Sweep(HitResult, CheckPenetrating, CoverLeanStart, CollisionChannel, SphereCollisionShape, CollisionQueryParams);
+			if (bCheckPenetrating || HitResult.bStartPenetrating)
+			{
+				return false;
+			}
 		}
 		
 		// check if we can hit our target by leaning out of cover
-		const bool bHit = World->SweepSingleByChannel(HitResult, CoverLeanStart, TestTargetLocation, FQuat::Identity, CollisionChannel, SphereCollisionShape, CollisionQueryParams);
+		const bool bHit = Sweeper.Sweep(HitResult, CoverLeanStart, TestTargetLocation, CollisionChannel, SphereCollisionShape, CollisionQueryParams);
 		if ((!bHit || HitResult.GetActor() == TestTargetActor) && !HitResult.bStartPenetrating)
 		{
 #if DEBUG_RENDERING
-			if (CVarDrawEnvQueryCoverLeanTrace.GetValueOnAnyThread())
+			if (CVarDrawEnvQueryCoverLeanTrace.GetValueOnAnyThread() && IsInGameThread())
 			{
-				DrawDebugLine(World, CoverLeanStart, TestTargetLocation, FColor::Red, true, -1, 0, 10.0f);
+				DrawDebugLine(Sweeper.GetWorld(), CoverLeanStart, TestTargetLocation, FColor::Red, true, -1, 0, 10.0f);
 			}
 #endif
 			return true;
 		}
 
 #if DEBUG_RENDERING
-		if (CVarDrawEnvQueryCoverLeanTrace.GetValueOnAnyThread())
+		if (CVarDrawEnvQueryCoverLeanTrace.GetValueOnAnyThread() && IsInGameThread())
 		{
-			DrawDebugLine(World, CoverLeanStart, TestTargetLocation, FColor::Blue, true, -1, 0, 10.0f);
+			DrawDebugLine(Sweeper.GetWorld(), CoverLeanStart, TestTargetLocation, FColor::Blue, true, -1, 0, 10.0f);
 		}
 #endif
 		return false;
 	};
 	
-	return CheckHitLambda(CoverLocation + 1.0f * LeanCheckOffset) ||
-		CheckHitLambda(CoverLocation - 1.0f * LeanCheckOffset);
+	// the perpendicular vector of the facing is on the left when looking at the cover object
+	return CheckHitLambda(CoverLocation + 1.0f * LeanCheckOffset, Metadata.bCanLeanLeft) ||
+		CheckHitLambda(CoverLocation - 1.0f * LeanCheckOffset, Metadata.bCanLeanRight);
 }
 
-ECoverQueryResult UEnvQueryTest_Cover::EvaluateCrouchCoverPoint(const FCoverPointOctreeElement* CoverPoint, const float StandingTestHeight,
-												   const float CoverTestHeight, AActor* TestTargetActor, const FVector& TestTargetLocation, UWorld* World) const
+ECoverQueryResult UEnvQueryTest_Cover::EvaluateCrouchCoverPoint(const FEnvQueryCoverPointItem* CoverPoint, const float StandingTestHeight,
+												   const float CoverTestHeight, AActor* TestTargetActor, const FVector& TestTargetLocation, FCoverSweepProvider& Sweeper,
+												   const FCoverVisibilityTable* VisibilityTable, const FCoverHandle* TestTargetCoverPoint) const
 {
-	const ECoverQueryResult CoverResult = EvaluateCoverPoint(CoverPoint, CoverTestHeight, TestTargetActor, TestTargetLocation, false, World);
+	const ECoverQueryResult CoverResult = EvaluateCoverPoint(CoverPoint, CoverTestHeight, TestTargetActor, TestTargetLocation, false, Sweeper, VisibilityTable, TestTargetCoverPoint);
 
 	if (CoverResult != ECoverQueryResult::Found)
 		return CoverResult;
 	
 	//test from the standing height position that we can actually hit the target
-	const FVector CoverLocation = CoverPoint->Data->Location;
+	const FVector CoverLocation = CoverPoint->Location;
 	const FVector CoverLocationInTestHeight = FVector(CoverLocation.X, CoverLocation.Y, CoverLocation.Z - UCoverSystemStatics::CoverPointGroundOffset + StandingTestHeight);
 
 	FHitResult HitResult(1.0f);
@@ -377,14 +1315,21 @@ ECoverQueryResult UEnvQueryTest_Cover::EvaluateCrouchCoverPoint(const FCoverPoin
 	//with this collision channel, we should only be hitting cover
 	ECollisionChannel CollisionChannel = UEngineTypes::ConvertToCollisionChannel(TargetTraceChannel);
 
+	// only usable if the table was traced on the target channel
+	const ECoverVisibility TableVisibility = VisibilityTable && TestTargetCoverPoint
+		? VisibilityTable->GetVisibility(CoverPoint->Handle, *TestTargetCoverPoint, StandingTestHeight, ProtectionMaskHeightTolerance, CollisionChannel)
+		: ECoverVisibility::Unknown;
+	if (TableVisibility != ECoverVisibility::Unknown)
+		return TableVisibility == ECoverVisibility::Visible ? ECoverQueryResult::Found : ECoverQueryResult::Found_NoView;
+
 	// check if we can hit the enemy straight from the cover point. if we can, then the cover point is no good
-	const bool bHit = World->SweepSingleByChannel(HitResult, CoverLocationInTestHeight, TestTargetLocation, FQuat::Identity,  CollisionChannel, SphereCollisionShape, CollisionQueryParams);
+	const bool bHit = Sweeper.Sweep(HitResult, CoverLocationInTestHeight, TestTargetLocation, CollisionChannel, SphereCollisionShape, CollisionQueryParams);
 	if (bHit && HitResult.GetActor() != TestTargetActor)
 	{
 #if DEBUG_RENDERING
-		if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread())
+		if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread() && IsInGameThread())
 		{
-			DrawDebugLine(World, CoverLocationInTestHeight, TestTargetLocation, FColor::Orange, true, -1, 0, 10.0f);
+			DrawDebugLine(Sweeper.GetWorld(), CoverLocationInTestHeight, TestTargetLocation, FColor::Orange, true, -1, 0, 10.0f);
 		}
 #endif
 		
@@ -392,11 +1337,108 @@ ECoverQueryResult UEnvQueryTest_Cover::EvaluateCrouchCoverPoint(const FCoverPoin
 	}
 
 #if DEBUG_RENDERING
-	if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread())
+	if (CVarDrawEnvQueryCoverTrace.GetValueOnAnyThread() && IsInGameThread())
 	{
-		DrawDebugLine(World, CoverLocationInTestHeight, TestTargetLocation, FColor::Yellow, true, -1, 0, 10.0f);
+		DrawDebugLine(Sweeper.GetWorld(), CoverLocationInTestHeight, TestTargetLocation, FColor::Yellow, true, -1, 0, 10.0f);
 	}
 #endif
 
 	return ECoverQueryResult::Found;
 }
+
+#if !UE_BUILD_SHIPPING
+/**
+ * CoverSystem.BenchmarkCoverTest, times the serial and parallel evaluation of the default test against the pawns in the world
+ * @param Args [MaxCoverPoints=1024] [MaxTargets=4]
+ */
+static void BenchmarkCoverTestEvaluation(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 MaxCoverPoints = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1024;
+	const int32 MaxTargets = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 4;
+
+	TActorIterator<ACoverRecastNavMesh> NavMeshIt(World);
+	if (!NavMeshIt)
+	{
+		UE_LOG(LogEQS, Warning, TEXT("CoverSystem.BenchmarkCoverTest: no ACoverRecastNavMesh in the world"));
+		return;
+	}
+
+	TArray<FCoverPointOctreeElement> AllCoverPoints;
+	NavMeshIt->FindCoverPoints(NavMeshIt->GetNavMeshBounds(), AllCoverPoints);
+	
+	FCoverTestQueryTargets Targets;
+	for (TActorIterator<APawn> PawnIt(World); PawnIt && Targets.Actors.Num() < MaxTargets; ++PawnIt)
+	{
+		FVector EyeLocation;
+		FRotator EyeRotation;
+		PawnIt->GetActorEyesViewPoint(EyeLocation, EyeRotation);
+		
+		Targets.Actors.Add(*PawnIt);
+		Targets.EyeLocations.Add(EyeLocation);
+		Targets.CoverPoints.Add(FCoverHandle());
+		Targets.PrimaryTargets.Add(false);
+	}
+
+	if (AllCoverPoints.Num() == 0 || Targets.Actors.Num() == 0)
+	{
+		UE_LOG(LogEQS, Warning, TEXT("CoverSystem.BenchmarkCoverTest: needs cover points and pawns in the world, found %d cover points and %d pawns"),
+			AllCoverPoints.Num(), Targets.Actors.Num());
+		return;
+	}
+
+	// measure the sweeps, not the cache
+	FCoverEvaluationParams Params;
+	Params.World = World;
+	Params.StandingEyeHeight = UCoverSystemStatics::StandingCoverHeight;
+	Params.CrouchingEyeHeight = UCoverSystemStatics::CrouchCoverHeight;
+	Params.bTestCrouchHeight = true;
+
+	const UEnvQueryTest_Cover* Test = GetDefault<UEnvQueryTest_Cover>();
+	const int32 NumCoverPointsEnd = FMath::Min(MaxCoverPoints, AllCoverPoints.Num());
+	for (int32 NumCoverPoints = FMath::Min(16, NumCoverPointsEnd); NumCoverPoints > 0; NumCoverPoints = NumCoverPoints < NumCoverPointsEnd ? FMath::Min(NumCoverPoints * 2, NumCoverPointsEnd) : 0)
+	{
+		TArray<FEnvQueryCoverPointItem> CoverPoints;
+		CoverPoints.Reserve(NumCoverPoints);
+		for (int32 CoverPointIdx = 0; CoverPointIdx < NumCoverPoints; ++CoverPointIdx)
+		{
+			CoverPoints.Emplace(AllCoverPoints[CoverPointIdx]);
+		}
+
+
+		double StartTime = FPlatformTime::Seconds();
+		TArray<TOptional<ECoverQueryResult>> SerialResults;
+		SerialResults.SetNum(NumCoverPoints * Targets.Actors.Num());
+		for (int32 PairIdx = 0; PairIdx < SerialResults.Num(); ++PairIdx)
+		{
+			ECoverQueryResult CoverResult;
+			if (Test->EvaluateCoverPointForTarget(CoverPoints[PairIdx / Targets.Actors.Num()], Targets, PairIdx % Targets.Actors.Num(), Params, CoverResult))
+			{
+				SerialResults[PairIdx] = CoverResult;
+			}
+		}
+		const double SerialTime = FPlatformTime::Seconds() - StartTime;
+
+		StartTime = FPlatformTime::Seconds();
+		TArray<TOptional<ECoverQueryResult>> ParallelResults;
+		Test->EvaluateCoverPointsParallel(CoverPoints, Targets, Params, ParallelResults);
+		const double ParallelTime = FPlatformTime::Seconds() - StartTime;
+
+		int32 NumMismatches = 0;
+		for (int32 PairIdx = 0; PairIdx < SerialResults.Num(); ++PairIdx)
+		{
+			NumMismatches += SerialResults[PairIdx] != ParallelResults[PairIdx] ? 1 : 0;
+		}
+
+		UE_LOG(LogEQS, Display, TEXT("CoverSystem.BenchmarkCoverTest: %5d cover points x %d targets, serial %8.3f ms, parallel %8.3f ms, speedup %5.2fx, %d workers, %d mismatches"),
+			NumCoverPoints, Targets.Actors.Num(), SerialTime * 1000.0, ParallelTime * 1000.0, ParallelTime > 0.0 ? SerialTime / ParallelTime : 0.0,
+			FTaskGraphInterface::Get().GetNumWorkerThreads() + 1, NumMismatches);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkCoverTestCommand(
+	TEXT("CoverSystem.BenchmarkCoverTest"),
+	TEXT("Times the serial and parallel cover test evaluation of increasing numbers of cover points against the pawns in the world.\n")
+	TEXT("Args: [MaxCoverPoints=1024] [MaxTargets=4]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkCoverTestEvaluation),
+	ECVF_Cheat);
+#endif
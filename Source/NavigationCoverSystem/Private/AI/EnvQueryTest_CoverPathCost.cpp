@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/EnvQueryTest_CoverPathCost.h"
+
+#include "AI/EnvQueryItemType_CoverPoint.h"
+
+#define LOCTEXT_NAMESPACE "EnvQueryTest"
+
+UEnvQueryTest_CoverPathCost::UEnvQueryTest_CoverPathCost()
+	: Super()
+{
+	Cost = EEnvTestCost::Low;
+	ValidItemType = UEnvQueryItemType_CoverPoint::StaticClass();
+	SetWorkOnFloatValues(true);
+}
+
+void UEnvQueryTest_CoverPathCost::RunTest(FEnvQueryInstance& QueryInstance) const
+{
+	UObject* QueryOwner = QueryInstance.Owner.Get();
+	if (QueryOwner == nullptr)
+	{
+		return;
+	}
+
+	FloatValueMin.BindData(QueryOwner, QueryInstance.QueryID);
+	FloatValueMax.BindData(QueryOwner, QueryInstance.QueryID);
+	const float MinThresholdValue = FloatValueMin.GetValue();
+	const float MaxThresholdValue = FloatValueMax.GetValue();
+
+	for (FEnvQueryInstance::ItemIterator It(this, QueryInstance); It; ++It)
+	{
+		const FEnvQueryCoverPointItem& Item = UEnvQueryItemType_CoverPoint::GetValue(QueryInstance.RawData.GetData() + QueryInstance.Items[It.GetIndex()].DataOffset);
+		if (Item.PathCost >= 0.0f)
+		{
+			It.SetScore(TestPurpose, FilterType, Item.PathCost, MinThresholdValue, MaxThresholdValue);
+		}
+	}
+}
+
+FText UEnvQueryTest_CoverPathCost::GetDescriptionTitle() const
+{
+	return FText::Format(LOCTEXT("CoverPathCostTitle", "{0}: path cost from generator"), Super::GetDescriptionTitle());
+}
+
+FText UEnvQueryTest_CoverPathCost::GetDescriptionDetails() const
+{
+	return DescribeFloatTestParams();
+}
+
+#undef LOCTEXT_NAMESPACE
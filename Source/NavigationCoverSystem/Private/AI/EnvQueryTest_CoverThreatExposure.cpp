@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/EnvQueryTest_CoverThreatExposure.h"
+
+#include "CoverRecastNavMesh.h"
+#include "CoverSystemStatics.h"
+#include "NavigationSystem.h"
+#include "AI/EnvQueryItemType_CoverPoint.h"
+#include "EnvironmentQuery/Items/EnvQueryItemType_VectorBase.h"
+
+#define LOCTEXT_NAMESPACE "EnvQueryTest"
+
+UEnvQueryTest_CoverThreatExposure::UEnvQueryTest_CoverThreatExposure()
+	: Super()
+{
+	Cost = EEnvTestCost::Low;
+	ValidItemType = UEnvQueryItemType_VectorBase::StaticClass();
+	SetWorkOnFloatValues(true);
+}
+
+void UEnvQueryTest_CoverThreatExposure::RunTest(FEnvQueryInstance& QueryInstance) const
+{
+	UObject* QueryOwner = QueryInstance.Owner.Get();
+	if (QueryOwner == nullptr)
+	{
+		return;
+	}
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(QueryInstance.World);
+	INavAgentInterface* NavAgent = Cast<INavAgentInterface>(QueryOwner);
+	if (NavSys == nullptr || NavAgent == nullptr)
+	{
+		return;
+	}
+
+	const ACoverRecastNavMesh* NavData = UCoverSystemStatics::FindNavigationData<ACoverRecastNavMesh>(*NavSys, NavAgent);
+	if (!NavData || !NavData->GetCoverThreatMap().IsEnabled())
+		return;
+
+	const FCoverThreatMap& ThreatMap = NavData->GetCoverThreatMap();
+
+	FloatValueMin.BindData(QueryOwner, QueryInstance.QueryID);
+	FloatValueMax.BindData(QueryOwner, QueryInstance.QueryID);
+	const float MinThresholdValue = FloatValueMin.GetValue();
+	const float MaxThresholdValue = FloatValueMax.GetValue();
+
+	const bool bCoverPointItems = QueryInstance.ItemType && QueryInstance.ItemType->IsChildOf(UEnvQueryItemType_CoverPoint::StaticClass());
+	for (FEnvQueryInstance::ItemIterator It(this, QueryInstance); It; ++It)
+	{
+		FCoverHandle Handle;
+		if (bCoverPointItems)
+		{
+			Handle = UEnvQueryItemType_CoverPoint::GetValue(QueryInstance.RawData.GetData() + QueryInstance.Items[It.GetIndex()].DataOffset).Handle;
+		}
+		else
+		{
+			FCoverPointOctreeElement Element;
+			if (NavData->GetCoverPointOctreeElement(Element, GetItemLocation(QueryInstance, It.GetIndex())))
+			{
+				Handle = Element.Data->Handle;
+			}
+		}
+
+		if (Handle.IsValid())
+		{
+			It.SetScore(TestPurpose, FilterType, ThreatMap.GetCoverPointExposure(Handle), MinThresholdValue, MaxThresholdValue);
+		}
+	}
+}
+
+FText UEnvQueryTest_CoverThreatExposure::GetDescriptionTitle() const
+{
+	return FText::Format(LOCTEXT("CoverThreatExposureTitle", "{0}: exposure to threats"), Super::GetDescriptionTitle());
+}
+
+FText UEnvQueryTest_CoverThreatExposure::GetDescriptionDetails() const
+{
+	return DescribeFloatTestParams();
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,341 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoverCrowd.h"
+
+#include "CoverRecastNavMesh.h"
+#include "CoverSystemStatics.h"
+#include "CoverThreatMap.h"
+#include "EngineUtils.h"
+
+FCoverCrowd::FCoverCrowd(ACoverRecastNavMesh* InNavMesh)
+	: ChunkSize(1000.0f), MaxThreatExposure(1.0f), ExposureCost(1000.0f), NavMesh(InNavMesh), InvalidationSubscriberId(INDEX_NONE)
+{
+	if (InNavMesh)
+	{
+		InvalidationSubscriberId = InNavMesh->GetCoverInvalidationNotifier().AddSubscriber([this](const TArray<FCoverInvalidation>& Invalidations)
+		{
+			OnCoverInvalidated(Invalidations);
+		});
+	}
+}
+
+FCoverCrowd::~FCoverCrowd()
+{
+	for (TConstSetBitIterator<> It(ActiveEntities); It; ++It)
+	{
+		ReleaseCover(It.GetIndex());
+	}
+
+	if (NavMesh.IsValid())
+	{
+		NavMesh->GetCoverInvalidationNotifier().RemoveSubscriber(InvalidationSubscriberId);
+	}
+}
+
+int32 FCoverCrowd::AddEntity(const FVector& Location, const float SearchRadius)
+{
+	int32 EntityId;
+	if (FreeEntityIds.Num() > 0)
+	{
+		EntityId = FreeEntityIds.Pop(false);
+		ActiveEntities[EntityId] = true;
+	}
+	else
+	{
+		EntityId = LocationFragments.AddDefaulted();
+		CoverFragments.AddDefaulted();
+		ActiveEntities.Add(true);
+	}
+
+	LocationFragments[EntityId].Location = Location;
+
+	FCoverCrowdCoverFragment& CoverFragment = CoverFragments[EntityId];
+	CoverFragment.SearchRadius = SearchRadius;
+	CoverFragment.State = ECoverCrowdState::Idle;
+	CoverFragment.Cover = FCoverHandle();
+	CoverFragment.CoverLocation = FVector::ZeroVector;
+
+	return EntityId;
+}
+
+void FCoverCrowd::RemoveEntity(const int32 EntityId)
+{
+	if (!IsValidEntity(EntityId))
+		return;
+
+	ReleaseCover(EntityId);
+	ActiveEntities[EntityId] = false;
+	FreeEntityIds.Add(EntityId);
+}
+
+void FCoverCrowd::SetEntityLocation(const int32 EntityId, const FVector& Location)
+{
+	if (IsValidEntity(EntityId))
+	{
+		LocationFragments[EntityId].Location = Location;
+	}
+}
+
+void FCoverCrowd::RequestCover(const int32 EntityId)
+{
+	if (!IsValidEntity(EntityId))
+		return;
+
+	ReleaseCover(EntityId);
+	CoverFragments[EntityId].State = ECoverCrowdState::Pending;
+	PendingEntityIds.Add(EntityId);
+}
+
+void FCoverCrowd::ReleaseCover(const int32 EntityId)
+{
+	if (!IsValidEntity(EntityId))
+		return;
+
+	FCoverCrowdCoverFragment& CoverFragment = CoverFragments[EntityId];
+	if (CoverFragment.State == ECoverCrowdState::InCover)
+	{
+		CoverToEntity.Remove(CoverFragment.Cover.Id);
+		if (NavMesh.IsValid())
+		{
+			NavMesh->ReleaseCover(CoverFragment.Cover);
+			NavMesh->GetCoverInvalidationNotifier().Unwatch(InvalidationSubscriberId, CoverFragment.Cover);
+		}
+	}
+
+	CoverFragment.State = ECoverCrowdState::Idle;
+	CoverFragment.Cover = FCoverHandle();
+}
+
+int32 FCoverCrowd::Process(const double TimeBudget)
+{
+	if (PendingEntityIds.Num() == 0 || !NavMesh.IsValid())
+		return 0;
+
+	SCOPE_CYCLE_COUNTER(STAT_CoverCrowdProcess);
+	const double StartTime = FPlatformTime::Seconds();
+
+	// nearby entities search mostly the same cover points
+	TMap<FIntVector, TArray<int32>> Chunks;
+	for (const int32 EntityId : PendingEntityIds)
+	{
+		if (!IsValidEntity(EntityId) || CoverFragments[EntityId].State != ECoverCrowdState::Pending)
+			continue;
+
+		const FVector& Location = LocationFragments[EntityId].Location;
+		const FIntVector ChunkCoords(FMath::FloorToInt(Location.X / ChunkSize), FMath::FloorToInt(Location.Y / ChunkSize), 0);
+		TArray<int32>& ChunkEntityIds = Chunks.FindOrAdd(ChunkCoords);
+
+		// an entity can be requested again before it's processed
+		ChunkEntityIds.AddUnique(EntityId);
+	}
+
+	PendingEntityIds.Reset();
+
+	int32 NumProcessed = 0;
+	for (const auto& Chunk : Chunks)
+	{
+		if (NumProcessed > 0 && FPlatformTime::Seconds() - StartTime >= TimeBudget)
+		{
+			PendingEntityIds.Append(Chunk.Value);
+			continue;
+		}
+
+		ProcessChunk(Chunk.Value);
+		NumProcessed += Chunk.Value.Num();
+	}
+
+	INC_DWORD_STAT_BY(STAT_CoverCrowdEntities, NumProcessed);
+	SET_FLOAT_STAT(STAT_CoverCrowdCostPerEntity, NumProcessed > 0 ? (FPlatformTime::Seconds() - StartTime) * 1000000.0 / NumProcessed : 0.0);
+
+	return NumProcessed;
+}
+
+void FCoverCrowd::ProcessChunk(const TArray<int32>& EntityIds)
+{
+	INC_DWORD_STAT(STAT_CoverCrowdTraversals);
+
+	FBox ChunkBounds(ForceInit);
+	float MaxSearchRadius = 0.0f;
+	for (const int32 EntityId : EntityIds)
+	{
+		ChunkBounds += LocationFragments[EntityId].Location;
+		MaxSearchRadius = FMath::Max(MaxSearchRadius, CoverFragments[EntityId].SearchRadius);
+	}
+
+	TArray<FCoverPointOctreeElement> CoverPoints;
+	NavMesh->FindCoverPoints(FSphere(ChunkBounds.GetCenter(), ChunkBounds.GetExtent().Size() + MaxSearchRadius), CoverPoints);
+
+	const FCoverThreatMap& ThreatMap = NavMesh->GetCoverThreatMap();
+	const bool bUseThreatMap = ThreatMap.IsEnabled() && ThreatMap.GetNumThreats() > 0;
+
+	TArray<FCoverPointOctreeElement> FreeCoverPoints;
+	TArray<float> Exposures;
+	FreeCoverPoints.Reserve(CoverPoints.Num());
+	Exposures.Reserve(CoverPoints.Num());
+	for (const FCoverPointOctreeElement& CoverPoint : CoverPoints)
+	{
+		const FCoverPointOctreeData& Data = *CoverPoint.Data;
+		if (Data.bTaken || Data.bForceField || NavMesh->IsCoverAreaReserved(Data.Location))
+			continue;
+
+		const float Exposure = bUseThreatMap ? ThreatMap.GetCoverPointExposure(Data.Handle) : 0.0f;
+		if (Exposure > MaxThreatExposure)
+			continue;
+
+		FreeCoverPoints.Add(CoverPoint);
+		Exposures.Add(Exposure);
+	}
+
+	// assign the cheapest entity and cover point pairs first, so the entities don't all take the same cover
+	struct FCandidatePair
+	{
+		float Cost;
+		int32 EntityIdx;
+		int32 CoverPointIdx;
+	};
+
+	TArray<FCandidatePair> Pairs;
+	for (int32 EntityIdx = 0; EntityIdx < EntityIds.Num(); ++EntityIdx)
+	{
+		const FVector& Location = LocationFragments[EntityIds[EntityIdx]].Location;
+		const float SearchRadiusSq = FMath::Square(CoverFragments[EntityIds[EntityIdx]].SearchRadius);
+		for (int32 CoverPointIdx = 0; CoverPointIdx < FreeCoverPoints.Num(); ++CoverPointIdx)
+		{
+			const float DistanceSq = FVector::DistSquared(Location, FreeCoverPoints[CoverPointIdx].Data->Location);
+			if (DistanceSq <= SearchRadiusSq)
+			{
+				Pairs.Add({FMath::Sqrt(DistanceSq) + Exposures[CoverPointIdx] * ExposureCost, EntityIdx, CoverPointIdx});
+			}
+		}
+	}
+
+	Pairs.Sort([](const FCandidatePair& A, const FCandidatePair& B) { return A.Cost < B.Cost; });
+
+	TBitArray<> AssignedEntities(false, EntityIds.Num());
+	TBitArray<> UsedCoverPoints(false, FreeCoverPoints.Num());
+	int32 NumAssigned = 0;
+	for (const FCandidatePair& Pair : Pairs)
+	{
+		if (NumAssigned == EntityIds.Num())
+			break;
+
+		if (AssignedEntities[Pair.EntityIdx] || UsedCoverPoints[Pair.CoverPointIdx])
+			continue;
+
+		UsedCoverPoints[Pair.CoverPointIdx] = true;
+		const FCoverPointOctreeData& Data = *FreeCoverPoints[Pair.CoverPointIdx].Data;
+
+		// fails if it was taken since the traversal, e.g. by an agent using EQS
+		if (!NavMesh->HoldCover(Data.Handle))
+			continue;
+
+		FCoverCrowdCoverFragment& CoverFragment = CoverFragments[EntityIds[Pair.EntityIdx]];
+		CoverFragment.State = ECoverCrowdState::InCover;
+		CoverFragment.Cover = Data.Handle;
+		CoverFragment.CoverLocation = Data.Location;
+		CoverToEntity.Add(Data.Handle.Id, EntityIds[Pair.EntityIdx]);
+		NavMesh->GetCoverInvalidationNotifier().Watch(InvalidationSubscriberId, Data.Handle);
+		AssignedEntities[Pair.EntityIdx] = true;
+		++NumAssigned;
+	}
+
+	for (int32 EntityIdx = 0; EntityIdx < EntityIds.Num(); ++EntityIdx)
+	{
+		if (!AssignedEntities[EntityIdx])
+		{
+			CoverFragments[EntityIds[EntityIdx]].State = ECoverCrowdState::NoCover;
+		}
+	}
+}
+
+void FCoverCrowd::OnCoverInvalidated(const TArray<FCoverInvalidation>& Invalidations)
+{
+	if (!NavMesh.IsValid())
+		return;
+
+	for (const FCoverInvalidation& Invalidation : Invalidations)
+	{
+		// the poly of the cover point doesn't matter here
+		if (Invalidation.Reason == ECoverInvalidationReason::Updated)
+			continue;
+
+		int32 EntityId;
+		if (!CoverToEntity.RemoveAndCopyValue(Invalidation.Handle.Id, EntityId))
+			continue;
+
+		// the removed cover point's reservation is still held
+		FCoverCrowdCoverFragment& CoverFragment = CoverFragments[EntityId];
+		NavMesh->ReleaseCover(Invalidation.Handle);
+
+		FCoverPointOctreeElement Replacement;
+		if (Invalidation.Reason == ECoverInvalidationReason::Replaced && NavMesh->GetCoverPointOctreeElement(Replacement, Invalidation.Replacement)
+			&& NavMesh->HoldCover(Invalidation.Replacement))
+		{
+			// the notifier already watches the replacement
+			CoverFragment.Cover = Invalidation.Replacement;
+			CoverFragment.CoverLocation = Replacement.Data->Location;
+			CoverToEntity.Add(Invalidation.Replacement.Id, EntityId);
+			continue;
+		}
+
+		NavMesh->GetCoverInvalidationNotifier().Unwatch(InvalidationSubscriberId, Invalidation.Replacement);
+		CoverFragment.State = ECoverCrowdState::Pending;
+		CoverFragment.Cover = FCoverHandle();
+		PendingEntityIds.Add(EntityId);
+	}
+}
+
+#if !UE_BUILD_SHIPPING
+/**
+ * CoverSystem.BenchmarkCrowd, spawns synthetic crowd entities at random navigable locations and selects cover for all of them,
+ * one time budget per simulated frame, then reports the cost per entity
+ * @param Args [NumEntities=1000] [SearchRadius=1500] [BudgetMs=2]
+ */
+static void BenchmarkCoverCrowd(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 NumEntities = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+	const float SearchRadius = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 1500.0f;
+	const double TimeBudget = (Args.Num() > 2 ? FCString::Atod(*Args[2]) : 2.0) / 1000.0;
+
+	TActorIterator<ACoverRecastNavMesh> NavMeshIt(World);
+	if (!NavMeshIt)
+	{
+		UE_LOG(LogNavigation, Warning, TEXT("CoverSystem.BenchmarkCrowd: no ACoverRecastNavMesh in the world"));
+		return;
+	}
+
+	FCoverCrowd Crowd(*NavMeshIt);
+	for (int32 EntityIdx = 0; EntityIdx < NumEntities; ++EntityIdx)
+	{
+		const FNavLocation SpawnLocation = NavMeshIt->GetRandomPoint();
+		Crowd.RequestCover(Crowd.AddEntity(SpawnLocation.Location, SearchRadius));
+	}
+
+	int32 NumFrames = 0;
+	const double StartTime = FPlatformTime::Seconds();
+	while (Crowd.GetNumPendingEntities() > 0)
+	{
+		Crowd.Process(TimeBudget);
+		++NumFrames;
+	}
+	const double TotalTime = FPlatformTime::Seconds() - StartTime;
+
+	int32 NumInCover = 0;
+	for (int32 EntityId = 0; EntityId < NumEntities; ++EntityId)
+	{
+		NumInCover += Crowd.GetEntityState(EntityId) == ECoverCrowdState::InCover ? 1 : 0;
+	}
+
+	UE_LOG(LogNavigation, Log, TEXT("CoverSystem.BenchmarkCrowd: %d entities, %d in cover, %d frames of %.2f ms, total %.2f ms, %.2f us per entity"),
+		NumEntities, NumInCover, NumFrames, TimeBudget * 1000.0, TotalTime * 1000.0, NumEntities > 0 ? TotalTime * 1000000.0 / NumEntities : 0.0);
+
+	// the crowd releases the cover it holds when it goes out of scope
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkCoverCrowdCommand(
+	TEXT("CoverSystem.BenchmarkCrowd"),
+	TEXT("Spawns synthetic crowd entities and selects cover for them. Args: [NumEntities=1000] [SearchRadius=1500] [BudgetMs=2]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkCoverCrowd),
+	ECVF_Cheat);
+#endif
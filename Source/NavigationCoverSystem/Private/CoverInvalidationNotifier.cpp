@@ -0,0 +1,241 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoverInvalidationNotifier.h"
+
+#include "CoverSystemStatics.h"
+#include "Containers/Ticker.h"
+
+FCoverInvalidationNotifier::FCoverInvalidationNotifier()
+	: ReplacementDistance(0.0f), NextSubscriberId(0), bHasPendingRemovals(false)
+{
+}
+
+FCoverInvalidationNotifier::~FCoverInvalidationNotifier()
+{
+	Reset();
+}
+
+void FCoverInvalidationNotifier::Init(const float InReplacementDistance)
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+		ReplacementDistance = InReplacementDistance;
+	}
+
+	if (!TickerHandle.IsValid())
+	{
+		TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FCoverInvalidationNotifier::Tick));
+	}
+}
+
+void FCoverInvalidationNotifier::Reset()
+{
+	if (TickerHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
+	}
+
+	FScopeLock ScopeLock(&Lock);
+	Subscribers.Empty();
+	Watchers.Empty();
+	PendingInvalidations.Empty();
+	PendingAdded.Empty();
+	bHasPendingRemovals = false;
+}
+
+int32 FCoverInvalidationNotifier::AddSubscriber(FOnCoverInvalidated&& OnInvalidated)
+{
+	FScopeLock ScopeLock(&Lock);
+	const int32 SubscriberId = NextSubscriberId++;
+	Subscribers.Add(SubscriberId).OnInvalidated = MoveTemp(OnInvalidated);
+	return SubscriberId;
+}
+
+void FCoverInvalidationNotifier::RemoveSubscriber(const int32 SubscriberId)
+{
+	FScopeLock ScopeLock(&Lock);
+	FSubscriber Subscriber;
+	if (!Subscribers.RemoveAndCopyValue(SubscriberId, Subscriber))
+		return;
+
+	for (const uint32 HandleId : Subscriber.WatchedHandles)
+	{
+		Watchers.RemoveSingle(HandleId, SubscriberId);
+	}
+}
+
+void FCoverInvalidationNotifier::Watch(const int32 SubscriberId, const FCoverHandle& Handle)
+{
+	FScopeLock ScopeLock(&Lock);
+	FSubscriber* Subscriber = Subscribers.Find(SubscriberId);
+	if (!Subscriber || !Handle.IsValid())
+		return;
+
+	bool bAlreadyWatched = false;
+	Subscriber->WatchedHandles.Add(Handle.Id, &bAlreadyWatched);
+	if (!bAlreadyWatched)
+	{
+		Watchers.Add(Handle.Id, SubscriberId);
+	}
+}
+
+void FCoverInvalidationNotifier::Unwatch(const int32 SubscriberId, const FCoverHandle& Handle)
+{
+	FScopeLock ScopeLock(&Lock);
+	FSubscriber* Subscriber = Subscribers.Find(SubscriberId);
+	if (Subscriber && Subscriber->WatchedHandles.Remove(Handle.Id) > 0)
+	{
+		Watchers.RemoveSingle(Handle.Id, SubscriberId);
+	}
+}
+
+void FCoverInvalidationNotifier::NotifyRemoved(const TArray<TPair<FCoverHandle, FVector>>& RemovedCoverPoints)
+{
+	FScopeLock ScopeLock(&Lock);
+	if (Watchers.Num() == 0)
+		return;
+
+	for (const TPair<FCoverHandle, FVector>& RemovedCoverPoint : RemovedCoverPoints)
+	{
+		AddInvalidationLocked(RemovedCoverPoint.Key, ECoverInvalidationReason::Removed, &RemovedCoverPoint.Value);
+	}
+}
+
+void FCoverInvalidationNotifier::NotifyAdded(const TArray<FCoverPointOctreeElement>& AddedCoverPoints)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	// a tile regeneration removes the stale cover points before adding the new ones
+	if (!bHasPendingRemovals)
+		return;
+
+	for (const FCoverPointOctreeElement& AddedCoverPoint : AddedCoverPoints)
+	{
+		PendingAdded.Emplace(AddedCoverPoint.Data->Handle, AddedCoverPoint.Data->Location);
+	}
+}
+
+void FCoverInvalidationNotifier::NotifyUpdated(const TArray<FCoverHandle>& UpdatedHandles)
+{
+	FScopeLock ScopeLock(&Lock);
+	if (Watchers.Num() == 0)
+		return;
+
+	for (const FCoverHandle& UpdatedHandle : UpdatedHandles)
+	{
+		AddInvalidationLocked(UpdatedHandle, ECoverInvalidationReason::Updated);
+	}
+}
+
+void FCoverInvalidationNotifier::NotifyAllRemoved()
+{
+	FScopeLock ScopeLock(&Lock);
+	TArray<uint32> WatchedHandleIds;
+	Watchers.GetKeys(WatchedHandleIds);
+	for (const uint32 HandleId : WatchedHandleIds)
+	{
+		AddInvalidationLocked(FCoverHandle(HandleId), ECoverInvalidationReason::Removed);
+	}
+}
+
+void FCoverInvalidationNotifier::AddInvalidationLocked(const FCoverHandle& Handle, const ECoverInvalidationReason Reason, const FVector* Location)
+{
+	if (!Watchers.Contains(Handle.Id))
+		return;
+
+	FPendingInvalidation& PendingInvalidation = PendingInvalidations.AddDefaulted_GetRef();
+	PendingInvalidation.Invalidation = FCoverInvalidation(Handle, Reason);
+	PendingInvalidation.Location = Location ? *Location : FVector::ZeroVector;
+	PendingInvalidation.bCanBeReplaced = Location != nullptr;
+	bHasPendingRemovals |= PendingInvalidation.bCanBeReplaced;
+}
+
+bool FCoverInvalidationNotifier::Tick(float DeltaTime)
+{
+	DispatchPendingInvalidations();
+	return true;
+}
+
+void FCoverInvalidationNotifier::DispatchPendingInvalidations()
+{
+	check(IsInGameThread());
+
+	TArray<TPair<FOnCoverInvalidated, TArray<FCoverInvalidation>>> Batches;
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (PendingInvalidations.Num() == 0)
+			return;
+
+		TArray<FPendingInvalidation> Invalidations = MoveTemp(PendingInvalidations);
+		TArray<TPair<FCoverHandle, FVector>> Added = MoveTemp(PendingAdded);
+		bHasPendingRemovals = false;
+
+		TMap<int32, int32> SubscriberToBatch;
+		const float ReplacementDistanceSq = FMath::Square(ReplacementDistance);
+		for (FPendingInvalidation& PendingInvalidation : Invalidations)
+		{
+			FCoverInvalidation& Invalidation = PendingInvalidation.Invalidation;
+
+			// the closest cover point regenerated near the removed one
+			if (PendingInvalidation.bCanBeReplaced)
+			{
+				float BestDistanceSq = ReplacementDistanceSq;
+				for (const TPair<FCoverHandle, FVector>& AddedCoverPoint : Added)
+				{
+					const float DistanceSq = FVector::DistSquared(AddedCoverPoint.Value, PendingInvalidation.Location);
+					if (DistanceSq <= BestDistanceSq)
+					{
+						BestDistanceSq = DistanceSq;
+						Invalidation.Reason = ECoverInvalidationReason::Replaced;
+						Invalidation.Replacement = AddedCoverPoint.Key;
+					}
+				}
+			}
+
+			TArray<int32> SubscriberIds;
+			Watchers.MultiFind(Invalidation.Handle.Id, SubscriberIds);
+			for (const int32 SubscriberId : SubscriberIds)
+			{
+				FSubscriber& Subscriber = Subscribers.FindChecked(SubscriberId);
+				const int32* BatchIdx = SubscriberToBatch.Find(SubscriberId);
+				if (!BatchIdx)
+				{
+					BatchIdx = &SubscriberToBatch.Add(SubscriberId, Batches.Emplace(Subscriber.OnInvalidated, TArray<FCoverInvalidation>()));
+				}
+
+				Batches[*BatchIdx].Value.Add(Invalidation);
+
+				// the handle is never used again, keep watching its replacement
+				if (Invalidation.Reason != ECoverInvalidationReason::Updated)
+				{
+					Subscriber.WatchedHandles.Remove(Invalidation.Handle.Id);
+					if (Invalidation.Reason == ECoverInvalidationReason::Replaced)
+					{
+						bool bAlreadyWatched = false;
+						Subscriber.WatchedHandles.Add(Invalidation.Replacement.Id, &bAlreadyWatched);
+						if (!bAlreadyWatched)
+						{
+							Watchers.Add(Invalidation.Replacement.Id, SubscriberId);
+						}
+					}
+				}
+			}
+
+			if (Invalidation.Reason != ECoverInvalidationReason::Updated)
+			{
+				Watchers.Remove(Invalidation.Handle.Id);
+			}
+
+			INC_DWORD_STAT_BY(STAT_CoverInvalidations, SubscriberIds.Num());
+		}
+	}
+
+	// outside of the lock, the subscribers can watch and unwatch handles
+	INC_DWORD_STAT_BY(STAT_CoverInvalidationBatches, Batches.Num());
+	for (const TPair<FOnCoverInvalidated, TArray<FCoverInvalidation>>& Batch : Batches)
+	{
+		Batch.Key(Batch.Value);
+	}
+}
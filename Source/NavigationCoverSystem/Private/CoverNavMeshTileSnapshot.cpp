@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoverNavMeshTileSnapshot.h"
+
+#include "CoverSystemStatics.h"
+#include "Detour/DetourNavMesh.h"
+#include "NavMesh/RecastHelpers.h"
+
+static_assert(FCoverNavMeshTileSnapshot::MaxPolyVerts == DT_VERTS_PER_POLYGON, "FCoverNavMeshTileSnapshot::MaxPolyVerts must match Detour");
+
+/** Squared 2d distance of given point PT to segment P-Q, in Unreal coordinates */
+static FORCEINLINE float PointDistToSegment2DSquared(const FVector& PT, const FVector& P, const FVector& Q)
+{
+	const FVector2D PQ(Q - P);
+	const float Length = PQ.SizeSquared();
+	float T = FVector2D::DotProduct(PQ, FVector2D(PT - P));
+	if (Length != 0)
+	{
+		T /= Length;
+	}
+
+	return (FVector2D(P) + PQ * T - FVector2D(PT)).SizeSquared();
+}
+
+FCoverNavMeshTileSnapshot::FCoverNavMeshTileSnapshot()
+	: TileIndex(0), Bounds(ForceInit), OffMeshBase(0)
+{
+}
+
+TSharedRef<const FCoverNavMeshTileSnapshot, ESPMode::ThreadSafe> FCoverNavMeshTileSnapshot::Capture(const ARecastNavMesh& NavMesh, const uint32 InTileIndex)
+{
+	check(IsInGameThread());
+
+	TSharedRef<FCoverNavMeshTileSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<FCoverNavMeshTileSnapshot, ESPMode::ThreadSafe>();
+	Snapshot->TileIndex = InTileIndex;
+
+	const dtNavMesh* DetourNavMesh = NavMesh.GetRecastMesh();
+	if (!DetourNavMesh || InTileIndex >= static_cast<uint32>(DetourNavMesh->getMaxTiles()))
+		return Snapshot;
+
+	const dtMeshTile* Tile = DetourNavMesh->getTile(InTileIndex);
+	if (!Tile || !Tile->header)
+		return Snapshot;
+
+	INC_DWORD_STAT(STAT_CoverTileSnapshots);
+
+	// same bounds the generator used to remove the stale cover points with
+	Snapshot->Bounds = NavMesh.GetNavMeshTileBounds(InTileIndex);
+	const float TileHeight = DetourNavMesh->getParams()->tileHeight;
+	if (TileHeight > 0 && Snapshot->Bounds.IsValid)
+	{
+		Snapshot->Bounds = Snapshot->Bounds.ExpandBy(FVector(0.0f, 0.0f, TileHeight * 0.5f));
+	}
+
+	const dtMeshHeader& Header = *Tile->header;
+	Snapshot->OffMeshBase = Header.offMeshBase;
+
+	Snapshot->Verts.SetNumUninitialized(Header.vertCount);
+	for (int32 VertIdx = 0; VertIdx < Header.vertCount; ++VertIdx)
+	{
+		Snapshot->Verts[VertIdx] = Recast2UnrealPoint(&Tile->verts[VertIdx * 3]);
+	}
+
+	Snapshot->DetailVerts.SetNumUninitialized(Header.detailVertCount);
+	for (int32 VertIdx = 0; VertIdx < Header.detailVertCount; ++VertIdx)
+	{
+		Snapshot->DetailVerts[VertIdx] = Recast2UnrealPoint(&Tile->detailVerts[VertIdx * 3]);
+	}
+
+	Snapshot->DetailTris.Append(Tile->detailTris, Header.detailTriCount * 4);
+
+	const dtPolyRef PolyRefBase = DetourNavMesh->getPolyRefBase(Tile);
+	Snapshot->Polys.SetNumUninitialized(Header.polyCount);
+	for (int32 PolyIdx = 0; PolyIdx < Header.polyCount; ++PolyIdx)
+	{
+		const dtPoly& DetourPoly = Tile->polys[PolyIdx];
+		FPoly& Poly = Snapshot->Polys[PolyIdx];
+		Poly.Ref = PolyRefBase | static_cast<dtPolyRef>(PolyIdx);
+		Poly.Bounds = FBox(ForceInit);
+		FMemory::Memcpy(Poly.Verts, DetourPoly.verts, sizeof(Poly.Verts));
+		FMemory::Memcpy(Poly.Neis, DetourPoly.neis, sizeof(Poly.Neis));
+		Poly.VertCount = DetourPoly.vertCount;
+		Poly.Area = DetourPoly.getArea();
+		Poly.Type = DetourPoly.getType();
+		Poly.DetailVertBase = 0;
+		Poly.DetailTriBase = 0;
+		Poly.DetailTriCount = 0;
+
+		Poly.LinkedEdges = 0;
+		for (unsigned int LinkIdx = DetourPoly.firstLink; LinkIdx != DT_NULL_LINK;)
+		{
+			const dtLink& Link = DetourNavMesh->getLink(Tile, LinkIdx);
+			LinkIdx = Link.next;
+			if (Link.edge < MaxPolyVerts)
+			{
+				Poly.LinkedEdges |= 1 << Link.edge;
+			}
+		}
+
+		// off-mesh connections have no detail mesh
+		if (Poly.Type != DT_POLYTYPE_GROUND || PolyIdx >= Header.detailMeshCount)
+			continue;
+
+		const dtPolyDetail& DetailMesh = Tile->detailMeshes[PolyIdx];
+		Poly.DetailVertBase = DetailMesh.vertBase;
+		Poly.DetailTriBase = DetailMesh.triBase;
+		Poly.DetailTriCount = DetailMesh.triCount;
+
+		for (int32 VertIdx = 0; VertIdx < Poly.VertCount; ++VertIdx)
+		{
+			Poly.Bounds += Snapshot->Verts[Poly.Verts[VertIdx]];
+		}
+
+		for (int32 VertIdx = 0; VertIdx < DetailMesh.vertCount; ++VertIdx)
+		{
+			Poly.Bounds += Snapshot->DetailVerts[Poly.DetailVertBase + VertIdx];
+		}
+	}
+
+	return Snapshot;
+}
+
+bool FCoverNavMeshTileSnapshot::GetPolyEdges(const int32 PolyIdx, TArray<FVector>& OutEdgeVerts) const
+{
+	const FPoly& Poly = Polys[PolyIdx];
+	if (Poly.Type != DT_POLYTYPE_GROUND)
+		return false;
+
+	static const float thr = FMath::Square(0.01f);
+
+	int32 CurNavEdgeVerts = 0;
+	for (int32 j = 0, nj = Poly.VertCount; j < nj; ++j)
+	{
+		bool bIsExternal = Poly.Neis[j] == 0 || Poly.Neis[j] & DT_EXT_LINK;
+
+		if (Poly.Area == RECAST_NULL_AREA)
+		{
+			if (Poly.Neis[j] && !(Poly.Neis[j] & DT_EXT_LINK) &&
+				Poly.Neis[j] <= OffMeshBase &&
+				Polys[Poly.Neis[j] - 1].Area != RECAST_NULL_AREA)
+			{
+				bIsExternal = true;
+			}
+			else if (Poly.Neis[j] == 0)
+			{
+				bIsExternal = true;
+			}
+		}
+		else if (bIsExternal && (Poly.LinkedEdges & (1 << j)))
+		{
+			bIsExternal = false;
+		}
+
+		if (!bIsExternal)
+			continue;
+
+		const FVector& V0 = Verts[Poly.Verts[j]];
+		const FVector& V1 = Verts[Poly.Verts[(j + 1) % nj]];
+
+		// the detail mesh edges which align with the poly edge
+		for (int32 k = 0; k < Poly.DetailTriCount; ++k)
+		{
+			const uint8* t = &DetailTris[(Poly.DetailTriBase + k) * 4];
+			const FVector* tv[3];
+			for (int32 m = 0; m < 3; ++m)
+			{
+				tv[m] = &GetDetailTriVert(Poly, t[m]);
+			}
+
+			for (int32 m = 0, n = 2; m < 3; n = m++)
+			{
+				if (((t[3] >> (n * 2)) & 0x3) == 0)
+				{
+					continue;	// Skip inner detail edges.
+				}
+
+				if (PointDistToSegment2DSquared(*tv[n], V0, V1) < thr && PointDistToSegment2DSquared(*tv[m], V0, V1) < thr)
+				{
+					OutEdgeVerts.Add(*tv[n]);
+					OutEdgeVerts.Add(*tv[m]);
+					++CurNavEdgeVerts;
+				}
+			}
+		}
+	}
+
+	return CurNavEdgeVerts > 0;
+}
+
+bool FCoverNavMeshTileSnapshot::ProjectPoint(const FVector& Point, const FVector& Extent, FNavLocation& OutLocation) const
+{
+	const FBox QueryBox(Point - Extent, Point + Extent);
+	float BestDistanceSq = MAX_flt;
+	for (const FPoly& Poly : Polys)
+	{
+		if (Poly.Type != DT_POLYTYPE_GROUND || Poly.Area == RECAST_NULL_AREA || !Poly.Bounds.IsValid || !Poly.Bounds.Intersect(QueryBox))
+			continue;
+
+		for (int32 TriIdx = 0; TriIdx < Poly.DetailTriCount; ++TriIdx)
+		{
+			const uint8* Tri = &DetailTris[(Poly.DetailTriBase + TriIdx) * 4];
+			const FVector ClosestPoint = FMath::ClosestPointOnTriangleToPoint(Point,
+				GetDetailTriVert(Poly, Tri[0]), GetDetailTriVert(Poly, Tri[1]), GetDetailTriVert(Poly, Tri[2]));
+
+			// like Detour's findNearestPoly, any poly overlapping the query box is a candidate, its closest point can be outside of the box
+			const float DistanceSq = FVector::DistSquared(ClosestPoint, Point);
+			if (DistanceSq < BestDistanceSq)
+			{
+				BestDistanceSq = DistanceSq;
+				OutLocation = FNavLocation(ClosestPoint, Poly.Ref);
+			}
+		}
+	}
+
+	return BestDistanceSq < MAX_flt;
+}
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoverNavigationQueryFilter.h"
+
+#include "CoverRecastNavMesh.h"
+#include "CoverThreatMap.h"
+#include "Detour/DetourCommon.h"
+#include "NavMesh/RecastQueryFilter.h"
+
+/**
+ * Recast filter that adds the threat map exposure of the poly, and whether it has cover points, to the cost of crossing it
+ */
+class FCoverRecastQueryFilter : public FRecastQueryFilter
+{
+public:
+	FCoverRecastQueryFilter(const ACoverRecastNavMesh* InNavMesh, const float InExposureCostMultiplier, const float InNoCoverCostMultiplier)
+		: FRecastQueryFilter(true), NavMesh(InNavMesh), ExposureCostMultiplier(InExposureCostMultiplier), NoCoverCostMultiplier(InNoCoverCostMultiplier)
+	{
+	}
+
+	virtual INavigationQueryFilterInterface* CreateCopy() const override
+	{
+		return new FCoverRecastQueryFilter(*this);
+	}
+
+	virtual float getVirtualCost(const float* pa, const float* pb,
+		const dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly,
+		const dtPolyRef curRef, const dtMeshTile* curTile, const dtPoly* curPoly,
+		const dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly) const override
+	{
+		const float Cost = getInlineCost(pa, pb, prevRef, prevTile, prevPoly, curRef, curTile, curPoly, nextRef, nextTile, nextPoly);
+
+		// the threat map can be enabled and disabled after the filter was made
+		float CostMultiplier = 0.0f;
+		const FCoverThreatMap& ThreatMap = NavMesh->GetCoverThreatMap();
+		if (ExposureCostMultiplier > 0.0f && ThreatMap.IsEnabled())
+		{
+			CostMultiplier += ThreatMap.GetPolyExposure(curRef) * ExposureCostMultiplier;
+		}
+
+		if (NoCoverCostMultiplier > 0.0f && NavMesh->GetNumCoverPointsOnPoly(curRef) == 0)
+		{
+			CostMultiplier += NoCoverCostMultiplier;
+		}
+
+		return CostMultiplier > 0.0f ? Cost + dtVdist(pa, pb) * CostMultiplier : Cost;
+	}
+
+protected:
+	// Also owns the filters made for it
+	const ACoverRecastNavMesh* NavMesh;
+
+	float ExposureCostMultiplier;
+
+	float NoCoverCostMultiplier;
+};
+
+UCoverNavigationQueryFilter::UCoverNavigationQueryFilter()
+	: Super()
+{
+	ExposureCostMultiplier = 1.0f;
+	NoCoverCostMultiplier = 0.0f;
+}
+
+void UCoverNavigationQueryFilter::InitializeFilter(const ANavigationData& NavData, const UObject* Querier, FNavigationQueryFilter& Filter) const
+{
+	const ACoverRecastNavMesh* CoverNavMesh = Cast<ACoverRecastNavMesh>(&NavData);
+	if (CoverNavMesh)
+	{
+		// start from the nav mesh's default area costs and flags, Super applies this filter's overrides on top.
+		// installed even if the threat map is disabled, the filter is cached and would otherwise never get the cost once it's enabled
+		FCoverRecastQueryFilter CoverFilterImpl(CoverNavMesh, ExposureCostMultiplier, NoCoverCostMultiplier);
+		if (const INavigationQueryFilterInterface* DefaultFilterImpl = NavData.GetDefaultQueryFilterImpl())
+		{
+			CoverFilterImpl.copyFrom(static_cast<const FRecastQueryFilter*>(DefaultFilterImpl));
+		}
+		
+		Filter.SetFilterImplementation(&CoverFilterImpl);
+	}
+
+	Super::InitializeFilter(NavData, Querier, Filter);
+}
@@ -4,7 +4,7 @@
 
 void FCoverPointOctreeSemantics::SetElementId(FOctree& OctreeOwner, const FCoverPointOctreeElement& Element, FOctreeElementId2 Id)
 {
-	static_cast<FCoverOctree&>(OctreeOwner).SetElementIdImpl(Element.Data->Location, Id);
+	static_cast<FCoverOctree&>(OctreeOwner).SetElementIdImpl(Element, Id);
 }
 
 FCoverOctree::FCoverOctree()
@@ -22,11 +22,62 @@ void FCoverOctree::RemoveElement(const FOctreeElementId2 ElementId)
 	if (!ElementId.IsValidId())
 		return;
 
+	const FCoverPointOctreeData& Data = *GetElementById(ElementId).Data;
+	HandleToOctreeId.Remove(Data.Handle);
+	NodeRefToHandles.RemoveSingle(Data.NodeRef, Data.Handle);
 	static_cast<TOctree2*>(this)->RemoveElement(ElementId);
 }
 
-void FCoverOctree::SetElementIdImpl(const FVector ElementLocation, FOctreeElementId2 Id)
+FCoverHandle FCoverOctree::AssignHandle(const FCoverPointOctreeElement& Element)
 {
-	ElementToOctreeId.Add(ElementLocation, Id);
+	Element.Data->Handle = FCoverHandle(++LastHandleId);
+	return Element.Data->Handle;
 }
 
+void FCoverOctree::SetElementIdImpl(const FCoverPointOctreeElement& Element, FOctreeElementId2 Id)
+{
+	ElementToOctreeId.Add(Element.Data->Location, Id);
+	HandleToOctreeId.Add(Element.Data->Handle, Id);
+
+	// also called when the octree moves the element to another node
+	NodeRefToHandles.AddUnique(Element.Data->NodeRef, Element.Data->Handle);
+}
+
+void FCoverOctree::SetElementNodeRef(const FOctreeElementId2 ElementId, const NavNodeRef NodeRef)
+{
+	if (!ElementId.IsValidId())
+		return;
+
+	FCoverPointOctreeData& Data = *GetElementById(ElementId).Data;
+	NodeRefToHandles.RemoveSingle(Data.NodeRef, Data.Handle);
+	Data.NodeRef = NodeRef;
+	NodeRefToHandles.AddUnique(Data.NodeRef, Data.Handle);
+}
+
+bool FCoverOctree::HoldCover(const FOctreeElementId2 ElementId, const uint32 HolderId)
+{
+	if (!ElementId.IsValidId())
+		return false;
+
+	FCoverPointOctreeData& Data = *GetElementById(ElementId).Data;
+	if (Data.bTaken)
+		return false;
+
+	Data.bTaken = true;
+	Data.HolderId = HolderId;
+	return true;
+}
+
+bool FCoverOctree::ReleaseCover(const FOctreeElementId2 ElementId)
+{
+	if (!ElementId.IsValidId())
+		return false;
+
+	FCoverPointOctreeData& Data = *GetElementById(ElementId).Data;
+	if (!Data.bTaken)
+		return false;
+
+	Data.bTaken = false;
+	Data.HolderId = 0;
+	return true;
+}
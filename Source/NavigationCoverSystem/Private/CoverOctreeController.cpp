@@ -14,6 +14,11 @@ const FOctreeElementId2* FCoverOctreeController::GetElementNavOctreeId(const FVe
 	return CoverOctree.IsValid() ? CoverOctree->ElementToOctreeId.Find(ElementLocation) : nullptr;
 }
 
+const FOctreeElementId2* FCoverOctreeController::GetElementNavOctreeId(const FCoverHandle& Handle) const
+{
+	return CoverOctree.IsValid() ? CoverOctree->HandleToOctreeId.Find(Handle) : nullptr;
+}
+
 void FCoverOctreeController::RemoveNavOctreeElementId(const FOctreeElementId2& ElementId) const
 {
 	if (CoverOctree.IsValid())
@@ -30,6 +35,26 @@ void FCoverOctreeController::RemoveElementNavOctreeId(const FVector& ElementLoca
 	}
 }
 
+void FCoverOctreeController::FindElementsOnPoly(const NavNodeRef PolyRef, TArray<FCoverPointOctreeElement>& Elements) const
+{
+	if (!CoverOctree.IsValid())
+		return;
+
+	for (auto It = CoverOctree->NodeRefToHandles.CreateConstKeyIterator(PolyRef); It; ++It)
+	{
+		const FOctreeElementId2* Id = CoverOctree->HandleToOctreeId.Find(It.Value());
+		if (Id && Id->IsValidId())
+		{
+			Elements.Add(CoverOctree->GetElementById(*Id));
+		}
+	}
+}
+
+int32 FCoverOctreeController::GetNumElementsOnPoly(const NavNodeRef PolyRef) const
+{
+	return CoverOctree.IsValid() ? CoverOctree->NodeRefToHandles.Num(PolyRef) : 0;
+}
+
 bool FCoverOctreeController::HasElementInNavOctree(const FBoxCenterAndExtent& QueryBox) const
 {
 	bool bResult = false;
@@ -53,6 +78,7 @@ bool FCoverOctreeController::AddNode(const FCoverPointOctreeElement& Element, co
 		if (HasElementInNavOctree(FBoxCenterAndExtent(Element.Data->Location, FVector(DuplicateRadius))))
 			return false;
 
+		CoverOctree->AssignHandle(Element);
 		CoverOctree->AddElement(Element);
 		return true;
 	}
@@ -0,0 +1,507 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoverQuery.h"
+
+#include "CoverQueryResultCache.h"
+#include "CoverRecastNavMesh.h"
+#include "CoverSystemStatics.h"
+#include "CoverThreatMap.h"
+#include "CoverVisibilityTable.h"
+#include "Containers/Ticker.h"
+
+// a query shares a traversal if the sphere covering both isn't larger than this times the largest query radius of the traversal
+static const float MaxTraversalGrowth = 1.25f;
+
+/**
+ * @brief hash of the targets and settings of the evaluation stage, queries with the same hash are checked with HasSameEvaluation
+ */
+static uint32 GetEvaluationHash(const FCoverQueryRequest& Request)
+{
+	uint32 Hash = HashCombine(PointerHash(Request.Evaluator), GetTypeHash(Request.StandingEyeHeight));
+	Hash = HashCombine(Hash, GetTypeHash(Request.bTestCrouchHeight ? Request.CrouchingEyeHeight : -1.0f));
+	for (const FCoverQueryTarget& Target : Request.Targets)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(Target.Actor));
+		Hash = HashCombine(Hash, GetTypeHash(Target.EyeLocation));
+		Hash = HashCombine(Hash, Target.bPrimary ? 1u : 0u);
+	}
+
+	return Hash;
+}
+
+static bool HasSameEvaluation(const FCoverQueryRequest& A, const FCoverQueryRequest& B)
+{
+	if (A.Evaluator != B.Evaluator || A.StandingEyeHeight != B.StandingEyeHeight || A.bTestCrouchHeight != B.bTestCrouchHeight
+		|| (A.bTestCrouchHeight && A.CrouchingEyeHeight != B.CrouchingEyeHeight) || A.Targets.Num() != B.Targets.Num())
+		return false;
+
+	for (int32 TargetIdx = 0; TargetIdx < A.Targets.Num(); ++TargetIdx)
+	{
+		const FCoverQueryTarget& TargetA = A.Targets[TargetIdx];
+		const FCoverQueryTarget& TargetB = B.Targets[TargetIdx];
+		if (TargetA.Actor != TargetB.Actor || TargetA.EyeLocation != TargetB.EyeLocation || TargetA.bPrimary != TargetB.bPrimary)
+			return false;
+	}
+
+	return true;
+}
+
+FCoverQueryScheduler::FCoverQueryScheduler()
+	: NavMesh(nullptr)
+{
+}
+
+FCoverQueryScheduler::~FCoverQueryScheduler()
+{
+	Reset();
+}
+
+void FCoverQueryScheduler::Init(ACoverRecastNavMesh* InNavMesh)
+{
+	{
+		FScopeLock PendingScopeLock(&PendingLock);
+		NavMesh = InNavMesh;
+	}
+
+	if (!TickerHandle.IsValid())
+	{
+		TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FCoverQueryScheduler::Tick));
+	}
+}
+
+void FCoverQueryScheduler::Reset()
+{
+	TArray<TUniquePtr<FPendingQuery>> DroppedQueries;
+	{
+		FScopeLock PendingScopeLock(&PendingLock);
+		NavMesh = nullptr;
+		DroppedQueries = MoveTemp(PendingQueries);
+	}
+
+	if (TickerHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
+	}
+
+	// outside of the lock, the callbacks can submit new queries
+	for (const TUniquePtr<FPendingQuery>& Query : DroppedQueries)
+	{
+		Query->OnCompleted(FCoverQueryResult());
+	}
+}
+
+bool FCoverQueryScheduler::IsEnabled() const
+{
+	FScopeLock PendingScopeLock(&PendingLock);
+	return NavMesh != nullptr;
+}
+
+TFuture<FCoverQueryResult> FCoverQueryScheduler::Submit(const FCoverQueryRequest& Request)
+{
+	TSharedRef<TPromise<FCoverQueryResult>, ESPMode::ThreadSafe> Promise = MakeShared<TPromise<FCoverQueryResult>, ESPMode::ThreadSafe>();
+	TFuture<FCoverQueryResult> Future = Promise->GetFuture();
+	Submit(Request, [Promise](const FCoverQueryResult& Result)
+	{
+		Promise->SetValue(Result);
+	});
+
+	return Future;
+}
+
+void FCoverQueryScheduler::Submit(const FCoverQueryRequest& Request, TUniqueFunction<void(const FCoverQueryResult&)>&& OnCompleted)
+{
+	{
+		FScopeLock PendingScopeLock(&PendingLock);
+		if (NavMesh)
+		{
+			TUniquePtr<FPendingQuery> Query = MakeUnique<FPendingQuery>();
+			Query->Request = Request;
+			Query->OnCompleted = MoveTemp(OnCompleted);
+			PendingQueries.Add(MoveTemp(Query));
+			return;
+		}
+	}
+
+	OnCompleted(FCoverQueryResult());
+}
+
+void FCoverQueryScheduler::SubmitSquad(const FCoverSquadRequest& Request, TUniqueFunction<void(const FCoverSquadResult&)>&& OnCompleted)
+{
+	// one query around the whole squad, its cover points are evaluated once for all the members
+	FCoverQueryRequest Query = Request.Query;
+	Query.Radius = 0.0f;
+	Query.MaxResults = 0;
+	Query.bExcludeReservedCover |= Request.bHoldCover;
+
+	FBox MembersBounds(ForceInit);
+	for (const FCoverSquadMember& Member : Request.Members)
+	{
+		MembersBounds += Member.Location;
+		if (Member.Holder.IsValid())
+		{
+			Query.IgnoredHolders.AddUnique(Member.Holder);
+		}
+	}
+
+	if (MembersBounds.IsValid)
+	{
+		Query.Center = MembersBounds.GetCenter();
+		for (const FCoverSquadMember& Member : Request.Members)
+		{
+			Query.Radius = FMath::Max(Query.Radius, FVector::Dist(Member.Location, Query.Center) + Member.Radius);
+		}
+	}
+
+	Submit(Query, [this, SquadRequest = Request, OnSquadCompleted = MoveTemp(OnCompleted)](const FCoverQueryResult& QueryResult)
+	{
+		FCoverSquadResult Result;
+		Result.MemberCoverPoints.Init(INDEX_NONE, SquadRequest.Members.Num());
+		if (QueryResult.bSuccess)
+		{
+			Result.bSuccess = true;
+			Result.CoverPoints = QueryResult.CoverPoints;
+			AssignSquadCover(SquadRequest, Result);
+		}
+
+		OnSquadCompleted(Result);
+	});
+}
+
+int32 FCoverQueryScheduler::GetNumPendingQueries() const
+{
+	FScopeLock PendingScopeLock(&PendingLock);
+	return PendingQueries.Num();
+}
+
+bool FCoverQueryScheduler::Tick(float DeltaTime)
+{
+	ProcessPendingQueries();
+	return true;
+}
+
+void FCoverQueryScheduler::ProcessPendingQueries()
+{
+	check(IsInGameThread());
+
+	TArray<TUniquePtr<FPendingQuery>> Queries;
+	{
+		FScopeLock PendingScopeLock(&PendingLock);
+		if (!NavMesh || PendingQueries.Num() == 0)
+			return;
+
+		Queries = MoveTemp(PendingQueries);
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_CoverQueryProcess);
+	INC_DWORD_STAT_BY(STAT_CoverQueryQueries, Queries.Num());
+
+	for (const TUniquePtr<FPendingQuery>& Query : Queries)
+	{
+		if (!Query->Request.Evaluator)
+		{
+			Query->Request.Evaluator = GetDefault<UEnvQueryTest_Cover>();
+		}
+	}
+
+	TArray<FCoverQueryResult> Results;
+	GatherCoverPoints(Queries, Results);
+	EvaluateCoverPoints(Queries, Results);
+
+	for (int32 QueryIdx = 0; QueryIdx < Queries.Num(); ++QueryIdx)
+	{
+		const FCoverQueryRequest& Request = Queries[QueryIdx]->Request;
+		FCoverQueryResult& Result = Results[QueryIdx];
+
+		// the cover points are sorted by distance, keep that order between equal scores
+		Result.CoverPoints.StableSort([](const FCoverQueryResultPoint& A, const FCoverQueryResultPoint& B) { return A.Score > B.Score; });
+		if (Request.MaxResults > 0 && Result.CoverPoints.Num() > Request.MaxResults)
+		{
+			Result.CoverPoints.SetNum(Request.MaxResults);
+		}
+
+		Result.bSuccess = true;
+		Queries[QueryIdx]->OnCompleted(Result);
+	}
+}
+
+void FCoverQueryScheduler::AssignSquadCover(const FCoverSquadRequest& Request, FCoverSquadResult& Result) const
+{
+	const TArray<FCoverQueryResultPoint>& CoverPoints = Result.CoverPoints;
+
+	struct FCandidatePair
+	{
+		float Cost;
+		int32 MemberIdx;
+		int32 CoverPointIdx;
+	};
+
+	TArray<FCandidatePair> Pairs;
+	for (int32 MemberIdx = 0; MemberIdx < Request.Members.Num(); ++MemberIdx)
+	{
+		const FCoverSquadMember& Member = Request.Members[MemberIdx];
+		for (int32 CoverPointIdx = 0; CoverPointIdx < CoverPoints.Num(); ++CoverPointIdx)
+		{
+			const FCoverQueryResultPoint& CoverPoint = CoverPoints[CoverPointIdx];
+			const float DistanceSq = FVector::DistSquared(Member.Location, CoverPoint.CoverPoint.Location);
+			if (DistanceSq <= FMath::Square(Member.Radius))
+			{
+				Pairs.Add({FMath::Sqrt(DistanceSq) + (1.0f - CoverPoint.Score) * Request.ScoreCost, MemberIdx, CoverPointIdx});
+			}
+		}
+	}
+
+	// the cheapest pairs first, so the members don't all want the best cover point
+	Pairs.Sort([](const FCandidatePair& A, const FCandidatePair& B) { return A.Cost < B.Cost; });
+
+	TBitArray<> UsedCoverPoints(false, CoverPoints.Num());
+	TArray<FVector> AssignedLocations;
+	for (const FCandidatePair& Pair : Pairs)
+	{
+		if (AssignedLocations.Num() == Request.Members.Num())
+			break;
+
+		if (Result.MemberCoverPoints[Pair.MemberIdx] != INDEX_NONE || UsedCoverPoints[Pair.CoverPointIdx])
+			continue;
+
+		const FEnvQueryCoverPointItem& CoverPoint = CoverPoints[Pair.CoverPointIdx].CoverPoint;
+		const bool bTooClose = AssignedLocations.ContainsByPredicate([&](const FVector& AssignedLocation)
+		{
+			return FVector::DistSquared(AssignedLocation, CoverPoint.Location) < FMath::Square(Request.MinSpacing);
+		});
+
+		if (bTooClose)
+			continue;
+
+		// the member keeps the cover it already holds, holding fails if it's taken by anyone else, including another member
+		const UObject* Holder = Request.Members[Pair.MemberIdx].Holder.Get();
+		if (Request.bHoldCover && !NavMesh->IsCoverHeldBy(CoverPoint.Handle, Holder) && !NavMesh->HoldCover(CoverPoint.Handle, Holder))
+			continue;
+
+		UsedCoverPoints[Pair.CoverPointIdx] = true;
+		Result.MemberCoverPoints[Pair.MemberIdx] = Pair.CoverPointIdx;
+		AssignedLocations.Add(CoverPoint.Location);
+	}
+}
+
+void FCoverQueryScheduler::GatherCoverPoints(const TArray<TUniquePtr<FPendingQuery>>& Queries, TArray<FCoverQueryResult>& OutResults) const
+{
+	OutResults.Reset();
+	OutResults.SetNum(Queries.Num());
+
+	// agents close to each other search mostly the same cover points
+	struct FTraversal
+	{
+		FSphere Sphere;
+		float MaxQueryRadius;
+		TArray<int32> QueryIndices;
+	};
+
+	TArray<FTraversal> Traversals;
+	for (int32 QueryIdx = 0; QueryIdx < Queries.Num(); ++QueryIdx)
+	{
+		const FCoverQueryRequest& Request = Queries[QueryIdx]->Request;
+		const FSphere QuerySphere(Request.Center, Request.Radius);
+
+		FSphere MergedSphere;
+		FTraversal* Traversal = Traversals.FindByPredicate([&QuerySphere, &MergedSphere](const FTraversal& Candidate)
+		{
+			MergedSphere = Candidate.Sphere;
+			MergedSphere += QuerySphere;
+			return MergedSphere.W <= MaxTraversalGrowth * FMath::Max(Candidate.MaxQueryRadius, QuerySphere.W);
+		});
+
+		if (Traversal)
+		{
+			Traversal->Sphere = MergedSphere;
+			Traversal->MaxQueryRadius = FMath::Max(Traversal->MaxQueryRadius, QuerySphere.W);
+		}
+		else
+		{
+			Traversal = &Traversals.AddDefaulted_GetRef();
+			Traversal->Sphere = QuerySphere;
+			Traversal->MaxQueryRadius = QuerySphere.W;
+		}
+
+		Traversal->QueryIndices.Add(QueryIdx);
+	}
+
+	const FCoverThreatMap& ThreatMap = NavMesh->GetCoverThreatMap();
+	for (const FTraversal& Traversal : Traversals)
+	{
+		INC_DWORD_STAT(STAT_CoverQueryTraversals);
+
+		TArray<FCoverPointOctreeElement> CoverPoints;
+		NavMesh->FindCoverPoints(Traversal.Sphere, CoverPoints);
+
+		for (const int32 QueryIdx : Traversal.QueryIndices)
+		{
+			const FCoverQueryRequest& Request = Queries[QueryIdx]->Request;
+			const bool bFilterThreatExposure = Request.MaxThreatExposure < 1.0f && ThreatMap.IsEnabled();
+
+			TArray<const UObject*> IgnoredHolders;
+			TArray<uint32> IgnoredHolderIds;
+			for (const TWeakObjectPtr<const UObject>& IgnoredHolder : Request.IgnoredHolders)
+			{
+				if (const UObject* Holder = IgnoredHolder.Get())
+				{
+					IgnoredHolders.Add(Holder);
+					IgnoredHolderIds.Add(Holder->GetUniqueID());
+				}
+			}
+
+			TArray<FCoverQueryResultPoint>& ResultPoints = OutResults[QueryIdx].CoverPoints;
+			for (const FCoverPointOctreeElement& CoverPoint : CoverPoints)
+			{
+				const FCoverPointOctreeData& Data = *CoverPoint.Data;
+				const float DistanceSq = FVector::DistSquared(Data.Location, Request.Center);
+				if (DistanceSq > FMath::Square(Request.Radius))
+					continue;
+
+				if ((Request.bStandingCoverOnly && Data.Metadata.Height != ECoverHeight::Standing) || (Request.bExcludeForceFields && Data.bForceField))
+					continue;
+
+				if (bFilterThreatExposure && ThreatMap.GetCoverPointExposure(Data.Handle) > Request.MaxThreatExposure)
+					continue;
+
+				const bool bTakenByOthers = Data.bTaken && (Data.HolderId == 0 || !IgnoredHolderIds.Contains(Data.HolderId));
+				if (Request.bExcludeReservedCover && (bTakenByOthers || NavMesh->IsCoverAreaReserved(Data.Location, IgnoredHolders)))
+				{
+					INC_DWORD_STAT(STAT_CoverReservationsPrefiltered);
+					continue;
+				}
+
+				FCoverQueryResultPoint& ResultPoint = ResultPoints.AddDefaulted_GetRef();
+				ResultPoint.CoverPoint = FEnvQueryCoverPointItem(CoverPoint);
+				ResultPoint.Score = 1.0f;
+				ResultPoint.Distance = FMath::Sqrt(DistanceSq);
+			}
+
+			ResultPoints.Sort([](const FCoverQueryResultPoint& A, const FCoverQueryResultPoint& B) { return A.Distance < B.Distance; });
+			if (Request.MaxCandidates > 0 && ResultPoints.Num() > Request.MaxCandidates)
+			{
+				ResultPoints.SetNum(Request.MaxCandidates);
+			}
+		}
+	}
+}
+
+void FCoverQueryScheduler::EvaluateCoverPoints(const TArray<TUniquePtr<FPendingQuery>>& Queries, TArray<FCoverQueryResult>& OutResults) const
+{
+	// many agents take cover from the same few targets
+	TArray<TArray<int32>> EvaluationGroups;
+	TMultiMap<uint32, int32> HashToEvaluationGroup;
+	for (int32 QueryIdx = 0; QueryIdx < Queries.Num(); ++QueryIdx)
+	{
+		const FCoverQueryRequest& Request = Queries[QueryIdx]->Request;
+		if (Request.Targets.Num() == 0 || OutResults[QueryIdx].CoverPoints.Num() == 0)
+			continue;
+
+		const uint32 Hash = GetEvaluationHash(Request);
+		TArray<int32> CandidateGroups;
+		HashToEvaluationGroup.MultiFind(Hash, CandidateGroups);
+		const int32* GroupIdx = CandidateGroups.FindByPredicate([&](const int32 CandidateGroupIdx)
+		{
+			return HasSameEvaluation(Queries[EvaluationGroups[CandidateGroupIdx][0]]->Request, Request);
+		});
+
+		if (GroupIdx)
+		{
+			EvaluationGroups[*GroupIdx].Add(QueryIdx);
+		}
+		else
+		{
+			HashToEvaluationGroup.Add(Hash, EvaluationGroups.Add(TArray<int32>{QueryIdx}));
+		}
+	}
+
+	const bool bVisibilityTableEnabled = NavMesh->GetCoverVisibilityTable().IsEnabled();
+	const bool bResultCacheEnabled = NavMesh->GetCoverQueryResultCache().IsEnabled();
+	for (const TArray<int32>& QueryIndices : EvaluationGroups)
+	{
+		INC_DWORD_STAT(STAT_CoverQueryEvaluations);
+
+		const FCoverQueryRequest& GroupRequest = Queries[QueryIndices[0]]->Request;
+		const UEnvQueryTest_Cover* Evaluator = GroupRequest.Evaluator;
+
+		// the union of the cover points of the group, each one is evaluated once
+		TArray<FEnvQueryCoverPointItem> CoverPoints;
+		TMap<uint32, int32> HandleToCoverPoint;
+		for (const int32 QueryIdx : QueryIndices)
+		{
+			for (const FCoverQueryResultPoint& ResultPoint : OutResults[QueryIdx].CoverPoints)
+			{
+				if (!HandleToCoverPoint.Contains(ResultPoint.CoverPoint.Handle.Id))
+				{
+					HandleToCoverPoint.Add(ResultPoint.CoverPoint.Handle.Id, CoverPoints.Add(ResultPoint.CoverPoint));
+				}
+			}
+		}
+
+		// the primary targets first, same as UEnvQueryTest_Cover::PrepareQueryTargets
+		TArray<FCoverQueryTarget> SortedTargets = GroupRequest.Targets;
+		SortedTargets.StableSort([](const FCoverQueryTarget& A, const FCoverQueryTarget& B) { return A.bPrimary && !B.bPrimary; });
+
+		const bool bSnapToCoverPoints = Evaluator->bUseVisibilityTable && bVisibilityTableEnabled;
+		FCoverTestQueryTargets Targets;
+		Targets.StartTime = FPlatformTime::Seconds();
+		for (const FCoverQueryTarget& Target : SortedTargets)
+		{
+			FCoverHandle TargetCoverHandle;
+			if (bSnapToCoverPoints)
+			{
+				const FVector TargetCoverLocation = Target.EyeLocation - FVector(0.0f, 0.0f, UCoverSystemStatics::StandingCoverHeight - UCoverSystemStatics::CoverPointGroundOffset);
+				FCoverPointOctreeElement TargetCoverPoint;
+				if (NavMesh->FindNearestCoverPoint(TargetCoverPoint, TargetCoverLocation, Evaluator->VisibilityTableSnapDistance))
+				{
+					TargetCoverHandle = TargetCoverPoint.Data->Handle;
+				}
+			}
+
+			Targets.Actors.Add(Target.Actor);
+			Targets.EyeLocations.Add(Target.EyeLocation);
+			Targets.CoverPoints.Add(TargetCoverHandle);
+			Targets.PrimaryTargets.Add(Target.bPrimary);
+			Targets.NumPrimaryTargets += Target.bPrimary ? 1 : 0;
+		}
+
+		FCoverEvaluationParams Params;
+		Params.World = NavMesh->GetWorld();
+		Params.StandingEyeHeight = GroupRequest.StandingEyeHeight;
+		Params.CrouchingEyeHeight = GroupRequest.CrouchingEyeHeight;
+		Params.bTestCrouchHeight = GroupRequest.bTestCrouchHeight;
+		Params.VisibilityTable = bSnapToCoverPoints ? &NavMesh->GetCoverVisibilityTable() : nullptr;
+		Params.ResultCache = Evaluator->bUseResultCache && bResultCacheEnabled ? &NavMesh->GetCoverQueryResultCache() : nullptr;
+		Params.SettingsHash = Params.ResultCache ? Evaluator->GetResultCacheSettingsHash() : 0;
+
+		TArray<TOptional<ECoverQueryResult>> Results;
+		Evaluator->EvaluateCoverPointsPrimaryFirst(CoverPoints, Targets, Params, Results);
+
+		const int32 NumTargets = Targets.Actors.Num();
+		for (const int32 QueryIdx : QueryIndices)
+		{
+			const FCoverQueryRequest& Request = Queries[QueryIdx]->Request;
+			TArray<FCoverQueryResultPoint>& ResultPoints = OutResults[QueryIdx].CoverPoints;
+			for (FCoverQueryResultPoint& ResultPoint : ResultPoints)
+			{
+				const int32 CoverPointIdx = HandleToCoverPoint.FindChecked(ResultPoint.CoverPoint.Handle.Id);
+				FCoverScoreAggregator Aggregator(Evaluator->ScoreAggregation, Evaluator->PrimaryTargetWeight);
+				for (int32 TargetIdx = 0; TargetIdx < NumTargets && !Aggregator.IsFinal(); ++TargetIdx)
+				{
+					const TOptional<ECoverQueryResult>& CoverResult = Results[CoverPointIdx * NumTargets + TargetIdx];
+					if (CoverResult.IsSet())
+					{
+						const bool bPrimaryTarget = Targets.PrimaryTargets[TargetIdx];
+						Aggregator.Add(UEnvQueryTest_Cover::GetTargetScore(CoverResult.GetValue(), bPrimaryTarget), bPrimaryTarget);
+					}
+				}
+
+				// every target was destroyed
+				ResultPoint.Score = Aggregator.HasScore() ? Aggregator.GetScore() : 0.0f;
+			}
+
+			ResultPoints.RemoveAll([&Request](const FCoverQueryResultPoint& ResultPoint) { return ResultPoint.Score < Request.MinScore; });
+		}
+	}
+}
@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoverQueryResultCache.h"
+
+#include "CoverSystemStatics.h"
+
+FCoverQueryResultCache::FCoverQueryResultCache()
+	: MaxEntries(0), Lifetime(0.0f), EvictionRingNext(0)
+{
+}
+
+void FCoverQueryResultCache::Init(const int32 InMaxEntries, const float InLifetime)
+{
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_Write);
+	MaxEntries = FMath::Max(InMaxEntries, 0);
+	Lifetime = FMath::Max(InLifetime, 0.0f);
+
+	Entries.Empty(MaxEntries);
+	EvictionRing.Empty(MaxEntries);
+	EvictionRingNext = 0;
+	TileGenerations.Empty();
+
+	UpdateMemoryStats();
+}
+
+void FCoverQueryResultCache::Reset()
+{
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_Write);
+	Entries.Empty();
+	EvictionRing.Empty();
+	EvictionRingNext = 0;
+	TileGenerations.Empty();
+
+	UpdateMemoryStats();
+}
+
+bool FCoverQueryResultCache::Find(const FCoverQueryCacheKey& Key, const TileIndexType TileIndex, ECoverQueryResult& OutResult) const
+{
+	if (!IsEnabled())
+		return false;
+
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_ReadOnly);
+	const FEntry* Entry = Entries.Find(Key);
+
+	// stale entries are left in place, they are overwritten by the next Add or evicted
+	const bool bValid = Entry && !Entry->bInvalidated && Entry->TileIndex == TileIndex && Entry->TileGeneration == GetTileGeneration(TileIndex)
+		&& (Lifetime <= 0.0f || FPlatformTime::Seconds() - Entry->Time <= Lifetime);
+	if (!bValid)
+	{
+		INC_DWORD_STAT(STAT_CoverQueryCacheMisses);
+		return false;
+	}
+
+	INC_DWORD_STAT(STAT_CoverQueryCacheHits);
+	OutResult = Entry->Result;
+	return true;
+}
+
+void FCoverQueryResultCache::Add(const FCoverQueryCacheKey& Key, const TileIndexType TileIndex, const FVector& CoverLocation, const FVector& TargetLocation,
+	const ECoverQueryResult Result)
+{
+	if (!IsEnabled())
+		return;
+
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_Write);
+	AddLocked(Key, TileIndex, CoverLocation, TargetLocation, Result, FPlatformTime::Seconds());
+
+	UpdateMemoryStats();
+}
+
+void FCoverQueryResultCache::Add(const TArray<FCoverQueryCacheInsert>& Inserts)
+{
+	if (!IsEnabled() || Inserts.Num() == 0)
+		return;
+
+	const double Time = FPlatformTime::Seconds();
+	
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_Write);
+	for (const FCoverQueryCacheInsert& Insert : Inserts)
+	{
+		AddLocked(Insert.Key, Insert.TileIndex, Insert.CoverLocation, Insert.TargetLocation, Insert.Result, Time);
+	}
+
+	UpdateMemoryStats();
+}
+
+void FCoverQueryResultCache::InvalidateTile(const TileIndexType TileIndex)
+{
+	if (!IsEnabled())
+		return;
+
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_Write);
+	++TileGenerations.FindOrAdd(TileIndex);
+}
+
+void FCoverQueryResultCache::InvalidateArea(const FBox& Area)
+{
+	if (!IsEnabled() || !Area.IsValid)
+		return;
+
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_Write);
+	for (TPair<FCoverQueryCacheKey, FEntry>& Pair : Entries)
+	{
+		FEntry& Entry = Pair.Value;
+		if (Entry.bInvalidated)
+			continue;
+
+		const FVector CoverToTarget = Entry.TargetLocation - Entry.CoverLocation;
+		if (FMath::LineBoxIntersection(Area, Entry.CoverLocation, Entry.TargetLocation, CoverToTarget))
+		{
+			Entry.bInvalidated = true;
+		}
+	}
+}
+
+SIZE_T FCoverQueryResultCache::GetAllocatedSize() const
+{
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_ReadOnly);
+	return Entries.GetAllocatedSize() + EvictionRing.GetAllocatedSize() + TileGenerations.GetAllocatedSize();
+}
+
+uint32 FCoverQueryResultCache::GetTileGeneration(const TileIndexType TileIndex) const
+{
+	const uint32* Generation = TileGenerations.Find(TileIndex);
+	return Generation ? *Generation : 0;
+}
+
+void FCoverQueryResultCache::AddLocked(const FCoverQueryCacheKey& Key, const TileIndexType TileIndex, const FVector& CoverLocation, const FVector& TargetLocation,
+	const ECoverQueryResult Result, const double Time)
+{
+	const FEntry NewEntry = { Result, TileIndex, GetTileGeneration(TileIndex), Time, CoverLocation, TargetLocation, false };
+
+	// keys are only removed by eviction, so every key in Entries has exactly one slot in the ring
+	if (FEntry* Entry = Entries.Find(Key))
+	{
+		*Entry = NewEntry;
+		return;
+	}
+
+	if (EvictionRing.Num() < MaxEntries)
+	{
+		EvictionRing.Add(Key);
+	}
+	else
+	{
+		Entries.Remove(EvictionRing[EvictionRingNext]);
+		EvictionRing[EvictionRingNext] = Key;
+		EvictionRingNext = (EvictionRingNext + 1) % MaxEntries;
+		INC_DWORD_STAT(STAT_CoverQueryCacheEvictions);
+	}
+
+	Entries.Add(Key, NewEntry);
+}
+
+void FCoverQueryResultCache::UpdateMemoryStats() const
+{
+	SET_DWORD_STAT(STAT_CoverQueryCacheEntries, Entries.Num());
+	SET_MEMORY_STAT(STAT_CoverQueryCacheMemory, Entries.GetAllocatedSize() + EvictionRing.GetAllocatedSize() + TileGenerations.GetAllocatedSize());
+}
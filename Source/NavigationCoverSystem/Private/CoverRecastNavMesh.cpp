@@ -5,12 +5,16 @@
 
 #include "CoverSystemStatics.h"
 #include "DrawDebugHelpers.h"
+#include "EngineUtils.h"
 #include "NavmeshCoverPointGeneratorAsyncTask.h"
 #include "Detour/DetourNavMesh.h"
 #include "EnvironmentQuery/Generators/EnvQueryGenerator_ActorsOfClass.h"
 #include "EnvironmentQuery/Generators/EnvQueryGenerator_PathingGrid.h"
 #include "NavMesh/PImplRecastNavMesh.h"
 #include "NavMesh/RecastHelpers.h"
+#include "NavMesh/RecastQueryFilter.h"
+#include "Containers/Ticker.h"
+#include "GameFramework/Pawn.h"
 
 
 #if DEBUG_RENDERING
@@ -36,8 +40,6 @@ DEFINE_LOG_CATEGORY_STATIC(CoverNavMesh, Log, All)
 	UE_LOG(CoverNavMesh, Verbosity, Format, ##__VA_ARGS__); \
 }
 
-constexpr float ACoverRecastNavMesh::TileBufferInterval = 0.2f;
-
 ACoverRecastNavMesh::ACoverRecastNavMesh()
 	: Super()
 {
@@ -47,32 +49,119 @@ ACoverRecastNavMesh::ACoverRecastNavMesh(const FObjectInitializer& ObjectInitial
 	: Super(ObjectInitializer)
 {
 	CoverPointMinDistance = 2 * 30.0f;
+	bRegenerateDirtyAreasOnly = true;
+	DirtyAreaMargin = 100.0f;
+	TileUpdateDebounce = 0.2f;
+	TileUpdateMaxLatency = 1.0f;
+	bCoalesceNeighbourTiles = true;
+	TileCommitBudget = 2.0f;
+	bGenerateCoverProtectionMasks = true;
+	bBuildCoverVisibilityTable = false;
+	CoverVisibilityRange = 1500.0f;
+	CoverQueryCacheMaxEntries = 16384;
+	CoverQueryCacheLifetime = 5.0f;
+	CoverThreatRange = 3000.0f;
+	CoverThreatUpdateDistance = 100.0f;
+	CoverReservationRadius = 150.0f;
+	bEnableCoverLod = false;
+	CoverLodFineDistance = 5000.0f;
+	CoverLodCoarseDistance = 15000.0f;
+	CoverLodCoarseStepMultiplier = 3.0f;
+	CoverLodHysteresis = 1000.0f;
+	CoverLodUpdateInterval = 1.0f;
+	bPawnsAreCoverRelevanceSources = true;
+	LastCoverLodUpdateTime = 0.0;
+	LastTileCoverGeneration = 0;
 }
 
 void ACoverRecastNavMesh::OnNavMeshTilesUpdated(const TArray<uint32>& ChangedTiles)
 {
 	Super::OnNavMeshTilesUpdated(ChangedTiles);
 	
-	TSet<uint32> UpdatedTiles;
+	// regenerated by ProcessQueuedTiles once the tiles are done being rebuilt
+	const double CurrentTime = FPlatformTime::Seconds();
 	for (const uint32& ChangedTile : ChangedTiles)
 	{
-		//don't call append, since it's just a for loop as well
-		UpdatedTiles.Add(ChangedTile);
-		UpdatedTilesIntervalBuffer.Add(ChangedTile);
-		UpdatedTilesUntilFinishedBuffer.Add(ChangedTile);
+		FCoverPendingTileUpdate* PendingTileUpdate = PendingTileUpdates.Find(ChangedTile);
+		if (PendingTileUpdate)
+		{
+			INC_DWORD_STAT(STAT_CoverTileUpdatesCoalesced);
+		}
+		else
+		{
+			PendingTileUpdate = &PendingTileUpdates.Add(ChangedTile);
+			PendingTileUpdate->Bounds = GetNavMeshTileBounds(ChangedTile);
+			PendingTileUpdate->FirstUpdateTime = CurrentTime;
+		}
+
+		// the tile is complete on the game thread, the workers won't see it rebuilt again under them
+		PendingTileUpdate->Snapshot = FCoverNavMeshTileSnapshot::Capture(*this, ChangedTile);
+		PendingTileUpdate->LastUpdateTime = CurrentTime;
+		PendingTileUpdate->DirtyAreas.Append(GetTileDirtyAreas(ChangedTile));
+	}
+	
+}
+
+void ACoverRecastNavMesh::RebuildDirtyAreas(const TArray<FNavigationDirtyArea>& DirtyAreas)
+{
+	Super::RebuildDirtyAreas(DirtyAreas);
+
+	if (!bRegenerateDirtyAreasOnly)
+		return;
+	
+	for (const FNavigationDirtyArea& DirtyArea : DirtyAreas)
+	{
+		if (DirtyArea.Bounds.IsValid)
+		{
+			PendingDirtyAreas.Add(DirtyArea.Bounds);
+		}
+	}
+}
+
+FCoverTileDirtyAreas ACoverRecastNavMesh::GetTileDirtyAreas(const uint32 TileIdx) const
+{
+	FCoverTileDirtyAreas TileDirtyAreas;
+	
+	const FBox TileBounds = GetNavMeshTileBounds(TileIdx);
+	if (!bRegenerateDirtyAreasOnly || !TileBounds.IsValid)
+	{
+		TileDirtyAreas.MarkFullTile();
+		return TileDirtyAreas;
 	}
 	
+	for (const FBox& DirtyArea : PendingDirtyAreas)
+	{
+		if (!DirtyArea.IntersectXY(TileBounds))
+			continue;
+		
+		const FBox ExpandedDirtyArea = DirtyArea.ExpandBy(DirtyAreaMargin);
+
+		// no point in tracking the area if it covers the whole tile anyway
+		if (ExpandedDirtyArea.Min.X <= TileBounds.Min.X && ExpandedDirtyArea.Min.Y <= TileBounds.Min.Y
+			&& ExpandedDirtyArea.Max.X >= TileBounds.Max.X && ExpandedDirtyArea.Max.Y >= TileBounds.Max.Y)
+		{
+			TileDirtyAreas.MarkFullTile();
+			return TileDirtyAreas;
+		}
+		
+		TileDirtyAreas.Areas.Add(ExpandedDirtyArea);
+	}
+
+	// tile was rebuilt without a dirty area we know about, e.g. RebuildAll or the initial build
+	if (TileDirtyAreas.Areas.Num() == 0)
+	{
+		TileDirtyAreas.MarkFullTile();
+	}
+
+	return TileDirtyAreas;
 }
 
 void ACoverRecastNavMesh::OnNavMeshGenerationFinished()
 {
 	Super::OnNavMeshGenerationFinished();
 
-	//don't need scope lock, the actor will not call timers asynchronously 
-	//FScopeLock TileUpdateLock(&TileUpdateLockObject);
-	//NavmeshTilesUpdatedUntilFinishedDelegate.Broadcast(UpdatedTilesUntilFinishedBuffer);
-	RegenerateCoverPoints(UpdatedTilesUntilFinishedBuffer);
-	UpdatedTilesUntilFinishedBuffer.Empty();
+	// every tile touched by the pending dirty areas has been rebuilt by now
+	PendingDirtyAreas.Empty();
 }
 
 void ACoverRecastNavMesh::OnNavigationBoundsChanged()
@@ -94,9 +183,6 @@ void ACoverRecastNavMesh::RebuildAll()
 void ACoverRecastNavMesh::BeginPlay()
 {
 	Super::BeginPlay();
-
-	//might not need this timer, we can just do it on nav mesh generation finished instead of doing it at fixed intervals
-	//GetWorld()->GetTimerManager().SetTimer(TileUpdateTimerHandle, this, &ACoverRecastNavMesh::ProcessQueuedTiles, TileBufferInterval, true);
 }
 
 void ACoverRecastNavMesh::PostRegisterAllComponents()
@@ -111,28 +197,255 @@ void ACoverRecastNavMesh::PostRegisterAllComponents()
 		//LOG_NAV_MESH(Warning, TEXT("ACoverRecastNavMesh::PostRegisterAllComponents Invalid CoverOctreeController, Constructing Octree"));
 		ConstructCoverOctree();
 	}
+
+	CoverQueryScheduler.Init(this);
+
+	// regenerated cover points are CoverPointMinDistance apart, a closer one is at the same spot
+	CoverInvalidationNotifier.Init(CoverPointMinDistance);
+
+	// the core ticker also ticks in the editor, where the nav mesh is built without playing
+	if (!TileUpdateTickerHandle.IsValid())
+	{
+		TileUpdateTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ACoverRecastNavMesh::TickTileUpdates));
+	}
+}
+
+void ACoverRecastNavMesh::BeginDestroy()
+{
+	// stop the background build before the nav mesh goes away
+	CoverVisibilityTable.Reset();
+	CoverThreatMap.Reset();
+	CoverQueryScheduler.Reset();
+	CoverInvalidationNotifier.Reset();
+
+	if (TileUpdateTickerHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(TileUpdateTickerHandle);
+		TileUpdateTickerHandle.Reset();
+	}
+
+	TileCommitQueue.Empty();
+	SET_DWORD_STAT(STAT_CoverTileCommitsQueued, 0);
+	
+	Super::BeginDestroy();
+}
+
+bool ACoverRecastNavMesh::TickTileUpdates(float DeltaTime)
+{
+	DrainTileCommits();
+
+	// the threats that don't move would keep the exposure of the cover the commits replaced
+	CoverThreatMap.UpdateDirtyThreats();
+	UpdateCoverLods();
+	ProcessQueuedTiles();
+	return true;
 }
 
 void ACoverRecastNavMesh::ProcessQueuedTiles()
 {
-	//don't need scope lock, the actor will not call timers asynchronously 
-	//FScopeLock TileUpdateLock(&TileUpdateLockObject);
-	if (UpdatedTilesIntervalBuffer.Num() > 0)
+	if (PendingTileUpdates.Num() == 0 || IsPendingKillPending())
+		return;
+
+	TArray<uint32> TileIndices;
+	PendingTileUpdates.GetKeys(TileIndices);
+
+	// flood the neighbouring tiles into groups, the layers of a tile share its bounds
+	TArray<TArray<uint32>> TileGroups;
+	TBitArray<> GroupedTiles(false, TileIndices.Num());
+	for (int32 SeedIdx = 0; SeedIdx < TileIndices.Num(); ++SeedIdx)
+	{
+		if (GroupedTiles[SeedIdx])
+			continue;
+
+		GroupedTiles[SeedIdx] = true;
+		TArray<uint32>& TileGroup = TileGroups.AddDefaulted_GetRef();
+		TileGroup.Add(TileIndices[SeedIdx]);
+		for (int32 GroupTileIdx = 0; GroupTileIdx < TileGroup.Num() && bCoalesceNeighbourTiles; ++GroupTileIdx)
+		{
+			const FBox& GroupTileBounds = PendingTileUpdates.FindChecked(TileGroup[GroupTileIdx]).Bounds;
+			if (!GroupTileBounds.IsValid)
+				continue;
+
+			const FBox NeighbourhoodBounds = GroupTileBounds.ExpandBy(1.0f);
+			for (int32 TileIdx = SeedIdx + 1; TileIdx < TileIndices.Num(); ++TileIdx)
+			{
+				const FBox& TileBounds = PendingTileUpdates.FindChecked(TileIndices[TileIdx]).Bounds;
+				if (!GroupedTiles[TileIdx] && TileBounds.IsValid && NeighbourhoodBounds.IntersectXY(TileBounds))
+				{
+					GroupedTiles[TileIdx] = true;
+					TileGroup.Add(TileIndices[TileIdx]);
+				}
+			}
+		}
+	}
+
+	const double CurrentTime = FPlatformTime::Seconds();
+	TMap<uint32, FCoverPendingTileUpdate> ReadyTiles;
+	for (const TArray<uint32>& TileGroup : TileGroups)
+	{
+		double FirstUpdateTime = MAX_dbl;
+		double LastUpdateTime = 0.0;
+		for (const uint32 TileIdx : TileGroup)
+		{
+			const FCoverPendingTileUpdate& PendingTileUpdate = PendingTileUpdates.FindChecked(TileIdx);
+			FirstUpdateTime = FMath::Min(FirstUpdateTime, PendingTileUpdate.FirstUpdateTime);
+			LastUpdateTime = FMath::Max(LastUpdateTime, PendingTileUpdate.LastUpdateTime);
+		}
+
+		// still being rebuilt, unless it has waited long enough
+		if (CurrentTime - LastUpdateTime < TileUpdateDebounce && CurrentTime - FirstUpdateTime < TileUpdateMaxLatency)
+			continue;
+
+		for (const uint32 TileIdx : TileGroup)
+		{
+			ReadyTiles.Add(TileIdx, MoveTemp(PendingTileUpdates.FindChecked(TileIdx)));
+			PendingTileUpdates.Remove(TileIdx);
+		}
+
+		INC_DWORD_STAT(STAT_CoverTileBatches);
+	}
+
+	if (ReadyTiles.Num() > 0)
+	{
+		LOG_NAV_MESH(Verbose, TEXT("ACoverRecastNavMesh::ProcessQueuedTiles - tile count: %d, pending: %d"), ReadyTiles.Num(), PendingTileUpdates.Num());
+		INC_DWORD_STAT_BY(STAT_CoverTilesRegenerated, ReadyTiles.Num());
+		RegenerateCoverPoints(ReadyTiles);
+	}
+}
+
+void ACoverRecastNavMesh::UpdateCoverLods()
+{
+	const double CurrentTime = FPlatformTime::Seconds();
+	if (!bEnableCoverLod || TileCoverLods.Num() == 0 || CurrentTime - LastCoverLodUpdateTime < CoverLodUpdateInterval || IsPendingKillPending())
+		return;
+
+	LastCoverLodUpdateTime = CurrentTime;
+
+	TArray<FVector> RelevanceLocations;
+	GetCoverRelevanceLocations(RelevanceLocations);
+
+	for (const TPair<uint32, ECoverTileLod>& TileCoverLod : TileCoverLods)
+	{
+		// already waiting, it's regenerated at the LOD it needs then
+		if (PendingTileUpdates.Contains(TileCoverLod.Key))
+			continue;
+
+		const FBox TileBounds = GetNavMeshTileBounds(TileCoverLod.Key);
+		if (!TileBounds.IsValid || GetDesiredTileLod(TileBounds, TileCoverLod.Value, RelevanceLocations) == TileCoverLod.Value)
+			continue;
+
+		// the tile itself didn't change, no need to wait for it to settle
+		FCoverPendingTileUpdate& PendingTileUpdate = PendingTileUpdates.Add(TileCoverLod.Key);
+		PendingTileUpdate.DirtyAreas.MarkFullTile();
+		PendingTileUpdate.Bounds = TileBounds;
+		PendingTileUpdate.FirstUpdateTime = CurrentTime - TileUpdateDebounce;
+		PendingTileUpdate.LastUpdateTime = CurrentTime - TileUpdateDebounce;
+	}
+}
+
+void ACoverRecastNavMesh::GetCoverRelevanceLocations(TArray<FVector>& OutLocations) const
+{
+	for (const TWeakObjectPtr<const AActor>& Source : CoverRelevanceSources)
+	{
+		if (Source.IsValid())
+		{
+			OutLocations.Add(Source->GetActorLocation());
+		}
+	}
+
+	if (bPawnsAreCoverRelevanceSources && GetWorld())
+	{
+		for (TActorIterator<APawn> PawnIt(GetWorld()); PawnIt; ++PawnIt)
+		{
+			OutLocations.Add(PawnIt->GetActorLocation());
+		}
+	}
+}
+
+ECoverTileLod ACoverRecastNavMesh::GetDesiredTileLod(const FBox& TileBounds, const ECoverTileLod CurrentLod, const TArray<FVector>& RelevanceLocations) const
+{
+	const UWorld* World = GetWorld();
+	if (!bEnableCoverLod || !World || !World->IsGameWorld() || !TileBounds.IsValid)
+		return ECoverTileLod::Fine;
+
+	float MinDistanceSq = MAX_flt;
+	for (const FVector& Location : RelevanceLocations)
 	{
-		LOG_NAV_MESH(Log, TEXT("ACoverRecastNavMesh::ProcessQueuedTiles - tile count: %d"), UpdatedTilesIntervalBuffer.Num());
-		RegenerateCoverPoints(UpdatedTilesIntervalBuffer);
-		UpdatedTilesIntervalBuffer.Empty();
+		MinDistanceSq = FMath::Min(MinDistanceSq, TileBounds.ComputeSquaredDistanceToPoint(Location));
 	}
+
+	const float FineDistance = CoverLodFineDistance + (CurrentLod == ECoverTileLod::Fine ? CoverLodHysteresis : 0.0f);
+	const float CoarseDistance = CoverLodCoarseDistance + (CurrentLod != ECoverTileLod::None ? CoverLodHysteresis : 0.0f);
+	if (MinDistanceSq <= FMath::Square(FineDistance))
+		return ECoverTileLod::Fine;
+
+	return MinDistanceSq <= FMath::Square(CoarseDistance) ? ECoverTileLod::Coarse : ECoverTileLod::None;
+}
+
+void ACoverRecastNavMesh::AddCoverRelevanceSource(const AActor* Source)
+{
+	CoverRelevanceSources.AddUnique(Source);
+}
+
+void ACoverRecastNavMesh::RemoveCoverRelevanceSource(const AActor* Source)
+{
+	CoverRelevanceSources.RemoveAllSwap([Source](const TWeakObjectPtr<const AActor>& Other) { return !Other.IsValid() || Other.Get() == Source; });
 }
 
-void ACoverRecastNavMesh::RegenerateCoverPoints(const TSet<uint32>& UpdatedTiles)
+void ACoverRecastNavMesh::RegenerateCoverPoints(const TMap<uint32, FCoverPendingTileUpdate>& UpdatedTiles)
 {
 	if (IsPendingKillPending())
 		return;
+
+	TArray<FVector> RelevanceLocations;
+	if (bEnableCoverLod)
+	{
+		GetCoverRelevanceLocations(RelevanceLocations);
+	}
 		
 	// regenerate cover points within the updated navmesh tiles
-	for (uint32 TileIdx : UpdatedTiles)
+	for (const auto& UpdatedTile : UpdatedTiles)
 	{
+		const uint32 TileIdx = UpdatedTile.Key;
+		const TSharedRef<const FCoverNavMeshTileSnapshot, ESPMode::ThreadSafe> Snapshot = UpdatedTile.Value.Snapshot.IsValid()
+			? UpdatedTile.Value.Snapshot.ToSharedRef() : FCoverNavMeshTileSnapshot::Capture(*this, TileIdx);
+
+		const ECoverTileLod* CurrentLod = TileCoverLods.Find(TileIdx);
+		const bool bWasGenerated = CurrentLod != nullptr;
+		const ECoverTileLod PreviousLod = bWasGenerated ? *CurrentLod : ECoverTileLod::None;
+		// same bounds as UpdateCoverLods, so they agree on the LOD
+		const ECoverTileLod Lod = GetDesiredTileLod(GetNavMeshTileBounds(TileIdx), PreviousLod, RelevanceLocations);
+		const bool bLodChanged = !bWasGenerated || PreviousLod != Lod;
+		if (bWasGenerated && bLodChanged)
+		{
+			INC_DWORD_STAT(STAT_CoverLodChanges);
+		}
+
+		TileCoverLods.Add(TileIdx, Lod);
+
+		// no cover this far from the sources, drop the tile's cover points if it had any
+		if (Lod == ECoverTileLod::None)
+		{
+			if (PreviousLod != ECoverTileLod::None)
+			{
+				// stamped like the workers' commits, so one of them still running can't bring the cover points back
+				FCoverTileCommit Commit;
+				Commit.Area = Snapshot->Bounds;
+				Commit.TileIndex = TileIdx;
+				Commit.Generation = NextTileCoverGeneration(TileIdx, true);
+				EnqueueTileCommit(MoveTemp(Commit));
+			}
+
+			continue;
+		}
+		
+		// full tiles have no dirty areas, an empty array regenerates the whole tile
+		// a tile changing LOD is regenerated whole too, its kept cover points would be at the old step
+		static const TArray<FBox> FullTile;
+		const TArray<FBox>& DirtyAreas = bLodChanged ? FullTile : UpdatedTile.Value.DirtyAreas.Areas;
+		const float CoverPointStep = Lod == ECoverTileLod::Coarse ? CoverPointMinDistance * CoverLodCoarseStepMultiplier : CoverPointMinDistance;
+		const uint32 Generation = NextTileCoverGeneration(TileIdx, DirtyAreas.Num() == 0);
+
 #if DEBUG_RENDERING
 		if (CVarDrawUpdatedTiles.GetValueOnGameThread())
 		{
@@ -144,24 +457,152 @@ void ACoverRecastNavMesh::RegenerateCoverPoints(const TSet<uint32>& UpdatedTiles
 #if DEBUG_RENDERING
 		// DrawDebugXXX calls may crash UE4 when not called from the main thread, so start synchronous tasks in case we're planning on drawing debug shapes
 		if (CVarDrawCoverPointGenerator.GetValueOnGameThread())
-			(new FAutoDeleteAsyncTask<FNavmeshCoverPointGeneratorAsyncTask>(CoverPointMinDistance, UCoverSystemStatics::SmallestAgentHeight,
-			UCoverSystemStatics::CoverPointGroundOffset,MapBounds, TileIdx, this))->StartSynchronousTask();
+			(new FAutoDeleteAsyncTask<FNavmeshCoverPointGeneratorAsyncTask>(CoverPointStep, UCoverSystemStatics::SmallestAgentHeight,
+			UCoverSystemStatics::CoverPointGroundOffset,MapBounds, Snapshot, DirtyAreas, Generation, this))->StartSynchronousTask();
 		else
 #endif
-		(new FAutoDeleteAsyncTask<FNavmeshCoverPointGeneratorAsyncTask>(CoverPointMinDistance, UCoverSystemStatics::SmallestAgentHeight,
-			UCoverSystemStatics::CoverPointGroundOffset,MapBounds, TileIdx, this))->StartBackgroundTask();
+		(new FAutoDeleteAsyncTask<FNavmeshCoverPointGeneratorAsyncTask>(CoverPointStep, UCoverSystemStatics::SmallestAgentHeight,
+			UCoverSystemStatics::CoverPointGroundOffset,MapBounds, Snapshot, DirtyAreas, Generation, this))->StartBackgroundTask();
+	}
+
+#if STATS
+	int32 NumFineTiles = 0;
+	int32 NumCoarseTiles = 0;
+	for (const TPair<uint32, ECoverTileLod>& TileCoverLod : TileCoverLods)
+	{
+		NumFineTiles += TileCoverLod.Value == ECoverTileLod::Fine;
+		NumCoarseTiles += TileCoverLod.Value == ECoverTileLod::Coarse;
 	}
+
+	SET_DWORD_STAT(STAT_CoverLodFineTiles, NumFineTiles);
+	SET_DWORD_STAT(STAT_CoverLodCoarseTiles, NumCoarseTiles);
+#endif
+}
+
+uint32 ACoverRecastNavMesh::NextTileCoverGeneration(const uint32 TileIdx, const bool bFullTile)
+{
+	const uint32 Generation = ++LastTileCoverGeneration;
+	if (bFullTile)
+	{
+		TileCoverGenerations.FindOrAdd(TileIdx).LatestFull = Generation;
+	}
+
+	return Generation;
+}
+
+void ACoverRecastNavMesh::EnqueueTileCommit(FCoverTileCommit&& Commit)
+{
+	if (IsPendingKillPending())
+		return;
+
+	Commit.EnqueueTime = FPlatformTime::Seconds();
+	TileCommitQueue.Enqueue(MoveTemp(Commit));
+	INC_DWORD_STAT(STAT_CoverTileCommitsQueued);
+}
+
+void ACoverRecastNavMesh::DrainTileCommits()
+{
+	if (TileCommitQueue.IsEmpty() || IsPendingKillPending() || !CoverOctreeController.IsValid())
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_CoverCommitTiles);
+	const double StartTime = FPlatformTime::Seconds();
+	const double EndTime = TileCommitBudget > 0.0f ? StartTime + TileCommitBudget * 0.001 : MAX_dbl;
+	double MaxLatency = 0.0;
+	int32 NumCommitted = 0;
+	int32 NumDiscarded = 0;
+	TMap<uint32, FCoverTileDirtyAreas> OutOfOrderTiles;
+	{
+		// readers wait for the whole drain once, instead of for every worker twice
+		FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_Write);
+
+		// the tiles left over once the budget runs out are committed on the next frame
+		FCoverTileCommit Commit;
+		while ((NumCommitted == 0 || FPlatformTime::Seconds() < EndTime) && TileCommitQueue.Dequeue(Commit))
+		{
+			// a later full regeneration replaces it anyway, applying it after that one would bring back its stale cover points
+			FCoverTileGeneration& TileGeneration = TileCoverGenerations.FindOrAdd(Commit.TileIndex);
+			if (Commit.Generation != 0 && Commit.Generation < TileGeneration.LatestFull)
+			{
+				++NumDiscarded;
+				continue;
+			}
+
+			// a newer commit of the tile got in first, its areas are regenerated from the current tile instead
+			if (Commit.Generation != 0 && Commit.Generation < TileGeneration.LastCommitted)
+			{
+				FCoverTileDirtyAreas& DirtyAreas = OutOfOrderTiles.FindOrAdd(Commit.TileIndex);
+				if (Commit.DirtyAreas.Num() == 0)
+				{
+					DirtyAreas.MarkFullTile();
+				}
+
+				for (const FBox& DirtyArea : Commit.DirtyAreas)
+				{
+					DirtyAreas.AddArea(DirtyArea);
+				}
+
+				++NumDiscarded;
+				continue;
+			}
+
+			TileGeneration.LastCommitted = FMath::Max(TileGeneration.LastCommitted, Commit.Generation);
+			MaxLatency = FMath::Max(MaxLatency, StartTime - Commit.EnqueueTime);
+
+			Internal_UpdateCoverPointNodeRefs(Commit.KeptNodeRefs);
+			Internal_RemoveStaleCoverPoints(Commit.Area, Commit.TileIndex, Commit.DirtyAreas);
+			Internal_AddCoverPoints(Commit.CoverPoints);
+			++NumCommitted;
+		}
+	}
+
+	// ready right away, like the tiles changing LOD
+	const double CurrentTime = FPlatformTime::Seconds();
+	for (TPair<uint32, FCoverTileDirtyAreas>& OutOfOrderTile : OutOfOrderTiles)
+	{
+		FCoverPendingTileUpdate* PendingTileUpdate = PendingTileUpdates.Find(OutOfOrderTile.Key);
+		if (!PendingTileUpdate)
+		{
+			PendingTileUpdate = &PendingTileUpdates.Add(OutOfOrderTile.Key);
+			PendingTileUpdate->Bounds = GetNavMeshTileBounds(OutOfOrderTile.Key);
+			PendingTileUpdate->FirstUpdateTime = CurrentTime - TileUpdateDebounce;
+			PendingTileUpdate->LastUpdateTime = CurrentTime - TileUpdateDebounce;
+		}
+
+		PendingTileUpdate->DirtyAreas.Append(OutOfOrderTile.Value);
+	}
+
+	DEC_DWORD_STAT_BY(STAT_CoverTileCommitsQueued, NumCommitted + NumDiscarded);
+	INC_DWORD_STAT_BY(STAT_CoverTileCommits, NumCommitted);
+	INC_DWORD_STAT_BY(STAT_CoverTileCommitsDiscarded, NumDiscarded);
+	SET_FLOAT_STAT(STAT_CoverTileCommitLatency, MaxLatency * 1000.0);
+	SET_FLOAT_STAT(STAT_CoverTileCommitDrainCost, (FPlatformTime::Seconds() - StartTime) * 1000.0);
 }
 
 void ACoverRecastNavMesh::ConstructCoverOctree()
 {
 	CoverOctreeController.Reset();
+	CoverInvalidationNotifier.NotifyAllRemoved();
+	TileCoverLods.Empty();
 
 	const float Radius = GetNavMeshBounds().GetSize().Size();
 	CoverOctreeController.CoverOctree = MakeShareable(new FCoverOctree(FVector(0, 0, 0), Radius));
+
+	CoverVisibilityTable.Reset();
+	if (bBuildCoverVisibilityTable)
+	{
+		CoverVisibilityTable.Init(this, CoverVisibilityRange, UCoverSystemStatics::CoverTraceChannel);
+	}
+
+	CoverQueryResultCache.Init(CoverQueryCacheMaxEntries, CoverQueryCacheLifetime);
+
+	CoverThreatMap.Init(this, CoverThreatRange, CoverThreatUpdateDistance);
+
+	// the new octree has no taken cover points
+	CoverReservationGrid.Init(CoverReservationRadius);
 }
 
-void ACoverRecastNavMesh::AddCoverPoints(const TArray<FDataTransferObjectCoverData>& CoverPoints) const
+void ACoverRecastNavMesh::AddCoverPoints(const TArray<FDataTransferObjectCoverData>& CoverPoints)
 {
 	if (IsPendingKillPending() || !CoverOctreeController.IsValid())
 		return;
@@ -179,36 +620,75 @@ FBox ACoverRecastNavMesh::EnlargeAABB(const FBox Box, float Multiplier)
 	));
 }
 
-void ACoverRecastNavMesh::RemoveStaleCoverPoints(FBox Area, const TileIndexType StaleTileIndex)
+void ACoverRecastNavMesh::RemoveStaleCoverPoints(FBox Area, const TileIndexType StaleTileIndex, const TArray<FBox>& DirtyAreas)
 {
 	if (IsPendingKillPending() || !CoverOctreeController.IsValid())
 		return;
 
 	FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_Write);
-	Internal_RemoveStaleCoverPoints(Area, StaleTileIndex);
+	Internal_RemoveStaleCoverPoints(Area, StaleTileIndex, DirtyAreas);
 }
 
-void ACoverRecastNavMesh::RemoveStaleAndAddCoverPoints(FBox Area, const TileIndexType StaleTileIndex, const TArray<FDataTransferObjectCoverData>& CoverPoints)
+void ACoverRecastNavMesh::RemoveStaleAndAddCoverPoints(FBox Area, const TileIndexType StaleTileIndex, const TArray<FDataTransferObjectCoverData>& CoverPoints,
+	const TArray<FBox>& DirtyAreas)
 {
 	if (IsPendingKillPending() || !CoverOctreeController.IsValid())
 		return;
 
 	FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_Write);
 
-	Internal_RemoveStaleCoverPoints(Area, StaleTileIndex);
+	Internal_RemoveStaleCoverPoints(Area, StaleTileIndex, DirtyAreas);
 	Internal_AddCoverPoints(CoverPoints);
 }
 
-void ACoverRecastNavMesh::Internal_AddCoverPoints(const TArray<FDataTransferObjectCoverData>& CoverPoints) const
+void ACoverRecastNavMesh::UpdateCoverPointNodeRefs(const TArray<TPair<FVector, NavNodeRef>>& NodeRefs) const
+{
+	if (IsPendingKillPending() || !CoverOctreeController.IsValid() || NodeRefs.Num() == 0)
+		return;
+
+	FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_Write);
+	Internal_UpdateCoverPointNodeRefs(NodeRefs);
+}
+
+void ACoverRecastNavMesh::Internal_UpdateCoverPointNodeRefs(const TArray<TPair<FVector, NavNodeRef>>& NodeRefs) const
+{
+	if (NodeRefs.Num() == 0)
+		return;
+
+	TArray<FCoverHandle> UpdatedHandles;
+	for (const TPair<FVector, NavNodeRef>& NodeRef : NodeRefs)
+	{
+		const FOctreeElementId2* Id = CoverOctreeController.GetElementNavOctreeId(NodeRef.Key);
+		if (Id && Id->IsValidId())
+		{
+			const FCoverPointOctreeData& Data = *CoverOctreeController.CoverOctree->GetElementById(*Id).Data;
+			if (Data.NodeRef != NodeRef.Value)
+			{
+				UpdatedHandles.Add(Data.Handle);
+				CoverOctreeController.CoverOctree->SetElementNodeRef(*Id, NodeRef.Value);
+			}
+		}
+	}
+
+	CoverInvalidationNotifier.NotifyUpdated(UpdatedHandles);
+}
+
+void ACoverRecastNavMesh::Internal_AddCoverPoints(const TArray<FDataTransferObjectCoverData>& CoverPoints)
 {
 	if (IsPendingKillPending() || !CoverOctreeController.IsValid())
 		return;
-	
+
+	TArray<FCoverPointOctreeElement> AddedCoverPoints;
 	for (auto CoverPoint : CoverPoints)
 	{
 		//#TODO add to object map??
-		// ReSharper disable once CppExpressionWithoutSideEffects
-		const bool bInserted = CoverOctreeController.AddNode(CoverPoint, CoverPointMinDistance * 0.9f);
+		const FCoverPointOctreeElement Element(CoverPoint);
+		const bool bInserted = CoverOctreeController.AddNode(Element, CoverPointMinDistance * 0.9f);
+		if (bInserted)
+		{
+			AddedCoverPoints.Add(Element);
+		}
+		
 #if DEBUG_RENDERING
 		static const auto CVarDrawCoverPoints = IConsoleManager::Get().FindConsoleVariable(TEXT("r.DrawCoverPoints")); 
 		if (CVarDrawCoverPoints->GetBool() && !bInserted)
@@ -220,9 +700,23 @@ void ACoverRecastNavMesh::Internal_AddCoverPoints(const TArray<FDataTransferObje
 	
 	// optimize the octree
 	CoverOctreeController.CoverOctree->ShrinkElements();
+
+	CoverVisibilityTable.AddCoverPoints(AddedCoverPoints);
+	CoverInvalidationNotifier.NotifyAdded(AddedCoverPoints);
+
+	FBox AddedBounds(ForceInit);
+	for (const FCoverPointOctreeElement& AddedCoverPoint : AddedCoverPoints)
+	{
+		AddedBounds += AddedCoverPoint.Data->Location;
+	}
+
+	if (AddedBounds.IsValid)
+	{
+		CoverThreatMap.InvalidateArea(AddedBounds);
+	}
 }
 
-void ACoverRecastNavMesh::Internal_RemoveStaleCoverPoints(FBox Area, const TileIndexType StaleTileIndex)
+void ACoverRecastNavMesh::Internal_RemoveStaleCoverPoints(FBox Area, const TileIndexType StaleTileIndex, const TArray<FBox>& DirtyAreas)
 {
 	if (IsPendingKillPending() || !CoverOctreeController.IsValid())
 		return;
@@ -242,6 +736,25 @@ void ACoverRecastNavMesh::Internal_RemoveStaleCoverPoints(FBox Area, const TileI
 	TArray<FCoverPointOctreeElement> CoverPoints;
 	CoverOctreeController.FindElementsInNavOctree(Area, CoverPoints);
 
+	TArray<FCoverHandle> RemovedHandles;
+	TArray<TPair<FCoverHandle, FVector>> RemovedCoverPoints;
+
+	// the kept cover points of the tile can be affected by the changes too
+	CoverQueryResultCache.InvalidateTile(StaleTileIndex);
+
+	// so can the cover points of other tiles evaluated against targets across the changes, the lean sweeps start to the sides of the cover point
+	if (DirtyAreas.Num() > 0)
+	{
+		for (const FBox& DirtyArea : DirtyAreas)
+		{
+			CoverQueryResultCache.InvalidateArea(DirtyArea.ExpandBy(UCoverSystemStatics::CoverLeanOffset));
+		}
+	}
+	else
+	{
+		CoverQueryResultCache.InvalidateArea(Area.ExpandBy(UCoverSystemStatics::CoverLeanOffset));
+	}
+
 	for (FCoverPointOctreeElement CoverPoint : CoverPoints)
 	{
 		// NOTE 2, do not do this either, this will keep stale items as long as the actor is not deleted. if the actor moves then it will not be cleaned up
@@ -250,7 +763,13 @@ void ACoverRecastNavMesh::Internal_RemoveStaleCoverPoints(FBox Area, const TileI
 		// just checking the tile index is enough for now
 		// FNavLocation NavLocation;
 		//if (CoverPoint.Data->TileIndex != StaleTileIndex && IsValid(CoverPoint.GetOwner()) && ProjectPoint(CoverPoint.Data->Location, NavLocation, FVector(0.1f, 0.1f, CoverPointGroundOffset)))
-		if (CoverPoint.Data->TileIndex != StaleTileIndex && IsValid(CoverPoint.GetOwner()) )
+		// when only parts of the tile were regenerated, keep the tile's cover points outside of the dirty areas
+		const bool bOutsideDirtyAreas = DirtyAreas.Num() > 0 && !DirtyAreas.ContainsByPredicate([&CoverPoint](const FBox& DirtyArea)
+		{
+			return DirtyArea.IsInsideOrOn(CoverPoint.Data->Location);
+		});
+		
+		if ((CoverPoint.Data->TileIndex != StaleTileIndex || bOutsideDirtyAreas) && IsValid(CoverPoint.GetOwner()) )
 		{
 /*#if DEBUG_RENDERING
 			LOG_NAV_MESH(Warning, TEXT("KEEP %d != %d, IsValid: %d, bProjectPoint: %d"), CoverPoint.Data->TileIndex, StaleTileIndex, IsValid(CoverPoint.GetOwner()), bProjectPoint);
@@ -282,10 +801,25 @@ void ACoverRecastNavMesh::Internal_RemoveStaleCoverPoints(FBox Area, const TileI
 		// #TODO remove object to location map??
 		CoverOctreeController.RemoveElementNavOctreeId(CoverPoint.Data->Location);
 		CoverOctreeController.CoverObjectToLocation.RemoveSingle(CoverPoint.Data->CoverObject, CoverPoint.Data->Location);
+
+		// the area reserved around a held cover point goes with it, its holder is told through CoverInvalidationNotifier
+		if (CoverPoint.Data->bTaken)
+		{
+			CoverReservationGrid.Release(CoverPoint.Data->Handle);
+		}
+
+		RemovedHandles.Add(CoverPoint.Data->Handle);
+		RemovedCoverPoints.Emplace(CoverPoint.Data->Handle, CoverPoint.Data->Location);
 	}
 
 	// optimize the octree
 	CoverOctreeController.CoverOctree->ShrinkElements();
+
+	CoverVisibilityTable.RemoveCoverPoints(RemovedHandles);
+	CoverInvalidationNotifier.NotifyRemoved(RemovedCoverPoints);
+
+	// the poly refs of the area change with the tile too
+	CoverThreatMap.InvalidateArea(Area);
 }
 
 /** Internal. Calculates squared 2d distance of given point PT to segment P-Q. Values given in Recast coordinates */
@@ -319,6 +853,291 @@ bool ACoverRecastNavMesh::GetCoverPointOctreeElement(FCoverPointOctreeElement& O
 	return false;	
 }
 
+bool ACoverRecastNavMesh::GetCoverPointOctreeElement(FCoverPointOctreeElement& OutElement, const FCoverHandle& Handle) const
+{
+	if (IsPendingKillPending() || !CoverOctreeController.IsValid())
+		return false;
+
+	FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_ReadOnly);
+	const FOctreeElementId2* Element = CoverOctreeController.GetElementNavOctreeId(Handle);
+	if (Element && Element->IsValidId())
+	{
+		OutElement = CoverOctreeController.CoverOctree->GetElementById(*Element);
+		return true;
+	}
+
+	return false;
+}
+
+bool ACoverRecastNavMesh::HoldCover(const FCoverHandle& Handle, const UObject* Holder)
+{
+	if (IsPendingKillPending() || !CoverOctreeController.IsValid())
+		return false;
+
+	FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_Write);
+	const FOctreeElementId2* Element = CoverOctreeController.GetElementNavOctreeId(Handle);
+	if (!Element || !Element->IsValidId())
+		return false;
+
+	const uint32 HolderId = Holder ? Holder->GetUniqueID() : 0;
+	const FCoverPointOctreeData& Data = *CoverOctreeController.CoverOctree->GetElementById(*Element).Data;
+	if (Data.bTaken || !CoverReservationGrid.Reserve(Handle, Data.Location, HolderId))
+		return false;
+
+	return CoverOctreeController.CoverOctree->HoldCover(*Element, HolderId);
+}
+
+bool ACoverRecastNavMesh::ReleaseCover(const FCoverHandle& Handle)
+{
+	if (!CoverOctreeController.IsValid())
+		return false;
+
+	FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_Write);
+
+	// a no-op if the cover point was removed by a tile regeneration while held, its area was released along with it
+	CoverReservationGrid.Release(Handle);
+
+	const FOctreeElementId2* Element = CoverOctreeController.GetElementNavOctreeId(Handle);
+	return Element && CoverOctreeController.CoverOctree->ReleaseCover(*Element);
+}
+
+bool ACoverRecastNavMesh::IsCoverAreaReserved(const FVector& Location, const UObject* IgnoredHolder) const
+{
+	return CoverReservationGrid.IsReserved(Location, IgnoredHolder ? IgnoredHolder->GetUniqueID() : 0);
+}
+
+bool ACoverRecastNavMesh::IsCoverAreaReserved(const FVector& Location, const TArray<const UObject*>& IgnoredHolders) const
+{
+	TArray<uint32> IgnoredHolderIds;
+	for (const UObject* IgnoredHolder : IgnoredHolders)
+	{
+		if (IgnoredHolder)
+		{
+			IgnoredHolderIds.Add(IgnoredHolder->GetUniqueID());
+		}
+	}
+
+	return CoverReservationGrid.IsReserved(Location, IgnoredHolderIds);
+}
+
+bool ACoverRecastNavMesh::IsCoverHeldBy(const FCoverHandle& Handle, const UObject* Holder) const
+{
+	if (!Holder || IsPendingKillPending() || !CoverOctreeController.IsValid())
+		return false;
+
+	FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_ReadOnly);
+	const FOctreeElementId2* Element = CoverOctreeController.GetElementNavOctreeId(Handle);
+	if (!Element || !Element->IsValidId())
+		return false;
+
+	const FCoverPointOctreeData& Data = *CoverOctreeController.CoverOctree->GetElementById(*Element).Data;
+	return Data.bTaken && Data.HolderId == Holder->GetUniqueID();
+}
+
+bool ACoverRecastNavMesh::FindNearestCoverPoint(FCoverPointOctreeElement& OutElement, const FVector& Location, const float MaxDistance) const
+{
+	TArray<FCoverPointOctreeElement> CoverPoints;
+	FindCoverPoints(FSphere(Location, MaxDistance), CoverPoints);
+
+	float NearestDistanceSq = FLT_MAX;
+	for (const FCoverPointOctreeElement& CoverPoint : CoverPoints)
+	{
+		const float DistanceSq = FVector::DistSquared(CoverPoint.Data->Location, Location);
+		if (DistanceSq < NearestDistanceSq)
+		{
+			NearestDistanceSq = DistanceSq;
+			OutElement = CoverPoint;
+		}
+	}
+
+	return NearestDistanceSq < FLT_MAX;
+}
+
+void ACoverRecastNavMesh::FindCoverPointsOnPolys(const TArray<NavNodeRef>& PolyRefs, TArray<FCoverPointOctreeElement>& OutCoverPoints) const
+{
+	if (IsPendingKillPending() || !CoverOctreeController.IsValid())
+		return;
+
+	FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_ReadOnly);
+	for (const NavNodeRef PolyRef : PolyRefs)
+	{
+		CoverOctreeController.FindElementsOnPoly(PolyRef, OutCoverPoints);
+	}
+}
+
+int32 ACoverRecastNavMesh::GetNumCoverPointsOnPoly(const NavNodeRef PolyRef) const
+{
+	if (IsPendingKillPending() || !CoverOctreeController.IsValid())
+		return 0;
+
+	FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_ReadOnly);
+	return CoverOctreeController.GetNumElementsOnPoly(PolyRef);
+}
+
+void ACoverRecastNavMesh::FindCoverPointsAlongPath(const FNavMeshPath& Path, TArray<FCoverPointOctreeElement>& OutCoverPoints) const
+{
+	FindCoverPointsOnPolys(Path.PathCorridor, OutCoverPoints);
+}
+
+void ACoverRecastNavMesh::FindCoverPointsNearPoly(const NavNodeRef StartPoly, const int32 MaxPolyDistance, TArray<FCoverPointOctreeElement>& OutCoverPoints) const
+{
+	if (StartPoly == INVALID_NAVNODEREF)
+		return;
+
+	// breadth first, one ring of neighbours per step
+	TSet<NavNodeRef> VisitedPolys;
+	TArray<NavNodeRef> Ring;
+	TArray<NavNodeRef> NextRing;
+	TArray<NavNodeRef> Neighbours;
+	
+	VisitedPolys.Add(StartPoly);
+	Ring.Add(StartPoly);
+	for (int32 PolyDistance = 0; PolyDistance < MaxPolyDistance && Ring.Num() > 0; ++PolyDistance)
+	{
+		NextRing.Reset();
+		for (const NavNodeRef PolyRef : Ring)
+		{
+			Neighbours.Reset();
+			GetPolyNeighbors(PolyRef, Neighbours);
+			for (const NavNodeRef Neighbour : Neighbours)
+			{
+				bool bAlreadyVisited = false;
+				VisitedPolys.Add(Neighbour, &bAlreadyVisited);
+				if (!bAlreadyVisited)
+				{
+					NextRing.Add(Neighbour);
+				}
+			}
+		}
+
+		Swap(Ring, NextRing);
+	}
+
+	FindCoverPointsOnPolys(VisitedPolys.Array(), OutCoverPoints);
+}
+
+void ACoverRecastNavMesh::FindCoverPointsInNavArea(const TSubclassOf<UNavArea> AreaClass, TArray<FCoverPointOctreeElement>& OutCoverPoints) const
+{
+	const int32 AreaID = GetAreaID(AreaClass);
+	if (AreaID == INDEX_NONE || IsPendingKillPending() || !CoverOctreeController.IsValid())
+		return;
+
+	FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_ReadOnly);
+
+	TArray<NavNodeRef> PolyRefs;
+	CoverOctreeController.CoverOctree->NodeRefToHandles.GetKeys(PolyRefs);
+	for (const NavNodeRef PolyRef : PolyRefs)
+	{
+		if (GetPolyAreaID(PolyRef) == static_cast<uint32>(AreaID))
+		{
+			CoverOctreeController.FindElementsOnPoly(PolyRef, OutCoverPoints);
+		}
+	}
+}
+
+bool ACoverRecastNavMesh::FindReachablePolys(const FVector& StartLocation, const float MaxCost, TMap<NavNodeRef, FCoverPolyReach>& OutReachedPolys,
+	FSharedConstNavQueryFilter QueryFilter) const
+{
+	OutReachedPolys.Reset();
+
+	if (!QueryFilter.IsValid())
+	{
+		QueryFilter = GetDefaultQueryFilter();
+	}
+
+	const dtNavMesh* DetourNavMesh = GetRecastMesh();
+	const FRecastQueryFilter* RecastFilter = QueryFilter.IsValid() ? static_cast<const FRecastQueryFilter*>(QueryFilter->GetImplementation()) : nullptr;
+	if (!DetourNavMesh || !RecastFilter)
+		return false;
+
+	const NavNodeRef StartPoly = FindNearestPoly(StartLocation, GetConfig().DefaultQueryExtent, QueryFilter);
+	if (StartPoly == INVALID_NAVNODEREF)
+		return false;
+
+	// same cost as pathfinding: the segment crossing a poly is charged by the filter, which knows the poly it leads to for the area change cost
+	auto GetSegmentCost = [DetourNavMesh, RecastFilter](const FVector& Start, const FVector& End, const NavNodeRef PolyRef, const NavNodeRef NextPolyRef)
+	{
+		const dtMeshTile* Tile = nullptr;
+		const dtPoly* Poly = nullptr;
+		DetourNavMesh->getTileAndPolyByRefUnsafe(PolyRef, &Tile, &Poly);
+
+		const dtMeshTile* NextTile = nullptr;
+		const dtPoly* NextPoly = nullptr;
+		if (NextPolyRef != INVALID_NAVNODEREF)
+		{
+			DetourNavMesh->getTileAndPolyByRefUnsafe(NextPolyRef, &NextTile, &NextPoly);
+		}
+
+		const FVector RecastStart = Unreal2RecastPoint(Start);
+		const FVector RecastEnd = Unreal2RecastPoint(End);
+		return RecastFilter->getCost(&RecastStart.X, &RecastEnd.X, 0, nullptr, nullptr, PolyRef, Tile, Poly, NextPolyRef, NextTile, NextPoly);
+	};
+
+	auto PassesFilter = [DetourNavMesh, RecastFilter](const NavNodeRef PolyRef)
+	{
+		const dtMeshTile* Tile = nullptr;
+		const dtPoly* Poly = nullptr;
+		DetourNavMesh->getTileAndPolyByRefUnsafe(PolyRef, &Tile, &Poly);
+		return Poly->getArea() != RECAST_NULL_AREA && RecastFilter->passFilter(PolyRef, Tile, Poly);
+	};
+
+	// the costs are linear in the distance travelled, the generators finish the path to a cover point inside its poly with it
+	auto GetCostPerUnit = [&GetSegmentCost](const FVector& Location, const NavNodeRef PolyRef)
+	{
+		return GetSegmentCost(Location, Location + FVector(1.0f, 0.0f, 0.0f), PolyRef, INVALID_NAVNODEREF);
+	};
+
+	struct FOpenPoly
+	{
+		NavNodeRef PolyRef;
+		float Cost;
+	};
+
+	auto CheapestFirstPredicate = [](const FOpenPoly& A, const FOpenPoly& B) { return A.Cost < B.Cost; };
+
+	TArray<FOpenPoly> OpenPolys;
+	TSet<NavNodeRef> ClosedPolys;
+	TArray<FNavigationPortalEdge> Portals;
+
+	OutReachedPolys.Add(StartPoly, { 0.0f, StartLocation, GetCostPerUnit(StartLocation, StartPoly) });
+	OpenPolys.HeapPush({ StartPoly, 0.0f }, CheapestFirstPredicate);
+	while (OpenPolys.Num() > 0)
+	{
+		FOpenPoly CurrentPoly;
+		OpenPolys.HeapPop(CurrentPoly, CheapestFirstPredicate, false);
+
+		// a poly is pushed again whenever a cheaper path to it is found, only the cheapest entry is expanded
+		bool bAlreadyClosed = false;
+		ClosedPolys.Add(CurrentPoly.PolyRef, &bAlreadyClosed);
+		if (bAlreadyClosed)
+			continue;
+
+		const FVector EntryLocation = OutReachedPolys[CurrentPoly.PolyRef].EntryLocation;
+
+		Portals.Reset();
+		GetPolyNeighbors(CurrentPoly.PolyRef, Portals);
+		for (const FNavigationPortalEdge& Portal : Portals)
+		{
+			if (ClosedPolys.Contains(Portal.ToRef) || !PassesFilter(Portal.ToRef))
+				continue;
+
+			const FVector PortalLocation = Portal.GetMiddlePoint();
+			const float Cost = CurrentPoly.Cost + GetSegmentCost(EntryLocation, PortalLocation, CurrentPoly.PolyRef, Portal.ToRef);
+			if (Cost > MaxCost)
+				continue;
+
+			const FCoverPolyReach* ExistingReach = OutReachedPolys.Find(Portal.ToRef);
+			if (ExistingReach && ExistingReach->Cost <= Cost)
+				continue;
+
+			OutReachedPolys.Add(Portal.ToRef, { Cost, PortalLocation, GetCostPerUnit(PortalLocation, Portal.ToRef) });
+			OpenPolys.HeapPush({ Portal.ToRef, Cost }, CheapestFirstPredicate);
+		}
+	}
+
+	return true;
+}
+
 bool ACoverRecastNavMesh::GetPolyEdges(NavNodeRef PolyID, TArray<FVector>& NavMeshEdgeVerts) const
 {
 	const FPImplRecastNavMesh* NavMeshImpl = GetRecastNavMeshImpl();
@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoverReservationGrid.h"
+
+#include "CoverSystemStatics.h"
+
+FCoverReservationGrid::FCoverReservationGrid()
+	: ExclusionRadius(0.0f)
+{
+}
+
+void FCoverReservationGrid::Init(const float InExclusionRadius)
+{
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_Write);
+	ExclusionRadius = FMath::Max(InExclusionRadius, 0.0f);
+	Cells.Empty();
+	HandleToCell.Empty();
+	SET_DWORD_STAT(STAT_CoverReservations, 0);
+}
+
+void FCoverReservationGrid::Reset()
+{
+	Init(0.0f);
+}
+
+bool FCoverReservationGrid::Reserve(const FCoverHandle& Handle, const FVector& Location, const uint32 HolderId)
+{
+	if (!IsEnabled())
+		return true;
+
+	// the holder's own reservations don't block it, e.g. a squad member holding the cover next to the one it's leaving
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_Write);
+	const bool bReservedByOthers = IsReservedLocked(Location, [HolderId](const uint32 ReservationHolderId)
+	{
+		return HolderId != 0 && ReservationHolderId == HolderId;
+	});
+	
+	if (HandleToCell.Contains(Handle.Id) || bReservedByOthers)
+	{
+		INC_DWORD_STAT(STAT_CoverReservationsRejected);
+		return false;
+	}
+
+	const FIntVector Cell = GetCell(Location);
+	Cells.FindOrAdd(Cell).Add({Location, Handle, HolderId});
+	HandleToCell.Add(Handle.Id, Cell);
+	INC_DWORD_STAT(STAT_CoverReservations);
+	return true;
+}
+
+bool FCoverReservationGrid::Release(const FCoverHandle& Handle)
+{
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_Write);
+	FIntVector Cell;
+	if (!HandleToCell.RemoveAndCopyValue(Handle.Id, Cell))
+		return false;
+
+	TArray<FReservation, TInlineAllocator<2>>& Reservations = Cells.FindChecked(Cell);
+	Reservations.RemoveAllSwap([&Handle](const FReservation& Reservation) { return Reservation.Handle == Handle; });
+	if (Reservations.Num() == 0)
+	{
+		Cells.Remove(Cell);
+	}
+
+	DEC_DWORD_STAT(STAT_CoverReservations);
+	return true;
+}
+
+bool FCoverReservationGrid::IsReserved(const FVector& Location, const uint32 IgnoredHolderId) const
+{
+	if (!IsEnabled())
+		return false;
+
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_ReadOnly);
+	return IsReservedLocked(Location, [IgnoredHolderId](const uint32 HolderId)
+	{
+		return IgnoredHolderId != 0 && HolderId == IgnoredHolderId;
+	});
+}
+
+bool FCoverReservationGrid::IsReserved(const FVector& Location, const TArray<uint32>& IgnoredHolderIds) const
+{
+	if (!IsEnabled())
+		return false;
+
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_ReadOnly);
+	return IsReservedLocked(Location, [&IgnoredHolderIds](const uint32 HolderId)
+	{
+		return HolderId != 0 && IgnoredHolderIds.Contains(HolderId);
+	});
+}
+
+int32 FCoverReservationGrid::GetNumReservations() const
+{
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_ReadOnly);
+	return HandleToCell.Num();
+}
+
+SIZE_T FCoverReservationGrid::GetAllocatedSize() const
+{
+	FRWScopeLock ScopeLock(Lock, FRWScopeLockType::SLT_ReadOnly);
+	SIZE_T Size = Cells.GetAllocatedSize() + HandleToCell.GetAllocatedSize();
+	for (const auto& Cell : Cells)
+	{
+		Size += Cell.Value.GetAllocatedSize();
+	}
+
+	return Size;
+}
+
+FIntVector FCoverReservationGrid::GetCell(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / ExclusionRadius), FMath::FloorToInt(Location.Y / ExclusionRadius), FMath::FloorToInt(Location.Z / ExclusionRadius));
+}
+
+template<typename PredicateType>
+bool FCoverReservationGrid::IsReservedLocked(const FVector& Location, const PredicateType& IsIgnoredHolder) const
+{
+	if (Cells.Num() == 0)
+		return false;
+
+	// the cells are as large as the exclusion radius, a reservation in range is at most one cell away
+	const FIntVector Cell = GetCell(Location);
+	const float ExclusionRadiusSq = FMath::Square(ExclusionRadius);
+	for (int32 Z = -1; Z <= 1; ++Z)
+	{
+		for (int32 Y = -1; Y <= 1; ++Y)
+		{
+			for (int32 X = -1; X <= 1; ++X)
+			{
+				const TArray<FReservation, TInlineAllocator<2>>* Reservations = Cells.Find(Cell + FIntVector(X, Y, Z));
+				if (!Reservations)
+					continue;
+
+				for (const FReservation& Reservation : *Reservations)
+				{
+					if (!IsIgnoredHolder(Reservation.HolderId) && FVector::DistSquared(Reservation.Location, Location) < ExclusionRadiusSq)
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
@@ -9,12 +9,19 @@
 // PROFILER INTEGRATION //
 DEFINE_STAT(STAT_GenerateCover);
 DEFINE_STAT(STAT_GenerateCoverInBounds);
+DEFINE_STAT(STAT_CoverCommitTiles);
 DEFINE_STAT(STAT_FindCover);
+DEFINE_STAT(STAT_CoverQueryProcess);
+DEFINE_STAT(STAT_CoverCrowdProcess);
 
 TEnumAsByte<enum ECollisionChannel> UCoverSystemStatics::CoverTraceChannel(ECollisionChannel::ECC_GameTraceChannel4);
 
 float UCoverSystemStatics::CoverPointGroundOffset(10.0f);
 float UCoverSystemStatics::SmallestAgentHeight(2 * 58.0f);
+float UCoverSystemStatics::StandingCoverHeight(88.0f + 64.0f);
+float UCoverSystemStatics::CrouchCoverHeight(58.0f + 32.0f);
+float UCoverSystemStatics::CoverProtectionDistance(100.0f);
+float UCoverSystemStatics::CoverLeanOffset(100.0f);
 
 FVector UCoverSystemStatics::GetPerpendicularVector(const FVector& Vector)
 {
@@ -0,0 +1,285 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoverThreatMap.h"
+
+#include "CoverRecastNavMesh.h"
+
+FCoverThreatMap::FCoverThreatMap()
+	: NavMesh(nullptr), Range(0.0f), UpdateDistance(0.0f), NextThreatId(0)
+{
+}
+
+void FCoverThreatMap::Init(ACoverRecastNavMesh* InNavMesh, const float InRange, const float InUpdateDistance)
+{
+	Reset();
+
+	NavMesh = InNavMesh;
+	Range = InRange;
+	UpdateDistance = InUpdateDistance;
+}
+
+void FCoverThreatMap::Reset()
+{
+	FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_Write);
+	NavMesh = nullptr;
+	Threats.Empty();
+	PolyExposedThreats.Empty();
+	CoverPointThreats.Empty();
+}
+
+int32 FCoverThreatMap::AddThreat(const FVector& Location)
+{
+	if (!IsEnabled())
+		return INDEX_NONE;
+
+	FThreat Threat;
+	Threat.Location = Location;
+	Threat.bDirty = false;
+	ComputeExposure(Threat);
+
+	FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_Write);
+	const int32 ThreatId = NextThreatId++;
+	AddExposure(Threat);
+	Threats.Add(ThreatId, MoveTemp(Threat));
+
+	return ThreatId;
+}
+
+void FCoverThreatMap::UpdateThreat(const int32 ThreatId, const FVector& Location)
+{
+	if (!IsEnabled())
+		return;
+
+	{
+		FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_Write);
+		FThreat* Threat = Threats.Find(ThreatId);
+		if (!Threat || (!Threat->bDirty && FVector::DistSquared(Threat->Location, Location) < FMath::Square(UpdateDistance)))
+			return;
+
+		// cleared before computing so an invalidation during the computation isn't lost
+		Threat->bDirty = false;
+	}
+
+	// the cover queries take the cover data lock, don't hold ours while computing
+	FThreat MovedThreat;
+	MovedThreat.Location = Location;
+	ComputeExposure(MovedThreat);
+
+	FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_Write);
+	FThreat* Threat = Threats.Find(ThreatId);
+	if (!Threat)
+		return;
+
+	RemoveExposure(*Threat);
+	AddExposure(MovedThreat);
+	Threat->Location = Location;
+	Threat->ExposedPolys = MoveTemp(MovedThreat.ExposedPolys);
+	Threat->CoverPointsInRange = MoveTemp(MovedThreat.CoverPointsInRange);
+	Threat->NumExposedCoverPoints = MovedThreat.NumExposedCoverPoints;
+}
+
+void FCoverThreatMap::RemoveThreat(const int32 ThreatId)
+{
+	FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_Write);
+	FThreat Threat;
+	if (Threats.RemoveAndCopyValue(ThreatId, Threat))
+	{
+		RemoveExposure(Threat);
+	}
+}
+
+int32 FCoverThreatMap::GetNumThreats() const
+{
+	FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_ReadOnly);
+	return Threats.Num();
+}
+
+float FCoverThreatMap::GetPolyExposure(const NavNodeRef PolyRef) const
+{
+	FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_ReadOnly);
+	const int32* NumExposedThreats = PolyExposedThreats.Find(PolyRef);
+	return NumExposedThreats ? static_cast<float>(*NumExposedThreats) / Threats.Num() : 0.0f;
+}
+
+float FCoverThreatMap::GetCoverPointExposure(const FCoverHandle& Handle) const
+{
+	FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_ReadOnly);
+	const FCoverPointThreats* PointThreats = CoverPointThreats.Find(Handle.Id);
+	return PointThreats ? static_cast<float>(PointThreats->NumExposed) / Threats.Num() : 0.0f;
+}
+
+bool FCoverThreatMap::GetCoverPointThreats(const FCoverHandle& Handle, FCoverPointThreats& OutThreats) const
+{
+	FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_ReadOnly);
+	const FCoverPointThreats* PointThreats = CoverPointThreats.Find(Handle.Id);
+	if (!PointThreats)
+		return false;
+
+	OutThreats = *PointThreats;
+	return true;
+}
+
+void FCoverThreatMap::InvalidateArea(const FBox& Area)
+{
+	FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_Write);
+	for (auto& Threat : Threats)
+	{
+		if (Area.ComputeSquaredDistanceToPoint(Threat.Value.Location) <= FMath::Square(Range))
+		{
+			Threat.Value.bDirty = true;
+		}
+	}
+}
+
+void FCoverThreatMap::UpdateDirtyThreats()
+{
+	if (!IsEnabled())
+		return;
+
+	TArray<TPair<int32, FVector>> DirtyThreats;
+	{
+		FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_ReadOnly);
+		for (const auto& Threat : Threats)
+		{
+			if (Threat.Value.bDirty)
+			{
+				DirtyThreats.Emplace(Threat.Key, Threat.Value.Location);
+			}
+		}
+	}
+
+	// a dirty threat is recomputed at its current location
+	for (const TPair<int32, FVector>& DirtyThreat : DirtyThreats)
+	{
+		UpdateThreat(DirtyThreat.Key, DirtyThreat.Value);
+	}
+}
+
+SIZE_T FCoverThreatMap::GetAllocatedSize() const
+{
+	FRWScopeLock ThreatsScopeLock(ThreatsLock, FRWScopeLockType::SLT_ReadOnly);
+	SIZE_T Size = Threats.GetAllocatedSize() + PolyExposedThreats.GetAllocatedSize() + CoverPointThreats.GetAllocatedSize();
+	for (const auto& Threat : Threats)
+	{
+		Size += Threat.Value.ExposedPolys.GetAllocatedSize() + Threat.Value.CoverPointsInRange.GetAllocatedSize();
+	}
+
+	return Size;
+}
+
+void FCoverThreatMap::ComputeExposure(FThreat& OutThreat) const
+{
+	const FVector& Location = OutThreat.Location;
+	OutThreat.ExposedPolys.Reset();
+	OutThreat.CoverPointsInRange.Reset();
+	OutThreat.NumExposedCoverPoints = 0;
+
+	TArray<FNavPoly> Polys;
+	if (!NavMesh->GetPolysInBox(FBox::BuildAABB(Location, FVector(Range)), Polys))
+		return;
+
+	TArray<NavNodeRef> PolyRefs;
+	for (const FNavPoly& Poly : Polys)
+	{
+		if (FVector::DistSquared(Poly.Center, Location) <= FMath::Square(Range))
+		{
+			PolyRefs.Add(Poly.Ref);
+		}
+	}
+
+	TArray<FCoverPointOctreeElement> CoverPoints;
+	NavMesh->FindCoverPointsOnPolys(PolyRefs, CoverPoints);
+
+	// falls back to the facing normal without protection masks
+	auto IsProtected = [](const FCoverPointMetadata& Metadata, const ECoverHeight Height, const FVector& ToThreat)
+	{
+		return Metadata.bHasProtectionMasks
+			? Metadata.GetProtection(Height, ToThreat) == ECoverProtection::Protected
+			: FVector::DotProduct(Metadata.FacingNormal, ToThreat.GetSafeNormal2D()) < -0.5f;
+	};
+
+	// a poly is protected if any of its cover points is at standing height, agents move through it standing
+	TSet<NavNodeRef> ProtectedPolys;
+	TArray<uint32> ProtectedCoverPoints;
+	for (const FCoverPointOctreeElement& CoverPoint : CoverPoints)
+	{
+		const FVector ToThreat = Location - CoverPoint.Data->Location;
+		const FCoverPointMetadata& Metadata = CoverPoint.Data->Metadata;
+		if (IsProtected(Metadata, ECoverHeight::Standing, ToThreat))
+		{
+			ProtectedPolys.Add(CoverPoint.Data->NodeRef);
+		}
+
+		if (ToThreat.SizeSquared() > FMath::Square(Range))
+			continue;
+
+		// the cover point protects the agent at its own cover height
+		if (IsProtected(Metadata, Metadata.Height, ToThreat))
+		{
+			ProtectedCoverPoints.Add(CoverPoint.Data->Handle.Id);
+		}
+		else
+		{
+			OutThreat.CoverPointsInRange.Add(CoverPoint.Data->Handle.Id);
+		}
+	}
+
+	OutThreat.NumExposedCoverPoints = OutThreat.CoverPointsInRange.Num();
+	OutThreat.CoverPointsInRange.Append(ProtectedCoverPoints);
+
+	for (const NavNodeRef PolyRef : PolyRefs)
+	{
+		if (!ProtectedPolys.Contains(PolyRef))
+		{
+			OutThreat.ExposedPolys.Add(PolyRef);
+		}
+	}
+}
+
+void FCoverThreatMap::AddExposure(const FThreat& Threat)
+{
+	for (const NavNodeRef PolyRef : Threat.ExposedPolys)
+	{
+		++PolyExposedThreats.FindOrAdd(PolyRef);
+	}
+
+	for (int32 Idx = 0; Idx < Threat.CoverPointsInRange.Num(); ++Idx)
+	{
+		FCoverPointThreats& PointThreats = CoverPointThreats.FindOrAdd(Threat.CoverPointsInRange[Idx]);
+		++PointThreats.NumInRange;
+		if (Idx < Threat.NumExposedCoverPoints)
+		{
+			++PointThreats.NumExposed;
+		}
+	}
+}
+
+void FCoverThreatMap::RemoveExposure(const FThreat& Threat)
+{
+	for (const NavNodeRef PolyRef : Threat.ExposedPolys)
+	{
+		int32* NumExposedThreats = PolyExposedThreats.Find(PolyRef);
+		if (NumExposedThreats && --(*NumExposedThreats) <= 0)
+		{
+			PolyExposedThreats.Remove(PolyRef);
+		}
+	}
+
+	for (int32 Idx = 0; Idx < Threat.CoverPointsInRange.Num(); ++Idx)
+	{
+		FCoverPointThreats* PointThreats = CoverPointThreats.Find(Threat.CoverPointsInRange[Idx]);
+		if (!PointThreats)
+			continue;
+
+		if (Idx < Threat.NumExposedCoverPoints)
+		{
+			--PointThreats->NumExposed;
+		}
+
+		if (--PointThreats->NumInRange <= 0)
+		{
+			CoverPointThreats.Remove(Threat.CoverPointsInRange[Idx]);
+		}
+	}
+}
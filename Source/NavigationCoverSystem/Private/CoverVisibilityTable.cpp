@@ -0,0 +1,341 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoverVisibilityTable.h"
+
+#include "Algo/BinarySearch.h"
+#include "CoverRecastNavMesh.h"
+#include "CoverSystemStatics.h"
+
+/**
+ * Traces the pending cover points of a FCoverVisibilityTable
+ */
+class FCoverVisibilityTableBuildTask : public FNonAbandonableTask
+{
+	friend class FAutoDeleteAsyncTask<FCoverVisibilityTableBuildTask>;
+
+	explicit FCoverVisibilityTableBuildTask(FCoverVisibilityTable* InTable)
+		: Table(InTable)
+	{
+	}
+
+	FCoverVisibilityTable* Table;
+
+	void DoWork() const
+	{
+		Table->BuildPendingCoverPoints();
+	}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FCoverVisibilityTableBuildTask, STATGROUP_ThreadPoolAsyncTasks);
+	}
+};
+
+void FCoverVisibilityRow::Set(const uint32 NeighbourId, const bool bStandingVisible, const bool bCrouchVisible)
+{
+	int32 Index = Algo::LowerBound(NeighbourIds, NeighbourId);
+	if (!NeighbourIds.IsValidIndex(Index) || NeighbourIds[Index] != NeighbourId)
+	{
+		NeighbourIds.Insert(NeighbourId, Index);
+
+		// shift the bits after the new neighbour up by two
+		VisibilityBits.Add(false);
+		VisibilityBits.Add(false);
+		for (int32 BitIndex = VisibilityBits.Num() - 1; BitIndex >= 2 * Index + 2; --BitIndex)
+		{
+			VisibilityBits[BitIndex] = VisibilityBits[BitIndex - 2];
+		}
+	}
+
+	VisibilityBits[2 * Index] = bStandingVisible;
+	VisibilityBits[2 * Index + 1] = bCrouchVisible;
+}
+
+void FCoverVisibilityRow::Remove(const uint32 NeighbourId)
+{
+	const int32 Index = Algo::BinarySearch(NeighbourIds, NeighbourId);
+	if (Index == INDEX_NONE)
+		return;
+
+	NeighbourIds.RemoveAt(Index);
+	VisibilityBits.RemoveAt(2 * Index, 2);
+}
+
+bool FCoverVisibilityRow::Contains(const uint32 NeighbourId) const
+{
+	return Algo::BinarySearch(NeighbourIds, NeighbourId) != INDEX_NONE;
+}
+
+ECoverVisibility FCoverVisibilityRow::Get(const uint32 NeighbourId, const ECoverHeight FromHeight) const
+{
+	const int32 Index = Algo::BinarySearch(NeighbourIds, NeighbourId);
+	if (Index == INDEX_NONE)
+		return ECoverVisibility::Unknown;
+
+	const int32 BitIndex = 2 * Index + (FromHeight == ECoverHeight::Standing ? 0 : 1);
+	return VisibilityBits[BitIndex] ? ECoverVisibility::Visible : ECoverVisibility::Hidden;
+}
+
+FCoverVisibilityTable::FCoverVisibilityTable()
+	: NavMesh(nullptr), Range(0.0f), StandingHeight(0.0f), CrouchHeight(0.0f), TraceChannel(ECC_Visibility), bBuildTaskRunning(false)
+{
+}
+
+FCoverVisibilityTable::~FCoverVisibilityTable()
+{
+	Reset();
+}
+
+void FCoverVisibilityTable::Init(ACoverRecastNavMesh* InNavMesh, const float InRange, const ECollisionChannel InTraceChannel)
+{
+	Reset();
+
+	NavMesh = InNavMesh;
+	Range = InRange;
+	StandingHeight = UCoverSystemStatics::StandingCoverHeight;
+	CrouchHeight = UCoverSystemStatics::CrouchCoverHeight;
+	TraceChannel = InTraceChannel;
+}
+
+void FCoverVisibilityTable::Reset()
+{
+	{
+		FScopeLock PendingScopeLock(&PendingLock);
+		PendingCoverPoints.Empty();
+		bCancelBuild = true;
+	}
+
+	// the build task stops after the cover point it's currently tracing
+	while (true)
+	{
+		{
+			FScopeLock PendingScopeLock(&PendingLock);
+			if (!bBuildTaskRunning)
+				break;
+		}
+
+		FPlatformProcess::Sleep(0.001f);
+	}
+
+	bCancelBuild = false;
+	NavMesh = nullptr;
+
+	FRWScopeLock RowsScopeLock(RowsLock, FRWScopeLockType::SLT_Write);
+	Rows.Empty();
+	LiveHandles.Empty();
+}
+
+void FCoverVisibilityTable::AddCoverPoints(const TArray<FCoverPointOctreeElement>& CoverPoints)
+{
+	if (!IsEnabled() || CoverPoints.Num() == 0)
+		return;
+
+	{
+		FRWScopeLock RowsScopeLock(RowsLock, FRWScopeLockType::SLT_Write);
+		for (const FCoverPointOctreeElement& CoverPoint : CoverPoints)
+		{
+			LiveHandles.Add(CoverPoint.Data->Handle);
+		}
+	}
+	
+	{
+		FScopeLock PendingScopeLock(&PendingLock);
+		PendingCoverPoints.Append(CoverPoints);
+	}
+
+	StartBuildTask();
+}
+
+void FCoverVisibilityTable::RemoveCoverPoints(const TArray<FCoverHandle>& Handles)
+{
+	if (!IsEnabled() || Handles.Num() == 0)
+		return;
+
+	FRWScopeLock RowsScopeLock(RowsLock, FRWScopeLockType::SLT_Write);
+	for (const FCoverHandle& Handle : Handles)
+	{
+		LiveHandles.Remove(Handle);
+		
+		FCoverVisibilityRow Row;
+		if (!Rows.RemoveAndCopyValue(Handle, Row))
+			continue;
+
+		// neighbours are symmetric, the removed row lists every row that has an entry for it
+		for (const uint32 NeighbourId : Row.NeighbourIds)
+		{
+			if (FCoverVisibilityRow* NeighbourRow = Rows.Find(FCoverHandle(NeighbourId)))
+			{
+				NeighbourRow->Remove(Handle.Id);
+			}
+		}
+	}
+}
+
+ECoverVisibility FCoverVisibilityTable::GetVisibility(const FCoverHandle& From, const FCoverHandle& To, const float FromHeight,
+	const float HeightTolerance, const ECollisionChannel InTraceChannel) const
+{
+	if (!IsEnabled() || InTraceChannel != TraceChannel || !From.IsValid() || !To.IsValid())
+		return ECoverVisibility::Unknown;
+
+	ECoverHeight Height;
+	if (FMath::Abs(FromHeight - StandingHeight) <= HeightTolerance)
+	{
+		Height = ECoverHeight::Standing;
+	}
+	else if (FMath::Abs(FromHeight - CrouchHeight) <= HeightTolerance)
+	{
+		Height = ECoverHeight::Crouch;
+	}
+	else
+	{
+		return ECoverVisibility::Unknown;
+	}
+
+	FRWScopeLock RowsScopeLock(RowsLock, FRWScopeLockType::SLT_ReadOnly);
+	const FCoverVisibilityRow* Row = Rows.Find(From);
+	return Row ? Row->Get(To.Id, Height) : ECoverVisibility::Unknown;
+}
+
+SIZE_T FCoverVisibilityTable::GetAllocatedSize() const
+{
+	FRWScopeLock RowsScopeLock(RowsLock, FRWScopeLockType::SLT_ReadOnly);
+	SIZE_T Size = Rows.GetAllocatedSize() + LiveHandles.GetAllocatedSize();
+	for (const auto& Row : Rows)
+	{
+		Size += Row.Value.NeighbourIds.GetAllocatedSize() + Row.Value.VisibilityBits.GetAllocatedSize();
+	}
+
+	return Size;
+}
+
+void FCoverVisibilityTable::StartBuildTask()
+{
+	{
+		FScopeLock PendingScopeLock(&PendingLock);
+		if (bBuildTaskRunning || PendingCoverPoints.Num() == 0)
+			return;
+
+		bBuildTaskRunning = true;
+	}
+
+	(new FAutoDeleteAsyncTask<FCoverVisibilityTableBuildTask>(this))->StartBackgroundTask();
+}
+
+void FCoverVisibilityTable::BuildPendingCoverPoints()
+{
+	while (true)
+	{
+		TArray<FCoverPointOctreeElement> CoverPoints;
+		{
+			FScopeLock PendingScopeLock(&PendingLock);
+			if (bCancelBuild || PendingCoverPoints.Num() == 0)
+			{
+				bBuildTaskRunning = false;
+				return;
+			}
+
+			Swap(CoverPoints, PendingCoverPoints);
+		}
+
+		for (const FCoverPointOctreeElement& CoverPoint : CoverPoints)
+		{
+			if (bCancelBuild)
+				break;
+
+			BuildCoverPoint(CoverPoint);
+		}
+	}
+}
+
+void FCoverVisibilityTable::BuildCoverPoint(const FCoverPointOctreeElement& CoverPoint)
+{
+	const FCoverHandle Handle = CoverPoint.Data->Handle;
+
+	TArray<FCoverPointOctreeElement> Neighbours;
+	NavMesh->FindCoverPoints(FSphere(CoverPoint.Data->Location, Range), Neighbours);
+
+	// neighbours that already have an entry were traced both ways when they were built
+	TArray<FCoverPointOctreeElement> NewNeighbours;
+	{
+		FRWScopeLock RowsScopeLock(RowsLock, FRWScopeLockType::SLT_ReadOnly);
+
+		// the cover point might have been removed since it was queued
+		if (!LiveHandles.Contains(Handle))
+			return;
+		
+		const FCoverVisibilityRow* ExistingRow = Rows.Find(Handle);
+		for (const FCoverPointOctreeElement& Neighbour : Neighbours)
+		{
+			if (Neighbour.Data->Handle != Handle && (!ExistingRow || !ExistingRow->Contains(Neighbour.Data->Handle.Id)))
+			{
+				NewNeighbours.Add(Neighbour);
+			}
+		}
+	}
+
+	if (NewNeighbours.Num() == 0)
+		return;
+
+	UWorld* World = NavMesh->GetWorld();
+	if (!World)
+		return;
+
+	FCollisionQueryParams CollisionQueryParams;
+	CollisionQueryParams.TraceTag = "CoverVisibilityTable_BuildCoverPoint";
+
+	// same shape as the line of sight sweeps in UEnvQueryTest_Cover
+	FCollisionShape SphereCollisionShape;
+	SphereCollisionShape.SetSphere(5.0f);
+
+	// cover point locations are offset from the ground
+	const float GroundOffset = UCoverSystemStatics::CoverPointGroundOffset;
+	auto IsVisibleLambda = [&](const FVector& From, const float FromHeight, const FVector& To) -> bool
+	{
+		FHitResult HitResult;
+		return !World->SweepSingleByChannel(HitResult, From + FVector(0.0f, 0.0f, FromHeight - GroundOffset),
+			To + FVector(0.0f, 0.0f, StandingHeight - GroundOffset), FQuat::Identity, TraceChannel, SphereCollisionShape, CollisionQueryParams);
+	};
+
+	struct FNeighbourVisibility
+	{
+		uint32 Id;
+		bool bStandingVisible;
+		bool bCrouchVisible;
+		bool bNeighbourStandingVisible;
+		bool bNeighbourCrouchVisible;
+	};
+
+	// trace outside of the lock
+	TArray<FNeighbourVisibility> Visibilities;
+	Visibilities.Reserve(NewNeighbours.Num());
+	const FVector& Location = CoverPoint.Data->Location;
+	for (const FCoverPointOctreeElement& Neighbour : NewNeighbours)
+	{
+		const FVector& NeighbourLocation = Neighbour.Data->Location;
+		Visibilities.Add({
+			Neighbour.Data->Handle.Id,
+			IsVisibleLambda(Location, StandingHeight, NeighbourLocation),
+			IsVisibleLambda(Location, CrouchHeight, NeighbourLocation),
+			IsVisibleLambda(NeighbourLocation, StandingHeight, Location),
+			IsVisibleLambda(NeighbourLocation, CrouchHeight, Location)
+		});
+	}
+
+	FRWScopeLock RowsScopeLock(RowsLock, FRWScopeLockType::SLT_Write);
+
+	// removed while we were tracing
+	if (bCancelBuild || !LiveHandles.Contains(Handle))
+		return;
+	
+	for (const FNeighbourVisibility& Visibility : Visibilities)
+	{
+		const FCoverHandle NeighbourHandle(Visibility.Id);
+		if (!LiveHandles.Contains(NeighbourHandle))
+			continue;
+		
+		// don't keep a reference to the rows, adding one might reallocate the map
+		Rows.FindOrAdd(Handle).Set(Visibility.Id, Visibility.bStandingVisible, Visibility.bCrouchVisible);
+		Rows.FindOrAdd(NeighbourHandle).Set(Handle.Id, Visibility.bNeighbourStandingVisible, Visibility.bNeighbourCrouchVisible);
+	}
+}
@@ -5,7 +5,6 @@
 #include "CoverSystemStatics.h"
 #include "DrawDebugHelpers.h"
 #include "CoverRecastNavMesh.h"
-#include "Detour/DetourNavMesh.h"
 
 #if DEBUG_RENDERING
 static TAutoConsoleVariable<bool> CVarDrawCoverTrace(
@@ -39,16 +38,22 @@ static TAutoConsoleVariable<bool> CVarDrawCoverPoints(
 
 FNavmeshCoverPointGeneratorAsyncTask::FNavmeshCoverPointGeneratorAsyncTask()
 	: CoverPointMinDistance(0.0f), ScanReach(100.0f), CliffEdgeDistance(70.0f), StraightCliffErrorTolerance(100.0f),
-	  NavmeshHoleCheckReach(5.0f), SmallestAgentHeight(00.0f), CoverPointGroundOffset(0.0f), NavMeshMaxZDistanceFromGround(0.0f),
-	  NavmeshTileIndex(0), NavRef(nullptr)
+	  NavmeshHoleCheckReach(5.0f), SmallestAgentHeight(00.0f), StandingCoverHeight(0.0f), CrouchCoverHeight(0.0f), CoverLeanOffset(0.0f),
+	  bGenerateProtectionMasks(false), CoverProtectionDistance(0.0f), HeightTraceDistance(0.0f), CoverPointGroundOffset(0.0f), NavMeshMaxZDistanceFromGround(0.0f),
+	  NavmeshTileIndex(0), Generation(0), NavRef(nullptr)
 {
 }
 
 FNavmeshCoverPointGeneratorAsyncTask::FNavmeshCoverPointGeneratorAsyncTask(const float InCoverPointMinDistance, const float InSmallestAgentHeight,
-	const float InCoverPointGroundOffset, const FBox InMapBounds, const int32 InNavmeshTileIndex, ACoverRecastNavMesh* InNav)
+	const float InCoverPointGroundOffset, const FBox InMapBounds, const TSharedRef<const FCoverNavMeshTileSnapshot, ESPMode::ThreadSafe>& InSnapshot,
+	const TArray<FBox>& InDirtyAreas, const uint32 InGeneration, ACoverRecastNavMesh* InNav)
 	: CoverPointMinDistance(InCoverPointMinDistance), ScanReach(100.0f), CliffEdgeDistance(70.0f), StraightCliffErrorTolerance(100.0f),
-	  NavmeshHoleCheckReach(5.0f), SmallestAgentHeight(InSmallestAgentHeight), CoverPointGroundOffset(InCoverPointGroundOffset),
-	  NavMeshMaxZDistanceFromGround(InCoverPointGroundOffset * 3.0f), MapBounds(InMapBounds), NavmeshTileIndex(InNavmeshTileIndex), NavRef(InNav)
+	  NavmeshHoleCheckReach(5.0f), SmallestAgentHeight(InSmallestAgentHeight), StandingCoverHeight(UCoverSystemStatics::StandingCoverHeight),
+	  CrouchCoverHeight(UCoverSystemStatics::CrouchCoverHeight), CoverLeanOffset(UCoverSystemStatics::CoverLeanOffset),
+	  bGenerateProtectionMasks(InNav && InNav->bGenerateCoverProtectionMasks), CoverProtectionDistance(UCoverSystemStatics::CoverProtectionDistance),
+	  HeightTraceDistance(UCoverSystemStatics::CoverProtectionDistance * 1.5f), CoverPointGroundOffset(InCoverPointGroundOffset),
+	  NavMeshMaxZDistanceFromGround(InCoverPointGroundOffset * 3.0f), MapBounds(InMapBounds), NavmeshTileIndex(InSnapshot->TileIndex),
+	  Snapshot(InSnapshot), DirtyAreas(InDirtyAreas), Generation(InGeneration), NavRef(InNav)
 {
 #if DEBUG_RENDERING
 	static const auto CVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.DrawCoverPointGenerator")); 
@@ -61,6 +66,45 @@ FVector FNavmeshCoverPointGeneratorAsyncTask::GetEdgeDir(const FVector& EdgeStar
 	return FVector();
 }
 
+bool FNavmeshCoverPointGeneratorAsyncTask::IsEdgeDirty(const FVector& EdgeStartVertex, const FVector& EdgeEndVertex) const
+{
+	if (DirtyAreas.Num() == 0)
+		return true;
+
+	const FVector Edge = EdgeEndVertex - EdgeStartVertex;
+	for (const FBox& DirtyArea : DirtyAreas)
+	{
+		if (DirtyArea.IsInsideOrOn(EdgeStartVertex) || DirtyArea.IsInsideOrOn(EdgeEndVertex)
+			|| FMath::LineBoxIntersection(DirtyArea, EdgeStartVertex, EdgeEndVertex, Edge))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void FNavmeshCoverPointGeneratorAsyncTask::GetKeptCoverPointNodeRefs(const FBox& NavMeshTileArea, TArray<TPair<FVector, NavNodeRef>>& OutNodeRefs) const
+{
+	TArray<FCoverPointOctreeElement> TileCoverPoints;
+	NavRef->FindCoverPoints(NavMeshTileArea, TileCoverPoints);
+
+	const FVector ProjectExtent(CoverPointGroundOffset, CoverPointGroundOffset, NavMeshMaxZDistanceFromGround);
+	for (const FCoverPointOctreeElement& CoverPoint : TileCoverPoints)
+	{
+		const FVector& Location = CoverPoint.Data->Location;
+		if (CoverPoint.Data->TileIndex != NavmeshTileIndex || DirtyAreas.ContainsByPredicate([&Location](const FBox& DirtyArea) { return DirtyArea.IsInsideOrOn(Location); }))
+			continue;
+
+		// keep the old ref if the projection fails, it will be fixed on the next full regeneration of the tile
+		FNavLocation NavLocation;
+		if (Snapshot->ProjectPoint(Location, ProjectExtent, NavLocation) && NavLocation.NodeRef != CoverPoint.Data->NodeRef)
+		{
+			OutNodeRefs.Emplace(Location, NavLocation.NodeRef);
+		}
+	}
+}
+
 bool FNavmeshCoverPointGeneratorAsyncTask::ScanForCoverNavMeshProjection(FDataTransferObjectCoverData& OutCoverData,
 	const NavNodeRef& NodeRef, const FVector& TraceStart, const FVector& TraceDirection) const
 {
@@ -68,13 +112,11 @@ bool FNavmeshCoverPointGeneratorAsyncTask::ScanForCoverNavMeshProjection(FDataTr
 	const FVector TraceEndPhysX = TraceStart + (TraceDirection * ScanReach); // the physx ray cast is longer so that it may reach slanted geometry, e.g. ramps
 	const FVector SmallestAgentHeightOffset = FVector(0.0f, 0.0f, SmallestAgentHeight);
 
-	FNavLocation Test;
-	NavRef->ProjectPoint(TraceEndNavMesh, Test, FVector(80.0f));
-	
 	// project the point onto the navmesh: if the projection is successful then it's not a navmesh hole, so we return failure
-	// if (UNavigationSystemV1::GetCurrent(World)->ProjectPointToNavigation(traceEndNavMesh, navLocation, FVector(0.1f, 0.1f, 0.1f)))
+	// only the tile's polys are in the snapshot. The probes rotated at the edge ends can land on a neighbouring tile,
+	// which can't be checked without reading the live navmesh, so they aren't treated as a hole
 	FNavLocation NavLocation;
-	if (NavRef->ProjectPoint(TraceEndNavMesh, NavLocation, FVector(0.1f)))
+	if (!Snapshot->Bounds.IsInsideXY(TraceEndNavMesh) || Snapshot->ProjectPoint(TraceEndNavMesh, FVector(0.1f), NavLocation))
 		return false;
 	
 	// to get the cover object within the hole in the navmesh we still need to do a raycast towards its general direction, at a height of SmallestAgentHeight to ensure that the cover is tall enough
@@ -97,8 +139,11 @@ bool FNavmeshCoverPointGeneratorAsyncTask::ScanForCoverNavMeshProjection(FDataTr
 #endif
 	
 	//TODO: comment out if not needed - ledge detection logic
+	bool bCliffEdge = false;
 	if (!bSuccess)
 	{
+		bCliffEdge = true;
+		
 		// if we didn't hit an object with the XY-parallel ray then cast another one towards the ground from an extended location, down along the Z-axis
 		// this ensures that we pick up the edges of cliffs, which are valid cover points against units below, while also discarding flat planes that tend to creep up along navmesh tile boundaries
 		// if this ray doesn't hit anything then we've found a cliff's edge
@@ -141,10 +186,111 @@ bool FNavmeshCoverPointGeneratorAsyncTask::ScanForCoverNavMeshProjection(FDataTr
 	/*if (ECC_GameTraceChannel2 == HitResult.Actor->GetRootComponent()->GetCollisionObjectType())
 		return false;*/
 	
-	OutCoverData = FDataTransferObjectCoverData(HitResult.Actor.Get(), TraceStart, false, NavmeshTileIndex, NodeRef);
+	// cliff edges face away from the drop, the ground we hit doesn't have a meaningful normal
+	FVector FacingNormal = bCliffEdge ? FVector::ZeroVector : HitResult.ImpactNormal.GetSafeNormal2D();
+	if (FacingNormal.IsNearlyZero())
+	{
+		FacingNormal = TraceDirection.GetSafeNormal2D() * -1.0f;
+	}
+	
+	FCoverPointMetadata Metadata = GenerateCoverMetadata(TraceStart, FacingNormal, bCliffEdge);
+	if (bGenerateProtectionMasks)
+	{
+		GenerateProtectionMasks(Metadata, TraceStart, HitResult.Actor.Get());
+	}
+	
+	OutCoverData = FDataTransferObjectCoverData(HitResult.Actor.Get(), TraceStart, false, NavmeshTileIndex, NodeRef, Metadata);
 	return true;
 }
 
+FCoverPointMetadata FNavmeshCoverPointGeneratorAsyncTask::GenerateCoverMetadata(const FVector& CoverLocation, const FVector& FacingNormal, const bool bCliffEdge) const
+{
+	// the cover test checks these before relying on the metadata
+	FCoverPointMetadata Metadata(FacingNormal, ECoverHeight::Crouch, false, false);
+	Metadata.TraceChannel = COVER_TRACE_CHANNEL;
+	Metadata.HeightTraceDistance = HeightTraceDistance;
+	Metadata.LeanOffset = CoverLeanOffset;
+
+	// a cliff edge only protects against units below, same as crouching behind low cover
+	if (bCliffEdge)
+		return Metadata;
+
+	FCollisionQueryParams CollisionQueryParams;
+	CollisionQueryParams.TraceTag = "CoverGenerator_GenerateCoverMetadata";
+
+	UWorld* World = NavRef->GetWorld();
+
+	// check if the cover reaches the standing height, CoverLocation is already offset from the ground
+	FHitResult HitResult;
+	const FVector StandingLocation = CoverLocation + FVector(0.0f, 0.0f, StandingCoverHeight - CoverPointGroundOffset);
+	if (!World->LineTraceSingleByChannel(HitResult, StandingLocation, StandingLocation - FacingNormal * HeightTraceDistance, COVER_TRACE_CHANNEL, CollisionQueryParams))
+		return Metadata;
+
+	FCollisionShape SphereCollisionShape;
+	SphereCollisionShape.SetSphere(5.0f);
+
+	// same as the penetration check in UEnvQueryTest_Cover::CheckHitByLeaning, move back from the lean location and make sure we're not inside something
+	auto CanLeanLambda = [&](const FVector& LeanLocation) -> bool
+	{
+		FHitResult LeanHitResult;
+		return !World->SweepSingleByChannel(LeanHitResult, LeanLocation + FacingNormal * 10.0f, LeanLocation, FQuat::Identity, COVER_TRACE_CHANNEL,
+			SphereCollisionShape, CollisionQueryParams);
+	};
+
+	// the perpendicular vector is on the left when looking at the cover object, i.e. along -FacingNormal
+	const FVector LeanOffset = UCoverSystemStatics::GetPerpendicularVector(FacingNormal) * CoverLeanOffset;
+	Metadata.Height = ECoverHeight::Standing;
+	Metadata.bCanLeanLeft = CanLeanLambda(StandingLocation + LeanOffset);
+	Metadata.bCanLeanRight = CanLeanLambda(StandingLocation - LeanOffset);
+	return Metadata;
+}
+
+void FNavmeshCoverPointGeneratorAsyncTask::GenerateProtectionMasks(FCoverPointMetadata& Metadata, const FVector& CoverLocation, const AActor* CoverObject) const
+{
+	FCollisionQueryParams CollisionQueryParams;
+	CollisionQueryParams.TraceTag = "CoverGenerator_GenerateProtectionMasks";
+
+	FCollisionShape SphereCollisionShape;
+	SphereCollisionShape.SetSphere(5.0f);
+	
+	UWorld* World = NavRef->GetWorld();
+
+	// same sweep as the first one in UEnvQueryTest_Cover::EvaluateCoverPoint, once per sector instead of once per target
+	auto GenerateMaskLambda = [&](const ECoverHeight Height, const float TestHeight)
+	{
+		const int32 HeightIndex = static_cast<int32>(Height);
+		const FVector TestLocation = CoverLocation + FVector(0.0f, 0.0f, TestHeight - CoverPointGroundOffset);
+		
+		for (int32 Sector = 0; Sector < FCoverPointMetadata::NumProtectionSectors; ++Sector)
+		{
+			const FVector TestEndLocation = TestLocation + FCoverPointMetadata::GetSectorDirection(Sector) * CoverProtectionDistance * 1.5f;
+			
+			FHitResult HitResult;
+			if (!World->SweepSingleByChannel(HitResult, TestLocation, TestEndLocation, FQuat::Identity, COVER_TRACE_CHANNEL, SphereCollisionShape, CollisionQueryParams))
+				continue;
+
+			if (HitResult.GetActor() == CoverObject && HitResult.Distance <= CoverProtectionDistance)
+			{
+				Metadata.ProtectionMask[HeightIndex] |= 1u << Sector;
+			}
+			else
+			{
+				Metadata.BlockedMask[HeightIndex] |= 1u << Sector;
+			}
+		}
+	};
+
+	GenerateMaskLambda(ECoverHeight::Crouch, CrouchCoverHeight);
+
+	// the cover doesn't reach the standing height, leave the standing masks open
+	if (Metadata.Height == ECoverHeight::Standing)
+	{
+		GenerateMaskLambda(ECoverHeight::Standing, StandingCoverHeight);
+	}
+	
+	Metadata.bHasProtectionMasks = true;
+}
+
 void FNavmeshCoverPointGeneratorAsyncTask::ProcessEdgeStep(TArray<FDataTransferObjectCoverData>& OutCoverPointsOfActors,
 	const NavNodeRef& NodeRef, const FVector& EdgeStepVertex, const FVector& EdgeDir) const
 {
@@ -189,17 +335,12 @@ FBox FNavmeshCoverPointGeneratorAsyncTask::GenerateCoverInBounds(TArray<FDataTra
 	INC_DWORD_STAT(STAT_GenerateCoverHistoricalCount);
 	SCOPE_SECONDS_ACCUMULATOR(STAT_GenerateCoverAverageTime);
 
-	NavRef->BeginBatchQuery();
-	TArray<FNavPoly> Polys;
-	NavRef->GetPolysInTile(NavmeshTileIndex, Polys);
-	NavRef->FinishBatchQuery();
-	
-	for (const auto& Poly : Polys)
+	// no navmesh lock, the snapshot doesn't change while the tile is rebuilt again
+	for (int32 PolyIdx = 0; PolyIdx < Snapshot->Polys.Num(); ++PolyIdx)
 	{
-		NavRef->BeginBatchQuery();
+		const FCoverNavMeshTileSnapshot::FPoly& Poly = Snapshot->Polys[PolyIdx];
 		TArray<FVector> Vertices;
-		NavRef->GetPolyEdges(Poly.Ref, Vertices);
-		NavRef->FinishBatchQuery();
+		Snapshot->GetPolyEdges(PolyIdx, Vertices);
 
 		// process the navmesh vertices (called nav mesh edges for some occult reason)
 		const int nVertices = Vertices.Num();
@@ -212,6 +353,11 @@ FBox FNavmeshCoverPointGeneratorAsyncTask::GenerateCoverInBounds(TArray<FDataTra
 			{
 				const FVector EdgeStartVertex = Vertices[iVertex];
 				const FVector EdgeEndVertex = Vertices[iVertex + 1];
+
+				// partial regeneration, the edges outside of the dirty areas keep their cover points
+				if (!IsEdgeDirty(EdgeStartVertex, EdgeEndVertex))
+					continue;
+				
 				const FVector Edge = EdgeEndVertex - EdgeStartVertex;
 				const FVector EdgeDir = Edge.GetUnsafeNormal();
 
@@ -248,14 +394,7 @@ FBox FNavmeshCoverPointGeneratorAsyncTask::GenerateCoverInBounds(TArray<FDataTra
 	
 
 	// return the AABB of the navmesh tile that's been processed, expanded by minimum tile height on the Z-axis
-	FBox NavMeshBounds = NavRef->GetNavMeshTileBounds(NavmeshTileIndex);
-	const float NavMeshTileHeight = NavRef->GetRecastMesh()->getParams()->tileHeight;
-	if (NavMeshTileHeight > 0)
-	{
-		NavMeshBounds = NavMeshBounds.ExpandBy(FVector(0.0f, 0.0f, NavMeshTileHeight * 0.5f));
-	}
-
-	return NavMeshBounds;
+	return Snapshot->Bounds;
 }
 
 void FNavmeshCoverPointGeneratorAsyncTask::DoWork() const
@@ -267,32 +406,35 @@ void FNavmeshCoverPointGeneratorAsyncTask::DoWork() const
 	INC_DWORD_STAT(STAT_TaskCount);
 
 	// generate cover points
-	TArray<FDataTransferObjectCoverData> CoverPoints;
-	const FBox NavMeshTileArea = GenerateCoverInBounds(CoverPoints);
+	FCoverTileCommit Commit;
+	Commit.Area = GenerateCoverInBounds(Commit.CoverPoints);
+	Commit.TileIndex = NavmeshTileIndex;
+	Commit.DirtyAreas = DirtyAreas;
+	Commit.Generation = Generation;
 
-	// remove any cover points that don't fall on the navmesh anymore
-	// happens when a newly placed cover object is placed on top of previously generated cover points
 	if (!IsValid(NavRef))
 		return;
 	
-	//TODO: consider deleting this - a few more cover points might be left over upon object removal but at the expense of fewer cover points per object. most apparent near ledges. not a big deal either way, though.
-	NavRef->RemoveStaleCoverPoints(NavMeshTileArea, NavmeshTileIndex);
-	 
-	// add the generated cover points to the octree in a single batch
-	if (!IsValid(NavRef))
-		return;
-		
-	NavRef->AddCoverPoints(CoverPoints);
+	// the rebuilt tile has new poly refs, including the polys of the cover points we're keeping
+	if (DirtyAreas.Num() > 0)
+	{
+		GetKeptCoverPointNodeRefs(Commit.Area, Commit.KeptNodeRefs);
+	}
 
 #if DEBUG_RENDERING
 	if (CVarDrawCoverPoints.GetValueOnAnyThread())
 	{
-		for (FDataTransferObjectCoverData CoverPoint : CoverPoints)
+		for (FDataTransferObjectCoverData CoverPoint : Commit.CoverPoints)
 		{
 			DrawDebugSphere(NavRef->GetWorld(), CoverPoint.Location, 20.0f, 4, FColor::Purple, true, -1.0f, 0, 3.0f);
 		}			
 	}
 #endif
+	
+	// the game thread removes the cover points that don't fall on the navmesh anymore and adds the generated ones in a single batch,
+	// along with the other finished tiles
+	//TODO: consider deleting the stale cover removal - a few more cover points might be left over upon object removal but at the expense of fewer cover points per object. most apparent near ledges. not a big deal either way, though.
+	NavRef->EnqueueTileCommit(MoveTemp(Commit));
 
 	DEC_DWORD_STAT(STAT_TaskCount);
 }
@@ -7,6 +7,15 @@
 #include "EnvironmentQuery/EnvQueryGenerator.h"
 #include "EnvQueryGenerator_CoverPoints.generated.h"
 
+/** Order of the generated cover points, applied before MaxItems */
+UENUM()
+enum class ECoverPointSortMode : uint8
+{
+	None,			//octree order, the traversal stops as soon as MaxItems cover points are found
+	Distance,		//nearest to the search centers first, the search radius grows until MaxItems cover points are found
+	CoverHeight		//standing cover first, then by distance
+};
+
 /**
  * 
  */
@@ -26,10 +35,24 @@ public:
 	/** context */
 	UPROPERTY(EditAnywhere, Category="Generator")
 	TSubclassOf<UEnvQueryContext> SearchCenter;
+
+	/** Max number of cover points generated, 0 or less for no limit. Cover points found from several search centers are only generated once. */
+	UPROPERTY(EditDefaultsOnly, Category="Generator")
+	FAIDataProviderIntValue MaxItems;
+
+	UPROPERTY(EditDefaultsOnly, Category="Generator")
+	ECoverPointSortMode SortMode;
+
+	/**
+	 * Skip the cover points in the areas reserved around the cover held by other agents (ACoverRecastNavMesh::CoverReservationRadius),
+	 * the querier's own cover is kept. O(1) per cover point, so the reserved areas never reach the tests.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Generator")
+	bool bExcludeReservedCover;
 	
 	virtual void GenerateItems(FEnvQueryInstance& QueryInstance) const override;
 
-	virtual void ProcessItems(FEnvQueryInstance& QueryInstance, TArray<FVector>& FoundCover) const {}
+	virtual void ProcessItems(FEnvQueryInstance& QueryInstance, TArray<struct FCoverPointOctreeElement>& FoundCover) const {}
 
 	virtual FText GetDescriptionTitle() const override;
 	virtual FText GetDescriptionDetails() const override;
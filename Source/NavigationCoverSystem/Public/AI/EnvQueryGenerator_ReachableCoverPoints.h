@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DataProviders/AIDataProvider.h"
+#include "EnvironmentQuery/EnvQueryGenerator.h"
+#include "NavFilters/NavigationQueryFilter.h"
+#include "EnvQueryGenerator_ReachableCoverPoints.generated.h"
+
+/**
+ * Floods the navmesh from the search centers up to MaxPathCost and generates the cover points on the reached polys,
+ * cheapest first. Each item carries its path cost with the area costs of FilterClass, use UEnvQueryTest_CoverPathCost instead of a pathfinding test.
+ */
+UCLASS(meta = (DisplayName = "Reachable Cover Points"))
+class NAVIGATIONCOVERSYSTEM_API UEnvQueryGenerator_ReachableCoverPoints : public UEnvQueryGenerator
+{
+	GENERATED_BODY()
+public:
+	UEnvQueryGenerator_ReachableCoverPoints();
+
+	/** Max navmesh path cost between the search center and a cover point, distance scaled by the area costs of FilterClass */
+	UPROPERTY(EditDefaultsOnly, Category="Generator")
+	FAIDataProviderFloatValue MaxPathCost;
+
+	/** Filter the path costs and the traversable areas come from, the nav mesh's default filter if not set. Same as a pathfinding test's FilterClass */
+	UPROPERTY(EditDefaultsOnly, Category="Generator")
+	TSubclassOf<UNavigationQueryFilter> FilterClass;
+
+	/** context */
+	UPROPERTY(EditAnywhere, Category="Generator")
+	TSubclassOf<UEnvQueryContext> SearchCenter;
+
+	/** Max number of cover points generated, the cheapest are kept, 0 or less for no limit */
+	UPROPERTY(EditDefaultsOnly, Category="Generator")
+	FAIDataProviderIntValue MaxItems;
+
+	/**
+	 * Skip the cover points in the areas reserved around the cover held by other agents (ACoverRecastNavMesh::CoverReservationRadius),
+	 * the querier's own cover is kept. O(1) per cover point, so the reserved areas never reach the tests.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Generator")
+	bool bExcludeReservedCover;
+
+	virtual void GenerateItems(FEnvQueryInstance& QueryInstance) const override;
+
+	virtual FText GetDescriptionTitle() const override;
+	virtual FText GetDescriptionDetails() const override;
+};
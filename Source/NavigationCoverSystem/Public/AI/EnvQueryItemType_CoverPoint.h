@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CoverOctree.h"
+#include "EnvironmentQuery/Items/EnvQueryItemType_VectorBase.h"
+#include "EnvQueryItemType_CoverPoint.generated.h"
+
+/**
+ * Copy of a cover point stored in the raw memory of an EQS item, so tests don't need to look the cover point up again.
+ * Must stay trivially copyable, EQS moves the items around with memcpy and never calls their destructor.
+ */
+struct FEnvQueryCoverPointItem
+{
+public:
+	FVector Location;
+
+	FCoverHandle Handle;
+
+	TileIndexType TileIndex;
+
+	NavNodeRef NodeRef;
+
+	TWeakObjectPtr<AActor> CoverObject;
+
+	bool bForceField;
+
+	FCoverPointMetadata Metadata;
+
+	// Navmesh path cost from the search center, negative if the generator didn't compute it
+	float PathCost;
+
+	FEnvQueryCoverPointItem()
+		: Location(FVector::ZeroVector), Handle(), TileIndex(-1), NodeRef(INVALID_NAVNODEREF), CoverObject(), bForceField(false), Metadata(), PathCost(-1.0f)
+	{
+	}
+
+	explicit FEnvQueryCoverPointItem(const FCoverPointOctreeElement& Element, const float InPathCost = -1.0f)
+		: Location(Element.Data->Location), Handle(Element.Data->Handle), TileIndex(Element.Data->TileIndex), NodeRef(Element.Data->NodeRef),
+		  CoverObject(Element.Data->CoverObject), bForceField(Element.Data->bForceField), Metadata(Element.Data->Metadata), PathCost(InPathCost)
+	{
+	}
+};
+
+/**
+ * Cover point item, the cover handle and metadata travel with the location from the generator to the tests.
+ * Stock tests see it as a vector item.
+ */
+UCLASS()
+class NAVIGATIONCOVERSYSTEM_API UEnvQueryItemType_CoverPoint : public UEnvQueryItemType_VectorBase
+{
+	GENERATED_BODY()
+
+public:
+	typedef FEnvQueryCoverPointItem FValueType;
+
+	UEnvQueryItemType_CoverPoint();
+
+	static const FEnvQueryCoverPointItem& GetValue(const uint8* RawData);
+	static void SetValue(uint8* RawData, const FEnvQueryCoverPointItem& Value);
+	static void SetValue(uint8* RawData, const FCoverPointOctreeElement& Value);
+
+	virtual FVector GetItemLocation(const uint8* RawData) const override;
+};
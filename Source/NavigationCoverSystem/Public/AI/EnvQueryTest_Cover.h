@@ -3,9 +3,17 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "CoverOctree.h"
 #include "EnvironmentQuery/EnvQueryTest.h"
 #include "EnvQueryTest_Cover.generated.h"
 
+enum class ECoverProtection : uint8;
+class FCoverVisibilityTable;
+class FCoverQueryResultCache;
+struct FCoverQueryCacheInsert;
+struct FCoverQueryCacheKey;
+struct FCoverAsyncEvaluation;
+
 UENUM()
 enum class ECoverQueryResult : uint8
 {
@@ -15,6 +23,209 @@ enum class ECoverQueryResult : uint8
 	Found			= 3		//cover found
 };
 
+/**
+ * How UEnvQueryTest_Cover::bAsyncSweeps gets a sweep the evaluation asks for that has no result yet
+ */
+enum class ECoverAsyncAdvance : uint8
+{
+	Collect,	//only use the results received so far
+	Submit,		//submit it through the async trace API
+	Block		//finish it with a blocking sweep
+};
+
+/**
+ * How the scores of a cover point against each target are combined into the item score.
+ * Failing a primary target always discards the cover point.
+ */
+UENUM()
+enum class ECoverScoreAggregation : uint8
+{
+	Min,		//worst target, the remaining targets are skipped as soon as one fails
+	Mean,		//average of the targets
+	Weighted	//average of the targets, primary targets count PrimaryTargetWeight times
+};
+
+/**
+ * Targets of a running query, captured on the first time slice of the test so that the later slices score against the same targets
+ */
+struct FCoverTestQueryTargets
+{
+public:
+	TArray<TWeakObjectPtr<AActor>> Actors;
+
+	// Eye view points of the actors when the test started
+	TArray<FVector> EyeLocations;
+
+	// Nearest cover points of the actors for the visibility table, invalid if none or the table isn't used
+	TArray<FCoverHandle> CoverPoints;
+
+	// Primary targets come first
+	TBitArray<> PrimaryTargets;
+	int32 NumPrimaryTargets;
+
+	double StartTime;
+
+	// Owner of the query, the entry is dropped once it's gone
+	TWeakObjectPtr<UObject> Owner;
+
+	// Sweeps in flight and results of the query when UEnvQueryTest_Cover::bAsyncSweeps is used
+	TSharedPtr<FCoverAsyncEvaluation, ESPMode::ThreadSafe> AsyncEvaluation;
+
+	FCoverTestQueryTargets()
+		: NumPrimaryTargets(0), StartTime(0.0)
+	{
+	}
+};
+
+/**
+ * Runs the sweeps of a cover evaluation, blocking until they are done.
+ * Overridden to replay an evaluation with the results of async sweeps.
+ */
+class NAVIGATIONCOVERSYSTEM_API FCoverSweepProvider
+{
+public:
+	explicit FCoverSweepProvider(UWorld* InWorld)
+		: World(InWorld)
+	{
+	}
+
+	virtual ~FCoverSweepProvider() {}
+
+	/**
+	 * @brief sweep a sphere from Start to End, same as UWorld::SweepSingleByChannel
+	 * @return true if there was a blocking hit
+	 */
+	virtual bool Sweep(FHitResult& OutHit, const FVector& Start, const FVector& End, ECollisionChannel TraceChannel,
+	                   const FCollisionShape& CollisionShape, const FCollisionQueryParams& Params);
+
+	/**
+	 * @brief true if a sweep result isn't available yet, the result of the evaluation must then be discarded
+	 */
+	virtual bool IsPending() const { return false; }
+
+	UWorld* GetWorld() const { return World; }
+
+protected:
+	UWorld* World;
+};
+
+/**
+ * Settings of the querier shared by every cover point and target evaluated in a query
+ */
+struct FCoverEvaluationParams
+{
+public:
+	UWorld* World;
+
+	float StandingEyeHeight;
+
+	// Only used if bTestCrouchHeight
+	float CrouchingEyeHeight;
+	bool bTestCrouchHeight;
+
+	// Optional, see UEnvQueryTest_Cover::bUseVisibilityTable
+	const FCoverVisibilityTable* VisibilityTable;
+
+	// Optional, see UEnvQueryTest_Cover::bUseResultCache
+	FCoverQueryResultCache* ResultCache;
+	uint32 SettingsHash;
+
+	FCoverEvaluationParams()
+		: World(nullptr), StandingEyeHeight(0.0f), CrouchingEyeHeight(0.0f), bTestCrouchHeight(false), VisibilityTable(nullptr), ResultCache(nullptr), SettingsHash(0)
+	{
+	}
+};
+
+/**
+ * Scores of the cover points evaluated in the current frame against the same targets from the same querier settings,
+ * so that the queries of a squad taking cover from the same enemies evaluate each cover point once
+ */
+struct FCoverSquadEvaluation
+{
+public:
+	TArray<TWeakObjectPtr<AActor>> Actors;
+	TArray<FVector> EyeLocations;
+	TBitArray<> PrimaryTargets;
+
+	float StandingEyeHeight;
+
+	// -1 if the queriers can't crouch
+	float CrouchingEyeHeight;
+
+	float CoverOutOffset;
+
+	// Aggregated score by cover handle id
+	TMap<uint32, float> Scores;
+
+	FCoverSquadEvaluation()
+		: StandingEyeHeight(0.0f), CrouchingEyeHeight(-1.0f), CoverOutOffset(0.0f)
+	{
+	}
+
+	bool Matches(const FCoverTestQueryTargets& Targets, const FCoverEvaluationParams& Params, float InCoverOutOffset) const;
+};
+
+/**
+ * Combines the scores of a cover point against each target into the item score, see ECoverScoreAggregation.
+ * Expects the primary targets first.
+ */
+struct FCoverScoreAggregator
+{
+	FCoverScoreAggregator(const ECoverScoreAggregation InPolicy, const float InPrimaryTargetWeight)
+		: Policy(InPolicy), PrimaryTargetWeight(InPrimaryTargetWeight), MinScore(1.0f), WeightedSum(0.0f), WeightSum(0.0f),
+		  bHasScore(false), bDiscarded(false), bFinal(false)
+	{
+	}
+
+	void Add(const float Score, const bool bPrimaryTarget)
+	{
+		bHasScore = true;
+		MinScore = FMath::Min(MinScore, Score);
+
+		const float Weight = Policy == ECoverScoreAggregation::Weighted && bPrimaryTarget ? PrimaryTargetWeight : 1.0f;
+		WeightedSum += Score * Weight;
+		WeightSum += Weight;
+
+		// only a primary target scores below 0, the cover point is discarded whatever the other targets score
+		if (Score < 0.0f)
+		{
+			bDiscarded = true;
+			bFinal = true;
+		}
+		// the primary targets are done, the other targets can't score below 0
+		else if (Policy == ECoverScoreAggregation::Min && Score <= 0.0f)
+		{
+			bFinal = true;
+		}
+	}
+
+	bool HasScore() const { return bHasScore; }
+
+	// the remaining targets can't change the score
+	bool IsFinal() const { return bFinal; }
+
+	float GetScore() const
+	{
+		if (bDiscarded)
+			return -1.0f;
+
+		if (Policy == ECoverScoreAggregation::Min || WeightSum <= 0.0f)
+			return MinScore;
+
+		return WeightedSum / WeightSum;
+	}
+
+protected:
+	const ECoverScoreAggregation Policy;
+	const float PrimaryTargetWeight;
+	float MinScore;
+	float WeightedSum;
+	float WeightSum;
+	bool bHasScore;
+	bool bDiscarded;
+	bool bFinal;
+};
+
 /**
  * Test the cover point against a list of actors, to check visibility
  * will only use the QueryInstance.Owner, to check if the cover is valid (i.e. the character can crouch/stand behind it)
@@ -75,6 +286,16 @@ public:
 	UPROPERTY(EditAnywhere, Category="Trace")
 	TSubclassOf<UEnvQueryContext> PrimaryTargetContext;
 
+	/**
+	 * How the scores against each target are combined, the primary targets are evaluated first
+	 * and the remaining targets are skipped once the score can't change anymore
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Trace")
+	ECoverScoreAggregation ScoreAggregation;
+
+	UPROPERTY(EditDefaultsOnly, Category="Trace", meta=(EditCondition="ScoreAggregation==ECoverScoreAggregation::Weighted", ClampMin="0.0"))
+	float PrimaryTargetWeight;
+
 	/**
 	 * How close must the actual cover object be to a cover point. This is to avoid picking a cover point that doesn't provide meaningful cover.
 	 */
@@ -86,6 +307,127 @@ public:
 	 **/
 	UPROPERTY(EditDefaultsOnly, Category="Trace")
 	FAIDataProviderFloatValue CoverOutOffset;
+
+	/**
+	 * Use the cover height, facing and lean availability generated with the cover points instead of tracing them again.
+	 * The generated data is traced on UCoverSystemStatics::CoverTraceChannel along the cover's facing, not towards the target, so it's approximate.
+	 * The height is only used if it was traced at least as far as the cover sweep reaches, the lean availability only if it was checked
+	 * with CoverOutOffset, and neither if CoverTraceChannel differs. Otherwise they're traced again.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Trace")
+	bool bUseCoverMetadata;
+
+	/**
+	 * Use the protection masks generated with the cover points to decide whether the cover blocks the direction towards the target,
+	 * only directions between two sectors that don't agree are swept.
+	 * Requires bUseCoverMetadata, CoverPointMaxObjectHitDistance to match UCoverSystemStatics::CoverProtectionDistance
+	 * and CoverTraceChannel to match UCoverSystemStatics::CoverTraceChannel. Standing tests only use the masks of standing-height cover.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Trace", meta=(EditCondition="bUseCoverMetadata"))
+	bool bUseProtectionMask;
+
+	/**
+	 * How far the test heights (the character's eye heights) can be from UCoverSystemStatics::StandingCoverHeight
+	 * and UCoverSystemStatics::CrouchCoverHeight for the protection masks to be used
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Trace", meta=(EditCondition="bUseProtectionMask", ClampMin="0.0"))
+	float ProtectionMaskHeightTolerance;
+
+	/**
+	 * Use the nav mesh's cover visibility table (ACoverRecastNavMesh::bBuildCoverVisibilityTable) for the line of sight
+	 * between the cover point and the target when the target is standing near a cover point, instead of sweeping.
+	 * Uses ProtectionMaskHeightTolerance for the test heights.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Trace")
+	bool bUseVisibilityTable;
+
+	/**
+	 * How far the target's feet can be from a cover point to use the visibility table of that cover point
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Trace", meta=(EditCondition="bUseVisibilityTable", ClampMin="0.0"))
+	float VisibilityTableSnapDistance;
+
+	/**
+	 * Reuse the results of previous queries against the same target from the nav mesh's cover query cache (ACoverRecastNavMesh::CoverQueryCacheMaxEntries).
+	 * A result is reused while the target stays in the same ResultCacheTargetTolerance sized cell.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Trace")
+	bool bUseResultCache;
+
+	/**
+	 * Size of the cells the target eye locations are snapped to for the result cache
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Trace", meta=(EditCondition="bUseResultCache", ClampMin="1.0"))
+	float ResultCacheTargetTolerance;
+
+	/**
+	 * Evaluate the cover points of each time slice on the task graph workers, the scores are then written in item order on the game thread.
+	 * Debug drawing is skipped for the cover points evaluated on the workers.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Parallel")
+	bool bParallelEvaluation;
+
+	/**
+	 * Cover points evaluated in parallel per time slice, the EQS time limit is only checked between batches
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Parallel", meta=(EditCondition="bParallelEvaluation", ClampMin="1"))
+	int32 ParallelBatchSize;
+
+	/**
+	 * Submit the sweeps through the async trace API instead of blocking on them. The first time slice submits the cover sweep of every
+	 * cover point and target, the following frames collect the results and submit only the follow up sweeps that are needed.
+	 * Cover points are scored as soon as all their sweeps are done. EQS ends the test on a time slice that doesn't score an item, so if none are done
+	 * the next one is finished with blocking sweeps on top of the results received so far. The items the later time slices of a frame finish that way
+	 * are estimated from the previous frame and get no async sweeps.
+	 * Takes precedence over bParallelEvaluation.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Async")
+	bool bAsyncSweeps;
+
+	/**
+	 * Share the scores between the queries running this test in the same frame with the same targets and querier heights,
+	 * e.g. the members of a squad taking cover from the same enemies, each cover point is only evaluated by the first of them.
+	 * Not used with bAsyncSweeps.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Squad")
+	bool bShareSquadEvaluation;
+
+	/**
+	 * Decide cover points from their generated data and the target location before sweeping, see the Prefilter settings
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Prefilter")
+	bool bPrefilter;
+
+	/**
+	 * The target is in front of the cover point (on the open side) if the dot product of the cover facing and the 2D direction to the target is at least this,
+	 * the cover object is then behind the agent and can't protect it. Requires bUseCoverMetadata.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Prefilter", meta=(EditCondition="bPrefilter", ClampMin="-1.0", ClampMax="1.0"))
+	float PrefilterFacingThreshold;
+
+	/**
+	 * Cover points with the target in front of them and force field cover points can only fail the test.
+	 * For primary targets either failure scores the same, so they are always rejected. If this is set, they are also rejected as NotFound
+	 * for the other targets, even though an obstruction between them would have been accepted.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Prefilter", meta=(EditCondition="bPrefilter"))
+	bool bPrefilterApproximate;
+
+	/**
+	 * Targets further than this from the cover point are out of range and get PrefilterOutOfRangeResult without sweeping, 0 to disable
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Prefilter", meta=(EditCondition="bPrefilter", ClampMin="0.0"))
+	float PrefilterMaxTargetDistance;
+
+	UPROPERTY(EditDefaultsOnly, Category="Prefilter", meta=(EditCondition="bPrefilter"))
+	ECoverQueryResult PrefilterOutOfRangeResult;
+
+	/**
+	 * Cover points are rejected if the target looks down on the top of the cover (UCoverSystemStatics::StandingCoverHeight or CrouchCoverHeight)
+	 * at a steeper angle than this, in degrees. 0 to disable. Requires bUseCoverMetadata.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category="Prefilter", meta=(EditCondition="bPrefilter", ClampMin="0.0", ClampMax="90.0"))
+	float PrefilterMaxElevationAngle;
 	
 	/** Function that does the actual work */
 	virtual void RunTest(FEnvQueryInstance& QueryInstance) const override;
@@ -94,12 +436,135 @@ public:
 	
 	virtual FText GetDescriptionDetails() const override;
 
-	ECoverQueryResult EvaluateCoverPoint(const struct FCoverPointOctreeElement* CoverPoint, const float CoverTestHeight,
-	                        AActor* TestTargetActor, const FVector& TestTargetLocation, const bool bTestHitByLean, UWorld* World) const;
+	/**
+	 * @param VisibilityTable optional, used with TestTargetCoverPoint instead of sweeping the line of sight to the target
+	 * @param TestTargetCoverPoint the cover point the target is standing at
+	 */
+	ECoverQueryResult EvaluateCoverPoint(const struct FEnvQueryCoverPointItem* CoverPoint, const float CoverTestHeight,
+	                        AActor* TestTargetActor, const FVector& TestTargetLocation, const bool bTestHitByLean, FCoverSweepProvider& Sweeper,
+	                        const FCoverVisibilityTable* VisibilityTable = nullptr, const FCoverHandle* TestTargetCoverPoint = nullptr) const;
+
+	/**
+	 * @brief evaluate a cover point against a target of the query, standing then crouching, uses the result cache if set in Params
+	 * @param DeferredCacheInserts if set, new results are added here instead of to the result cache
+	 * @param Sweeper if not set, the sweeps block on Params.World
+	 * @return false if the target no longer exists or Sweeper is still waiting for a sweep
+	 */
+	bool EvaluateCoverPointForTarget(const struct FEnvQueryCoverPointItem& CoverPoint, const FCoverTestQueryTargets& Targets, int32 TargetIdx,
+	                                 const FCoverEvaluationParams& Params, ECoverQueryResult& OutResult, TArray<FCoverQueryCacheInsert>* DeferredCacheInserts = nullptr,
+	                                 FCoverSweepProvider* Sweeper = nullptr) const;
+
+	/**
+	 * @brief decide the cover point without sweeping, if the generated data and the target location allow it
+	 * @return false if the cover point needs to be evaluated
+	 */
+	bool PrefilterCoverPoint(const struct FEnvQueryCoverPointItem& CoverPoint, const FVector& TestTargetLocation, bool bPrimaryTarget,
+	                         ECoverQueryResult& OutResult) const;
+
+	FCoverQueryCacheKey MakeResultCacheKey(const struct FEnvQueryCoverPointItem& CoverPoint, const FCoverTestQueryTargets& Targets, int32 TargetIdx,
+	                                       const FCoverEvaluationParams& Params) const;
+
+	/**
+	 * @brief evaluate the cover points against the targets on the task graph workers
+	 * @param OutResults NumCoverPoints * NumTargets results, cover point major, unset if the target no longer exists or the pair wasn't evaluated
+	 * @param PairIndices the pairs to evaluate, indices into OutResults, all of them if not set
+	 */
+	void EvaluateCoverPointsParallel(const TArray<struct FEnvQueryCoverPointItem>& CoverPoints, const FCoverTestQueryTargets& Targets,
+	                                 const FCoverEvaluationParams& Params, TArray<TOptional<ECoverQueryResult>>& OutResults,
+	                                 const TArray<int32>* PairIndices = nullptr) const;
+
+	/**
+	 * @brief EvaluateCoverPointsParallel on the primary targets, then on the other targets for the cover points the primary targets didn't decide
+	 * @param OutResults see EvaluateCoverPointsParallel, unset for the skipped pairs
+	 */
+	void EvaluateCoverPointsPrimaryFirst(const TArray<struct FEnvQueryCoverPointItem>& CoverPoints, const FCoverTestQueryTargets& Targets,
+	                                     const FCoverEvaluationParams& Params, TArray<TOptional<ECoverQueryResult>>& OutResults) const;
+
+	/**
+	 * @brief hash of the settings that change the result of the test, for the result cache
+	 */
+	uint32 GetResultCacheSettingsHash() const;
+
+	/**
+	 * @brief score of a cover point against a single target, before aggregation
+	 */
+	static float GetTargetScore(ECoverQueryResult CoverResult, bool bPrimaryTarget);
+
+	/**
+	 * @brief look up the generated protection masks of the cover point in the test direction
+	 * @return Unknown if the masks can't be used and the cover sweep is needed
+	 */
+	ECoverProtection GetProtectionFromMask(const struct FEnvQueryCoverPointItem* CoverPoint, const float CoverTestHeight, const FVector& TestDir) const;
+
+	/**
+	 * @brief whether the generated cover height was traced with the settings of the test, see bUseCoverMetadata
+	 */
+	bool CanUseGeneratedHeight(const struct FCoverPointMetadata& Metadata) const;
+
+	/**
+	 * @brief whether the generated lean availability was checked with the settings of the test, see bUseCoverMetadata
+	 */
+	bool CanUseGeneratedLean(const struct FCoverPointMetadata& Metadata) const;
+
+	bool CheckHitByLeaning(const struct FEnvQueryCoverPointItem* CoverPoint, const FHitResult& CoverHitResult, const FVector& CoverLocation,
+	                       AActor* TestTargetActor, const FVector& TestTargetLocation, FCoverSweepProvider& Sweeper) const;
 
-	bool CheckHitByLeaning(const FHitResult& CoverHitResult, const FVector& CoverLocation, AActor* TestTargetActor,
-	                       const FVector& TestTargetLocation, UWorld* World) const;
+	ECoverQueryResult EvaluateCrouchCoverPoint(const struct FEnvQueryCoverPointItem* CoverPoint, const float StandingTestHeight, const float CoverTestHeight,
+						AActor* TestTargetActor, const FVector& TestTargetLocation, FCoverSweepProvider& Sweeper,
+						const FCoverVisibilityTable* VisibilityTable = nullptr, const FCoverHandle* TestTargetCoverPoint = nullptr) const;
 
-	ECoverQueryResult EvaluateCrouchCoverPoint(const struct FCoverPointOctreeElement* CoverPoint, const float StandingTestHeight, const float CoverTestHeight,
-						AActor* TestTargetActor, const FVector& TestTargetLocation, UWorld* World) const;
+protected:
+	/**
+	 * @brief gather the targets of the query, the actors of the trace context and their eye view points
+	 */
+	void PrepareQueryTargets(FEnvQueryInstance& QueryInstance, const class ACoverRecastNavMesh* NavData, FCoverTestQueryTargets& OutTargets) const;
+
+	/**
+	 * @brief get the cover point of the item, read from the item if it's a UEnvQueryItemType_CoverPoint, otherwise looked up by location
+	 * @param ScratchElement receives the octree element of the lookup, declared once by the caller so the items don't each allocate one
+	 * @param OutCoverPoint
+	 * @return false if the item isn't a cover point
+	 */
+	bool GetItemCoverPoint(FEnvQueryInstance& QueryInstance, int32 ItemIndex, const class ACoverRecastNavMesh* NavData, struct FCoverPointOctreeElement& ScratchElement,
+		struct FEnvQueryCoverPointItem& OutCoverPoint) const;
+
+	/**
+	 * @brief bAsyncSweeps evaluation, collects the sweep results of the query once per frame, scores the cover points whose sweeps are all done
+	 * and submits the follow up sweeps
+	 */
+	void RunAsyncEvaluation(FEnvQueryInstance& QueryInstance, const class ACoverRecastNavMesh* NavData, FCoverTestQueryTargets& QueryTargets,
+	                        const FCoverEvaluationParams& Params, float MinThresholdValue, float MaxThresholdValue) const;
+
+	/**
+	 * @brief evaluate the pair again with the sweep results received so far, submits the next sweep if the evaluation needs it
+	 * @param Mode whether the next sweep is submitted, finished by blocking, or not started
+	 */
+	void AdvanceAsyncPair(FCoverAsyncEvaluation& Evaluation, int32 PairIdx, const FCoverTestQueryTargets& QueryTargets, const FCoverEvaluationParams& Params,
+	                      ECoverAsyncAdvance Mode) const;
+
+	/**
+	 * @brief advance the pairs of the cover point, the other targets wait for the primary targets
+	 * and the pairs that can't change the score anymore are resolved without a result
+	 */
+	void AdvanceAsyncCoverPoint(FCoverAsyncEvaluation& Evaluation, int32 CoverPointIdx, const FCoverTestQueryTargets& QueryTargets, const FCoverEvaluationParams& Params,
+	                            ECoverAsyncAdvance Mode) const;
+
+	/**
+	 * @brief get the shared scores of the queries with the same targets and settings in the current frame, drops the scores of the previous frames
+	 */
+	FCoverSquadEvaluation& FindSquadEvaluation(const FCoverTestQueryTargets& Targets, const FCoverEvaluationParams& Params) const;
+
+	/**
+	 * The test is time sliced by the EQS item iterator, the targets of each running query are kept here until its last slice,
+	 * or until the query found its single result. Entries of queries that never get their last slice, because they were aborted,
+	 * are dropped when their owner is gone, or after RunningQueryTimeout otherwise.
+	 * Keyed by QueryID, only used on the game thread
+	 */
+	mutable TMap<int32, FCoverTestQueryTargets> RunningQueryTargets;
+
+	/**
+	 * See bShareSquadEvaluation, only valid in SquadEvaluationFrame. Only used on the game thread
+	 */
+	mutable TArray<FCoverSquadEvaluation> SquadEvaluations;
+	mutable uint64 SquadEvaluationFrame;
 };
@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EnvironmentQuery/EnvQueryTest.h"
+#include "EnvQueryTest_CoverPathCost.generated.h"
+
+/**
+ * Scores or filters cover point items by the path cost computed by UEnvQueryGenerator_ReachableCoverPoints, without any path query.
+ * Items without a path cost are left unscored.
+ */
+UCLASS(meta = (DisplayName = "Cover Path Cost"))
+class NAVIGATIONCOVERSYSTEM_API UEnvQueryTest_CoverPathCost : public UEnvQueryTest
+{
+	GENERATED_BODY()
+
+public:
+	UEnvQueryTest_CoverPathCost();
+
+	virtual void RunTest(FEnvQueryInstance& QueryInstance) const override;
+
+	virtual FText GetDescriptionTitle() const override;
+	virtual FText GetDescriptionDetails() const override;
+};
@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EnvironmentQuery/EnvQueryTest.h"
+#include "EnvQueryTest_CoverThreatExposure.generated.h"
+
+/**
+ * Scores or filters cover points by the fraction of the nav mesh's threats they're exposed to, read from the FCoverThreatMap
+ * which is updated once per threat movement instead of traced per query. 0 is protected from every threat in range.
+ * Cover point items are looked up by handle, other vector items by their location.
+ */
+UCLASS(meta = (DisplayName = "Cover Threat Exposure"))
+class NAVIGATIONCOVERSYSTEM_API UEnvQueryTest_CoverThreatExposure : public UEnvQueryTest
+{
+	GENERATED_BODY()
+
+public:
+	UEnvQueryTest_CoverThreatExposure();
+
+	virtual void RunTest(FEnvQueryInstance& QueryInstance) const override;
+
+	virtual FText GetDescriptionTitle() const override;
+	virtual FText GetDescriptionDetails() const override;
+};
@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CoverInvalidationNotifier.h"
+#include "CoverOctree.h"
+
+class ACoverRecastNavMesh;
+
+enum class ECoverCrowdState : uint8
+{
+	Idle,		//doesn't want cover
+	Pending,	//waiting for FCoverCrowd::Process to select cover
+	InCover,	//holds a cover point
+	NoCover		//there was no free cover within its search radius, call RequestCover to try again
+};
+
+/**
+ * Where a crowd entity is, written by the owner of the crowd
+ */
+struct FCoverCrowdLocationFragment
+{
+	FVector Location;
+};
+
+/**
+ * The cover a crowd entity is looking for and the one it holds
+ */
+struct FCoverCrowdCoverFragment
+{
+	float SearchRadius;
+
+	ECoverCrowdState State;
+
+	// Held with ACoverRecastNavMesh::HoldCover while InCover
+	FCoverHandle Cover;
+
+	FVector CoverLocation;
+};
+
+/**
+ * Cover selection for crowds of lightweight agents that can't afford an EQS query each.
+ * Entities are ids into arrays of fragments, Process selects and holds cover for the pending entities in chunks:
+ * the entities in the same ChunkSize cell share one octree traversal, and get the cheapest free cover points assigned to them at once.
+ * Cover points are scored by distance and by their exposure in the nav mesh's FCoverThreatMap, without sweeping.
+ * The held cover points are watched with the nav mesh's FCoverInvalidationNotifier: entities move to the replacement of a regenerated cover point,
+ * and select cover again when theirs is removed.
+ * Not thread-safe, use from the game thread.
+ */
+class NAVIGATIONCOVERSYSTEM_API FCoverCrowd
+{
+public:
+	UE_NONCOPYABLE(FCoverCrowd);
+
+	explicit FCoverCrowd(ACoverRecastNavMesh* InNavMesh);
+
+	/**
+	 * @brief releases the cover held by the entities
+	 */
+	~FCoverCrowd();
+
+	/**
+	 * @brief add an entity, it's idle until RequestCover is called
+	 * @param Location
+	 * @param SearchRadius max distance to the cover points selected for it
+	 * @return id of the entity
+	 */
+	int32 AddEntity(const FVector& Location, float SearchRadius);
+
+	/**
+	 * @brief remove the entity and release its cover, the id can be reused by the next entity
+	 */
+	void RemoveEntity(int32 EntityId);
+
+	void SetEntityLocation(int32 EntityId, const FVector& Location);
+
+	/**
+	 * @brief select cover for the entity on the next Process, releases the cover it holds
+	 */
+	void RequestCover(int32 EntityId);
+
+	/**
+	 * @brief release the cover held by the entity, it becomes idle
+	 */
+	void ReleaseCover(int32 EntityId);
+
+	ECoverCrowdState GetEntityState(int32 EntityId) const { return CoverFragments[EntityId].State; }
+
+	const FCoverCrowdCoverFragment& GetEntityCover(int32 EntityId) const { return CoverFragments[EntityId]; }
+
+	int32 GetNumEntities() const { return LocationFragments.Num() - FreeEntityIds.Num(); }
+
+	int32 GetNumPendingEntities() const { return PendingEntityIds.Num(); }
+
+	/**
+	 * @brief select cover for the pending entities, chunk by chunk until the time budget is spent
+	 * the entities of the chunks that didn't fit in the budget stay pending for the next call
+	 * @param TimeBudget seconds, at least one chunk is processed
+	 * @return number of entities processed
+	 */
+	int32 Process(double TimeBudget);
+
+	// Size of the grid cells the pending entities are chunked by
+	float ChunkSize;
+
+	// Cover points exposed to a larger fraction of the threats are never selected, 1 to disable
+	float MaxThreatExposure;
+
+	// Distance added to the cost of a cover point exposed to every threat, scaled by its exposure
+	float ExposureCost;
+
+protected:
+	/**
+	 * @brief select cover for the entities of a chunk with one traversal
+	 */
+	void ProcessChunk(const TArray<int32>& EntityIds);
+
+	bool IsValidEntity(int32 EntityId) const { return ActiveEntities.IsValidIndex(EntityId) && ActiveEntities[EntityId]; }
+
+	/**
+	 * @brief hold the replacements of the regenerated cover points, request cover again for the entities whose cover was removed
+	 */
+	void OnCoverInvalidated(const TArray<FCoverInvalidation>& Invalidations);
+
+	TWeakObjectPtr<ACoverRecastNavMesh> NavMesh;
+
+	// Fragments, indexed by entity id
+	TArray<FCoverCrowdLocationFragment> LocationFragments;
+	TArray<FCoverCrowdCoverFragment> CoverFragments;
+
+	TBitArray<> ActiveEntities;
+
+	TArray<int32> FreeEntityIds;
+
+	// Can contain entities that are no longer pending, they are skipped
+	TArray<int32> PendingEntityIds;
+
+	// Entity holding each cover point, by handle id
+	TMap<uint32, int32> CoverToEntity;
+
+	// Id in the nav mesh's FCoverInvalidationNotifier
+	int32 InvalidationSubscriberId;
+};
@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CoverOctree.h"
+
+enum class ECoverInvalidationReason : uint8
+{
+	Removed,	//the cover point is gone, e.g. its cover object was destroyed or moved
+	Replaced,	//the cover point was regenerated at about the same location, see FCoverInvalidation::Replacement, its metadata may have changed
+	Updated		//the cover point is kept but its data changed, e.g. the poly it stands on
+};
+
+/**
+ * A change to a watched cover point
+ */
+struct FCoverInvalidation
+{
+public:
+	FCoverHandle Handle;
+
+	ECoverInvalidationReason Reason;
+
+	// The regenerated cover point if Replaced, it's watched in place of Handle
+	FCoverHandle Replacement;
+
+	FCoverInvalidation()
+		: Reason(ECoverInvalidationReason::Removed)
+	{
+	}
+
+	FCoverInvalidation(const FCoverHandle& InHandle, const ECoverInvalidationReason InReason, const FCoverHandle& InReplacement = FCoverHandle())
+		: Handle(InHandle), Reason(InReason), Replacement(InReplacement)
+	{
+	}
+};
+
+/**
+ * Tells the holders of cover handles when their cover points are removed or change, so they don't have to poll with queries.
+ * Subscribers watch the handles they hold, and get the changes to them in one batch per frame on the game thread.
+ * Removed cover points stop being watched, replaced ones are watched through their replacement.
+ * Owned by ACoverRecastNavMesh, which reports the changes as the octree is updated.
+ * Thread-safe.
+ */
+class NAVIGATIONCOVERSYSTEM_API FCoverInvalidationNotifier
+{
+public:
+	typedef TFunction<void(const TArray<FCoverInvalidation>&)> FOnCoverInvalidated;
+
+	FCoverInvalidationNotifier();
+
+	~FCoverInvalidationNotifier();
+
+	/**
+	 * @brief start sending the batches once per frame
+	 * @param InReplacementDistance a cover point added within this distance of a removed one in the same frame replaces it
+	 */
+	void Init(float InReplacementDistance);
+
+	/**
+	 * @brief stop sending the batches, drops the subscribers and the pending changes
+	 */
+	void Reset();
+
+	/**
+	 * @brief
+	 * @param OnInvalidated called on the game thread with the changes to the handles watched by the subscriber, at most once per frame
+	 * @return id of the subscriber
+	 */
+	int32 AddSubscriber(FOnCoverInvalidated&& OnInvalidated);
+
+	/**
+	 * @brief stop watching the subscriber's handles, the pending changes to them are dropped
+	 */
+	void RemoveSubscriber(int32 SubscriberId);
+
+	void Watch(int32 SubscriberId, const FCoverHandle& Handle);
+
+	void Unwatch(int32 SubscriberId, const FCoverHandle& Handle);
+
+	/**
+	 * @brief report the removed cover points, called with the cover data locked for writing
+	 * @param RemovedCoverPoints handle and location of each removed cover point
+	 */
+	void NotifyRemoved(const TArray<TPair<FCoverHandle, FVector>>& RemovedCoverPoints);
+
+	/**
+	 * @brief report the added cover points, to match them with the removed ones. Called with the cover data locked for writing
+	 */
+	void NotifyAdded(const TArray<FCoverPointOctreeElement>& AddedCoverPoints);
+
+	/**
+	 * @brief report the cover points whose data changed, called with the cover data locked for writing
+	 */
+	void NotifyUpdated(const TArray<FCoverHandle>& UpdatedHandles);
+
+	/**
+	 * @brief report that every cover point was removed, e.g. the octree was rebuilt
+	 */
+	void NotifyAllRemoved();
+
+	/**
+	 * @brief send the pending changes to the subscribers, called on the game thread once per frame
+	 */
+	void DispatchPendingInvalidations();
+
+protected:
+	struct FSubscriber
+	{
+		FOnCoverInvalidated OnInvalidated;
+
+		// Handle ids
+		TSet<uint32> WatchedHandles;
+	};
+
+	bool Tick(float DeltaTime);
+
+	/**
+	 * @brief queue a change for the watchers of the handle, Lock must be held
+	 */
+	void AddInvalidationLocked(const FCoverHandle& Handle, ECoverInvalidationReason Reason, const FVector* Location = nullptr);
+
+	float ReplacementDistance;
+
+	mutable FCriticalSection Lock;
+
+	TMap<int32, FSubscriber> Subscribers;
+
+	int32 NextSubscriberId;
+
+	// Subscribers by handle id
+	TMultiMap<uint32, int32> Watchers;
+
+	struct FPendingInvalidation
+	{
+		FCoverInvalidation Invalidation;
+
+		// Where a removed cover point was, to find its replacement
+		FVector Location;
+		bool bCanBeReplaced;
+	};
+
+	TArray<FPendingInvalidation> PendingInvalidations;
+
+	// Cover points added since the last batch, only recorded while there are watched removals to match them with
+	TArray<TPair<FCoverHandle, FVector>> PendingAdded;
+
+	bool bHasPendingRemovals;
+
+	FDelegateHandle TickerHandle;
+};
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NavMesh/RecastNavMesh.h"
+
+/**
+ * Immutable copy of the Detour data of a navmesh tile: its polys, vertices, detail triangles and which poly edges are linked.
+ * Captured on the game thread when the tile is rebuilt, so the cover generator workers don't read the live navmesh
+ * while the next tiles are being built and swapped in.
+ * Vertices are in Unreal space.
+ */
+class NAVIGATIONCOVERSYSTEM_API FCoverNavMeshTileSnapshot
+{
+public:
+	// DT_VERTS_PER_POLYGON, checked in the cpp
+	static constexpr int32 MaxPolyVerts = 6;
+
+	struct FPoly
+	{
+		NavNodeRef Ref;
+
+		// Bounds of the detail mesh, invalid for off-mesh connections
+		FBox Bounds;
+
+		uint16 Verts[MaxPolyVerts];
+
+		// Detour neighbour of each edge: 0 for none, internal poly index + 1, or DT_EXT_LINK for the tile borders
+		uint16 Neis[MaxPolyVerts];
+
+		uint8 VertCount;
+
+		uint8 Area;
+
+		uint8 Type;
+
+		// Bit per edge that has a link to another poly
+		uint8 LinkedEdges;
+
+		int32 DetailVertBase;
+
+		int32 DetailTriBase;
+
+		int32 DetailTriCount;
+	};
+
+	uint32 TileIndex;
+
+	// Bounds of the tile, expanded by half the tile height on the Z-axis. Invalid if the tile was removed
+	FBox Bounds;
+
+	// Polys from this index on are off-mesh connections
+	int32 OffMeshBase;
+
+	TArray<FPoly> Polys;
+
+	TArray<FVector> Verts;
+
+	TArray<FVector> DetailVerts;
+
+	// 3 vertex indices and the edge flags of each detail triangle, same as dtMeshTile::detailTris
+	TArray<uint8> DetailTris;
+
+	FCoverNavMeshTileSnapshot();
+
+	/**
+	 * @brief copy the tile's data, called on the game thread where the navmesh isn't modified concurrently
+	 * @param NavMesh
+	 * @param InTileIndex
+	 * @return an empty snapshot if the tile doesn't exist anymore
+	 */
+	static TSharedRef<const FCoverNavMeshTileSnapshot, ESPMode::ThreadSafe> Capture(const ARecastNavMesh& NavMesh, uint32 InTileIndex);
+
+	/**
+	 * @brief same as ACoverRecastNavMesh::GetPolyEdges: the detail edges along the poly's edges that don't lead to another poly
+	 * @param PolyIdx index into Polys
+	 * @param OutEdgeVerts pairs of vertices
+	 * @return false if the poly has no such edge or isn't a ground poly
+	 */
+	bool GetPolyEdges(int32 PolyIdx, TArray<FVector>& OutEdgeVerts) const;
+
+	/**
+	 * @brief ARecastNavMesh::ProjectPoint limited to the tile: the closest point on the walkable detail triangles of the polys overlapping Extent
+	 * @param Point
+	 * @param Extent
+	 * @param OutLocation
+	 * @return false if no poly overlaps Extent
+	 */
+	bool ProjectPoint(const FVector& Point, const FVector& Extent, FNavLocation& OutLocation) const;
+
+protected:
+	const FVector& GetDetailTriVert(const FPoly& Poly, uint8 VertIdx) const
+	{
+		return VertIdx < Poly.VertCount ? Verts[Poly.Verts[VertIdx]] : DetailVerts[Poly.DetailVertBase + VertIdx - Poly.VertCount];
+	}
+};
@@ -0,0 +1,39 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NavFilters/NavigationQueryFilter.h"
+#include "CoverNavigationQueryFilter.generated.h"
+
+/**
+ * Adds a traversal cost to the navmesh polys exposed to the threats of ACoverRecastNavMesh's FCoverThreatMap,
+ * and optionally to the polys without cover points, so paths favour cover without tracing or running an EQS query.
+ * The exposure and the cover points are precomputed per poly, pathfinding only looks them up. Other nav data falls back to the default filter.
+ */
+UCLASS()
+class NAVIGATIONCOVERSYSTEM_API UCoverNavigationQueryFilter : public UNavigationQueryFilter
+{
+	GENERATED_BODY()
+
+public:
+	UCoverNavigationQueryFilter();
+
+	/**
+	 * Cost added per unit of distance travelled on a poly exposed to every threat, scaled by the fraction of threats it's exposed to.
+	 * 1 makes a fully exposed poly twice as expensive as a covered one.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover", meta = (ClampMin = "0.0"))
+	float ExposureCostMultiplier;
+
+	/**
+	 * Cost added per unit of distance travelled on a poly without any cover point, 0 to disable.
+	 * Added to the polys without cover rather than taken off the ones with cover, so the costs stay above the pathfinding heuristic.
+	 * Each poly the pathfinding visits then looks up its cover points under the cover data lock.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover", meta = (ClampMin = "0.0"))
+	float NoCoverCostMultiplier;
+
+protected:
+	virtual void InitializeFilter(const ANavigationData& NavData, const UObject* Querier, FNavigationQueryFilter& Filter) const override;
+};
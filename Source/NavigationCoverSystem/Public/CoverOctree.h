@@ -4,11 +4,171 @@
 #include "CoreMinimal.h"
 #include "Math/GenericOctreePublic.h"
 #include "Math/GenericOctree.h"
+#include "Engine/EngineTypes.h"
 #include "CoverOctree.generated.h"
 
 /** uniform identifier type for navigation data elements may it be a polygon or graph node */
 typedef int32 TileIndexType;
 
+/**
+ * Stable identifier of a cover point, ids are never reused while the cover octree is alive.
+ * Unlike the location, a handle doesn't match a different cover point that is regenerated at the same spot.
+ */
+struct FCoverHandle
+{
+public:
+	uint32 Id;
+
+	FCoverHandle()
+		: Id(0)
+	{
+	}
+
+	explicit FCoverHandle(const uint32 InId)
+		: Id(InId)
+	{
+	}
+
+	FORCEINLINE bool IsValid() const
+	{
+		return Id != 0;
+	}
+
+	FORCEINLINE bool operator==(const FCoverHandle& Other) const
+	{
+		return Id == Other.Id;
+	}
+
+	FORCEINLINE bool operator!=(const FCoverHandle& Other) const
+	{
+		return Id != Other.Id;
+	}
+
+	friend FORCEINLINE uint32 GetTypeHash(const FCoverHandle& Handle)
+	{
+		return Handle.Id;
+	}
+};
+
+UENUM()
+enum class ECoverHeight : uint8
+{
+	Crouch		= 0,	//cover only protects crouching agents
+	Standing	= 1		//cover is tall enough to protect standing agents
+};
+
+/** What the cover point's surroundings look like in a direction, see FCoverPointMetadata::GetProtection */
+enum class ECoverProtection : uint8
+{
+	Unknown,		//no protection data, or the direction is between two sectors that don't agree
+	Open,			//nothing blocks the direction
+	Blocked,		//something other than the cover object blocks the direction, or the cover object is too far away
+	Protected		//the cover object blocks the direction
+};
+
+/**
+ * Static data about a cover point, computed once by the generator so it doesn't need to be traced again at query time
+ */
+struct FCoverPointMetadata
+{
+public:
+	// Number of yaw sectors in the protection masks, one bit per sector, sector 0 is centered on the X axis
+	static constexpr int32 NumProtectionSectors = 32;
+	
+	// Direction the cover is facing on the XY plane, i.e. from the cover object towards the cover point
+	FVector FacingNormal;
+
+	// Whether the cover protects standing or only crouching agents
+	ECoverHeight Height;
+
+	// Whether the agent can lean out to the left of the cover (looking at the cover object, along -FacingNormal) without being blocked
+	bool bCanLeanLeft;
+
+	// Whether the agent can lean out to the right of the cover (looking at the cover object, along -FacingNormal) without being blocked
+	bool bCanLeanRight;
+
+	// Whether the masks below have been generated
+	bool bHasProtectionMasks;
+
+	// Per height, bit per yaw sector, set if the cover object blocks the sector within UCoverSystemStatics::CoverProtectionDistance
+	uint32 ProtectionMask[2];
+
+	// Per height, bit per yaw sector, set if anything else blocks the sector, or the cover object is further than UCoverSystemStatics::CoverProtectionDistance
+	uint32 BlockedMask[2];
+
+	// Settings the data above was traced with, a query tracing with different ones can't rely on it.
+	// Even with the same settings the data is approximate: it's traced along -FacingNormal, not towards a target
+
+	// Collision channel of every trace above
+	TEnumAsByte<ECollisionChannel> TraceChannel;
+
+	// How far behind the cover point the standing height was traced, Height is Crouch if nothing was hit within it
+	float HeightTraceDistance;
+
+	// How far to the sides the lean locations were checked
+	float LeanOffset;
+
+	FCoverPointMetadata()
+		: FacingNormal(FVector::ZeroVector), Height(ECoverHeight::Crouch), bCanLeanLeft(false), bCanLeanRight(false), bHasProtectionMasks(false),
+		  ProtectionMask{0, 0}, BlockedMask{0, 0}, TraceChannel(ECC_MAX), HeightTraceDistance(0.0f), LeanOffset(0.0f)
+	{
+	}
+
+	FCoverPointMetadata(const FVector& InFacingNormal, const ECoverHeight InHeight, const bool bInCanLeanLeft, const bool bInCanLeanRight)
+		: FacingNormal(InFacingNormal), Height(InHeight), bCanLeanLeft(bInCanLeanLeft), bCanLeanRight(bInCanLeanRight), bHasProtectionMasks(false),
+		  ProtectionMask{0, 0}, BlockedMask{0, 0}, TraceChannel(ECC_MAX), HeightTraceDistance(0.0f), LeanOffset(0.0f)
+	{
+	}
+
+	/**
+	 * @brief get the direction in the middle of the sector
+	 * @param Sector 
+	 * @return unit vector on the XY plane
+	 */
+	static FVector GetSectorDirection(const int32 Sector)
+	{
+		const float Yaw = Sector * (2.0f * PI / NumProtectionSectors);
+		return FVector(FMath::Cos(Yaw), FMath::Sin(Yaw), 0.0f);
+	}
+
+	/**
+	 * @brief look up the protection masks in the given direction, without tracing
+	 * @param TestHeight the height class of the masks to use
+	 * @param Direction direction to test, only the yaw is used
+	 * @return Unknown if the masks weren't generated or the two closest sectors don't agree
+	 */
+	ECoverProtection GetProtection(const ECoverHeight TestHeight, const FVector& Direction) const
+	{
+		if (!bHasProtectionMasks)
+			return ECoverProtection::Unknown;
+
+		// sector position in [0, NumProtectionSectors), sector centers are on whole numbers
+		float SectorPosition = FMath::Atan2(Direction.Y, Direction.X) * (NumProtectionSectors / (2.0f * PI));
+		if (SectorPosition < 0.0f)
+		{
+			SectorPosition += NumProtectionSectors;
+		}
+
+		const int32 NearestSector = FMath::RoundToInt(SectorPosition);
+		const int32 NeighbourSector = SectorPosition >= NearestSector ? NearestSector + 1 : NearestSector - 1;
+
+		const ECoverProtection NearestProtection = GetSectorProtection(TestHeight, NearestSector);
+		return NearestProtection == GetSectorProtection(TestHeight, NeighbourSector) ? NearestProtection : ECoverProtection::Unknown;
+	}
+
+private:
+	ECoverProtection GetSectorProtection(const ECoverHeight TestHeight, const int32 Sector) const
+	{
+		const uint32 SectorBit = 1u << ((Sector + NumProtectionSectors) % NumProtectionSectors);
+		const int32 HeightIndex = static_cast<int32>(TestHeight);
+
+		if (ProtectionMask[HeightIndex] & SectorBit)
+			return ECoverProtection::Protected;
+
+		return BlockedMask[HeightIndex] & SectorBit ? ECoverProtection::Blocked : ECoverProtection::Open;
+	}
+};
+
 /**
  * DTO for FCoverPointOctreeData
  * Data Transfer Objects
@@ -21,14 +181,16 @@ public:
 	bool bForceField;
 	TileIndexType TileIndex;
 	NavNodeRef NodeRef;
+	FCoverPointMetadata Metadata;
 
 	FDataTransferObjectCoverData()
-		: CoverObject(), Location(), bForceField(), TileIndex(-1), NodeRef(INVALID_NAVNODEREF)
+		: CoverObject(), Location(), bForceField(), TileIndex(-1), NodeRef(INVALID_NAVNODEREF), Metadata()
 	{
 	}
 
-	FDataTransferObjectCoverData(AActor* InCoverObject, const FVector InLocation, const bool bInForceField, const TileIndexType InTileIndex, const NavNodeRef InNodeRef)
-		: CoverObject(InCoverObject), Location(InLocation), bForceField(bInForceField), TileIndex(InTileIndex), NodeRef(InNodeRef)
+	FDataTransferObjectCoverData(AActor* InCoverObject, const FVector InLocation, const bool bInForceField, const TileIndexType InTileIndex, const NavNodeRef InNodeRef,
+		const FCoverPointMetadata& InMetadata = FCoverPointMetadata())
+		: CoverObject(InCoverObject), Location(InLocation), bForceField(bInForceField), TileIndex(InTileIndex), NodeRef(InNodeRef), Metadata(InMetadata)
 	{
 	}
 };
@@ -50,18 +212,27 @@ public:
 	// Whether the cover point is taken by a unit
 	bool bTaken;
 
+	// UObject unique id of the unit that took it, 0 if it isn't taken or the unit is unknown
+	uint32 HolderId;
+
 	TileIndexType TileIndex;
 
 	NavNodeRef NodeRef;
 
+	// Cover height, facing and lean availability computed by the generator
+	const FCoverPointMetadata Metadata;
+
+	// Assigned when the cover point is added to the octree
+	FCoverHandle Handle;
+
 	FCoverPointOctreeData()
-		: Location(), bForceField(false), CoverObject(), bTaken(false), TileIndex(-1), NodeRef(INVALID_NAVNODEREF)
+		: Location(), bForceField(false), CoverObject(), bTaken(false), HolderId(0), TileIndex(-1), NodeRef(INVALID_NAVNODEREF), Metadata(), Handle()
 	{
 	}
 
 	FCoverPointOctreeData(FDataTransferObjectCoverData CoverData)
 		: Location(CoverData.Location), bForceField(CoverData.bForceField), CoverObject(CoverData.CoverObject),
-		  bTaken(false), TileIndex(CoverData.TileIndex), NodeRef(CoverData.NodeRef)
+		  bTaken(false), HolderId(0), TileIndex(CoverData.TileIndex), NodeRef(CoverData.NodeRef), Metadata(CoverData.Metadata), Handle()
 	{
 	}
 };
@@ -137,12 +308,19 @@ public:
 	virtual ~FCoverOctree() {}	
 
 	// Won't crash the game if ElementId is invalid, unlike the similarly named superclass method. This method hides the base class method as it's not virtual.
+	// Also removes the element's handle mapping.
 	// ReSharper disable once CppHidingFunction
 	void RemoveElement(const FOctreeElementId2 ElementId);
 
+	// Assigns the next free handle to the element, call before adding it.
+	FCoverHandle AssignHandle(const FCoverPointOctreeElement& Element);
+
+	// Changes the NodeRef of the element and keeps the poly index up to date.
+	void SetElementNodeRef(FOctreeElementId2 ElementId, NavNodeRef NodeRef);
+
 	// Mark the cover at the supplied location as taken.
 	// Returns true if the cover wasn't already taken, false if it was or an error has occurred, e.g. the cover no longer exists.
-	bool HoldCover(FOctreeElementId2 ElementId);
+	bool HoldCover(FOctreeElementId2 ElementId, uint32 HolderId = 0);
 	//bool HoldCover(FCoverPointOctreeElement Element);
 	
 	// Releases a cover that was taken.
@@ -160,6 +338,21 @@ protected:
 	 */
 	TMap<const FVector, FOctreeElementId2> ElementToOctreeId;
 
-	void SetElementIdImpl(const FVector ElementLocation, FOctreeElementId2 Id);
+	/**
+	 * Maps cover point handles to their ids
+	 * NOT THREAD-SAFE! Use the corresponding thread-safe functions instead
+	 */
+	TMap<FCoverHandle, FOctreeElementId2> HandleToOctreeId;
+
+	/**
+	 * Maps navmesh polys to the handles of the cover points generated on them
+	 * NOT THREAD-SAFE! Use the corresponding thread-safe functions instead
+	 */
+	TMultiMap<NavNodeRef, FCoverHandle> NodeRefToHandles;
+
+	// Last assigned handle id, 0 is invalid
+	uint32 LastHandleId = 0;
+
+	void SetElementIdImpl(const FCoverPointOctreeElement& Element, FOctreeElementId2 Id);
 };
 
@@ -16,6 +16,8 @@ struct NAVIGATIONCOVERSYSTEM_API FCoverOctreeController
 	bool IsValid() const { return CoverOctree.IsValid(); }
 
 	const FOctreeElementId2* GetElementNavOctreeId(const FVector& ElementLocation) const;
+
+	const FOctreeElementId2* GetElementNavOctreeId(const FCoverHandle& Handle) const;
 	
 	void RemoveNavOctreeElementId(const FOctreeElementId2& ElementId) const;
 
@@ -37,7 +39,24 @@ struct NAVIGATIONCOVERSYSTEM_API FCoverOctreeController
 	 */
 	template<class T>
 	void FindElementsInNavOctree(const FSphere& QuerySphere, TArray<T>& Elements) const;
+
+	/**
+	 * @brief Calls Func for the cover points that intersect the supplied sphere, until it returns false.
+	 * @param QuerySphere 
+	 * @param Func bool(const FCoverPointOctreeElement&), return false to stop the traversal
+	 */
+	template<typename FuncType>
+	void ForEachElementInNavOctree(const FSphere& QuerySphere, const FuncType& Func) const;
 	
+	/**
+	 * @brief Finds the cover points generated on the navmesh poly.
+	 * @param PolyRef 
+	 * @param Elements 
+	 */
+	void FindElementsOnPoly(NavNodeRef PolyRef, TArray<FCoverPointOctreeElement>& Elements) const;
+
+	int32 GetNumElementsOnPoly(NavNodeRef PolyRef) const;
+
 	/**
 	 * @brief does the octree have an element inside given query
 	 * @param QueryBox 
@@ -72,3 +91,16 @@ void FCoverOctreeController::FindElementsInNavOctree(const FSphere& QuerySphere,
 		});
 	}
 }
+
+template <typename FuncType>
+void FCoverOctreeController::ForEachElementInNavOctree(const FSphere& QuerySphere, const FuncType& Func) const
+{
+	if (CoverOctree.IsValid())
+	{
+		const FBoxCenterAndExtent BoxFromSphere(QuerySphere.Center, FVector(QuerySphere.W));
+		CoverOctree->FindFirstElementWithBoundsTest(BoxFromSphere, [&Func, &QuerySphere](const FCoverPointOctreeElement& CoverPoint)
+		{
+			return !QuerySphere.Intersects(CoverPoint.Bounds.GetSphere()) || Func(CoverPoint);
+		});
+	}
+}
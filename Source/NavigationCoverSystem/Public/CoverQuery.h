@@ -0,0 +1,288 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/EnvQueryItemType_CoverPoint.h"
+#include "AI/EnvQueryTest_Cover.h"
+#include "Async/Future.h"
+
+/**
+ * Actor a cover query evaluates the cover points against
+ */
+struct FCoverQueryTarget
+{
+public:
+	// Ignored by the sweeps, the target is skipped if it's destroyed before the query runs
+	TWeakObjectPtr<AActor> Actor;
+
+	// Where the target looks from, captured when the request is made
+	FVector EyeLocation;
+
+	// Failing a primary target discards the cover point
+	bool bPrimary;
+
+	FCoverQueryTarget()
+		: EyeLocation(FVector::ZeroVector), bPrimary(false)
+	{
+	}
+
+	FCoverQueryTarget(AActor* InActor, const FVector& InEyeLocation, const bool bInPrimary = false)
+		: Actor(InActor), EyeLocation(InEyeLocation), bPrimary(bInPrimary)
+	{
+	}
+};
+
+/**
+ * Cover query made outside of EQS, see FCoverQueryScheduler.
+ * Runs in stages, each one only on the cover points kept by the previous: gather around Center, filter on the cover point data,
+ * then evaluate against the targets with the settings of an UEnvQueryTest_Cover.
+ */
+struct FCoverQueryRequest
+{
+public:
+	FVector Center;
+
+	float Radius;
+
+	// Max number of cover points passed from the filter stage to the evaluation, the closest to Center are kept. 0 or less for no limit
+	int32 MaxCandidates;
+
+	// Filter out the cover points that only protect crouching agents
+	bool bStandingCoverOnly;
+
+	bool bExcludeForceFields;
+
+	// Filter out the cover points that can't be held, see ACoverRecastNavMesh::IsCoverAreaReserved
+	bool bExcludeReservedCover;
+
+	// The cover points held by these and the areas reserved around them aren't filtered out by bExcludeReservedCover, e.g. the querier's current cover
+	TArray<TWeakObjectPtr<const UObject>> IgnoredHolders;
+
+	// Filter out the cover points exposed to a larger fraction of the nav mesh's threats, see FCoverThreatMap. 1 to disable
+	float MaxThreatExposure;
+
+	// The evaluation stage is skipped if there are no targets
+	TArray<FCoverQueryTarget> Targets;
+
+	float StandingEyeHeight;
+
+	// Only used if bTestCrouchHeight
+	float CrouchingEyeHeight;
+	bool bTestCrouchHeight;
+
+	// Settings of the evaluation stage, the default UEnvQueryTest_Cover if not set. Must outlive the query
+	const UEnvQueryTest_Cover* Evaluator;
+
+	// Cover points scoring below this against the targets are dropped
+	float MinScore;
+
+	// Max number of cover points in the result, best first, 0 or less for no limit
+	int32 MaxResults;
+
+	FCoverQueryRequest()
+		: Center(FVector::ZeroVector), Radius(0.0f), MaxCandidates(0), bStandingCoverOnly(false), bExcludeForceFields(true), bExcludeReservedCover(false), MaxThreatExposure(1.0f),
+		  StandingEyeHeight(0.0f), CrouchingEyeHeight(0.0f), bTestCrouchHeight(false), Evaluator(nullptr), MinScore(0.0f), MaxResults(0)
+	{
+	}
+};
+
+/**
+ * Cover point kept by a cover query, owns a copy of the cover point data
+ */
+struct FCoverQueryResultPoint
+{
+public:
+	FEnvQueryCoverPointItem CoverPoint;
+
+	// Aggregated score against the targets, 1 if the query had no targets
+	float Score;
+
+	// Distance from the query center
+	float Distance;
+
+	FCoverQueryResultPoint()
+		: Score(0.0f), Distance(0.0f)
+	{
+	}
+};
+
+struct FCoverQueryResult
+{
+public:
+	// false if the query was dropped, i.e. the nav mesh went away before it ran
+	bool bSuccess;
+
+	// Best score first, then closest first
+	TArray<FCoverQueryResultPoint> CoverPoints;
+
+	FCoverQueryResult()
+		: bSuccess(false)
+	{
+	}
+};
+
+/**
+ * Agent of a squad cover query
+ */
+struct FCoverSquadMember
+{
+public:
+	FVector Location;
+
+	// Max distance to the cover point assigned to the member
+	float Radius;
+
+	// Holds the member's cover point with ACoverRecastNavMesh::HoldCover, usually the member's controller or pawn.
+	// The cover it already holds stays available to it
+	TWeakObjectPtr<const UObject> Holder;
+
+	FCoverSquadMember()
+		: Location(FVector::ZeroVector), Radius(0.0f)
+	{
+	}
+
+	FCoverSquadMember(const FVector& InLocation, const float InRadius, const UObject* InHolder = nullptr)
+		: Location(InLocation), Radius(InRadius), Holder(InHolder)
+	{
+	}
+};
+
+/**
+ * Cover query made for a whole squad taking cover from the same targets, see FCoverQueryScheduler::SubmitSquad.
+ * The union of the members' cover points is gathered and evaluated once, then each member is assigned a different cover point.
+ */
+struct FCoverSquadRequest
+{
+public:
+	// Filter and evaluation settings, Center and Radius are computed from the members and MaxResults is ignored
+	FCoverQueryRequest Query;
+
+	TArray<FCoverSquadMember> Members;
+
+	// Min distance between the cover points assigned to the members, so they don't all end up at the same cover object
+	float MinSpacing;
+
+	// Distance added to the cost of a cover point scoring 0, scaled by 1 - score
+	float ScoreCost;
+
+	// Take the assigned cover points with ACoverRecastNavMesh::HoldCover under each member's Holder, the members must release them.
+	// The cover points that can't be held are then filtered out, as with FCoverQueryRequest::bExcludeReservedCover,
+	// except those held by the members themselves. A member keeps the cover it already holds if it's assigned to it again
+	bool bHoldCover;
+
+	FCoverSquadRequest()
+		: MinSpacing(200.0f), ScoreCost(1000.0f), bHoldCover(true)
+	{
+	}
+};
+
+struct FCoverSquadResult
+{
+public:
+	// false if the query was dropped, i.e. the nav mesh went away before it ran
+	bool bSuccess;
+
+	// The cover points kept by the query, best score first, then closest to the squad first
+	TArray<FCoverQueryResultPoint> CoverPoints;
+
+	// Index into CoverPoints of the cover point assigned to each member, INDEX_NONE if none
+	TArray<int32> MemberCoverPoints;
+
+	FCoverSquadResult()
+		: bSuccess(false)
+	{
+	}
+};
+
+/**
+ * Runs the cover queries of the agents that don't use EQS, owned by ACoverRecastNavMesh.
+ * Queries can be submitted from any thread, they are run together once per frame on the game thread:
+ * queries with overlapping search spheres share one octree traversal, and queries with the same targets and evaluation settings
+ * share one evaluation of the union of their cover points on the task graph workers.
+ * Squad queries are run the same way, as one query around the whole squad.
+ * Thread-safe.
+ */
+class NAVIGATIONCOVERSYSTEM_API FCoverQueryScheduler
+{
+public:
+	FCoverQueryScheduler();
+
+	~FCoverQueryScheduler();
+
+	/**
+	 * @brief start running queries, does nothing if already running for the nav mesh
+	 * @param InNavMesh
+	 */
+	void Init(class ACoverRecastNavMesh* InNavMesh);
+
+	/**
+	 * @brief stop running queries, the pending queries complete without success
+	 */
+	void Reset();
+
+	bool IsEnabled() const;
+
+	/**
+	 * @brief queue a query, the future is set on the game thread
+	 * @param Request
+	 * @return the result, without success if the scheduler isn't running
+	 */
+	TFuture<FCoverQueryResult> Submit(const FCoverQueryRequest& Request);
+
+	/**
+	 * @brief queue a query
+	 * @param Request
+	 * @param OnCompleted called on the game thread, or right away without success if the scheduler isn't running
+	 */
+	void Submit(const FCoverQueryRequest& Request, TUniqueFunction<void(const FCoverQueryResult&)>&& OnCompleted);
+
+	/**
+	 * @brief queue a squad query, the cover points are assigned to the members on the game thread
+	 * @param Request
+	 * @param OnCompleted called on the game thread, or right away without success if the scheduler isn't running
+	 */
+	void SubmitSquad(const FCoverSquadRequest& Request, TUniqueFunction<void(const FCoverSquadResult&)>&& OnCompleted);
+
+	int32 GetNumPendingQueries() const;
+
+	/**
+	 * @brief run the queued queries, called on the game thread once per frame
+	 */
+	void ProcessPendingQueries();
+
+protected:
+	struct FPendingQuery
+	{
+		FCoverQueryRequest Request;
+
+		TUniqueFunction<void(const FCoverQueryResult&)> OnCompleted;
+	};
+
+	bool Tick(float DeltaTime);
+
+	/**
+	 * @brief assign the cover points of a squad query to its members, cheapest pairs first and spread apart by MinSpacing
+	 */
+	void AssignSquadCover(const FCoverSquadRequest& Request, FCoverSquadResult& Result) const;
+
+	/**
+	 * @brief gather and filter the cover points of the queries, queries with overlapping spheres share one traversal
+	 * @param OutResults one per query, closest first
+	 */
+	void GatherCoverPoints(const TArray<TUniquePtr<FPendingQuery>>& Queries, TArray<FCoverQueryResult>& OutResults) const;
+
+	/**
+	 * @brief score the cover points of the queries against their targets, queries with the same targets and settings share one evaluation
+	 * @param OutResults one per query, the cover points below MinScore are removed
+	 */
+	void EvaluateCoverPoints(const TArray<TUniquePtr<FPendingQuery>>& Queries, TArray<FCoverQueryResult>& OutResults) const;
+
+	class ACoverRecastNavMesh* NavMesh;
+
+	mutable FCriticalSection PendingLock;
+
+	TArray<TUniquePtr<FPendingQuery>> PendingQueries;
+
+	FDelegateHandle TickerHandle;
+};
@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CoverOctree.h"
+
+enum class ECoverQueryResult : uint8;
+
+/**
+ * Identifies one cover evaluation, a cover point against a target standing in a cell of the quantized target grid
+ */
+struct FCoverQueryCacheKey
+{
+public:
+	FCoverHandle CoverPoint;
+
+	// Target eye location divided by the target tolerance
+	FIntVector TargetCell;
+
+	// Unique id of the target actor, the evaluation ignores hits on the target
+	uint32 TargetId;
+
+	// Test heights rounded to the nearest unit, crouch is 0 if the querier can't crouch
+	int32 StandingHeight;
+	int32 CrouchHeight;
+
+	// Hash of the test settings that change the result
+	uint32 SettingsHash;
+
+	FCoverQueryCacheKey()
+		: CoverPoint(), TargetCell(), TargetId(0), StandingHeight(0), CrouchHeight(0), SettingsHash(0)
+	{
+	}
+
+	FCoverQueryCacheKey(const FCoverHandle& InCoverPoint, const FVector& TargetLocation, const float TargetTolerance, const uint32 InTargetId,
+		const float InStandingHeight, const float InCrouchHeight, const uint32 InSettingsHash)
+		: CoverPoint(InCoverPoint), TargetCell(QuantizeLocation(TargetLocation, TargetTolerance)), TargetId(InTargetId),
+		  StandingHeight(FMath::RoundToInt(InStandingHeight)), CrouchHeight(FMath::RoundToInt(InCrouchHeight)), SettingsHash(InSettingsHash)
+	{
+	}
+
+	static FIntVector QuantizeLocation(const FVector& Location, const float CellSize)
+	{
+		const float InvCellSize = 1.0f / FMath::Max(CellSize, 1.0f);
+		return FIntVector(FMath::FloorToInt(Location.X * InvCellSize), FMath::FloorToInt(Location.Y * InvCellSize), FMath::FloorToInt(Location.Z * InvCellSize));
+	}
+
+	bool operator==(const FCoverQueryCacheKey& Other) const
+	{
+		return CoverPoint == Other.CoverPoint && TargetCell == Other.TargetCell && TargetId == Other.TargetId
+			&& StandingHeight == Other.StandingHeight && CrouchHeight == Other.CrouchHeight && SettingsHash == Other.SettingsHash;
+	}
+
+	friend uint32 GetTypeHash(const FCoverQueryCacheKey& Key)
+	{
+		uint32 Hash = GetTypeHash(Key.CoverPoint);
+		Hash = HashCombine(Hash, GetTypeHash(Key.TargetCell));
+		Hash = HashCombine(Hash, Key.TargetId);
+		Hash = HashCombine(Hash, GetTypeHash(Key.StandingHeight));
+		Hash = HashCombine(Hash, GetTypeHash(Key.CrouchHeight));
+		return HashCombine(Hash, Key.SettingsHash);
+	}
+};
+
+/**
+ * A result waiting to be added to the cache, used to add the results of a batch under one lock
+ */
+struct FCoverQueryCacheInsert
+{
+public:
+	FCoverQueryCacheKey Key;
+	TileIndexType TileIndex;
+	FVector CoverLocation;
+	FVector TargetLocation;
+	ECoverQueryResult Result;
+
+	FCoverQueryCacheInsert(const FCoverQueryCacheKey& InKey, const TileIndexType InTileIndex, const FVector& InCoverLocation, const FVector& InTargetLocation,
+		const ECoverQueryResult InResult)
+		: Key(InKey), TileIndex(InTileIndex), CoverLocation(InCoverLocation), TargetLocation(InTargetLocation), Result(InResult)
+	{
+	}
+};
+
+/**
+ * Bounded cache of UEnvQueryTest_Cover results, so queries repeated against the same targets don't sweep again.
+ * Entries are dropped when the tile of their cover point regenerates, when the line from their cover point to their target
+ * crosses a regenerated area, when they are older than the lifetime, and oldest first when the cache is full.
+ * A target moving out of its cell misses the cache.
+ * Thread-safe.
+ */
+class NAVIGATIONCOVERSYSTEM_API FCoverQueryResultCache
+{
+public:
+	FCoverQueryResultCache();
+
+	/**
+	 * @brief clear the cache and set its limits
+	 * @param InMaxEntries 0 disables the cache
+	 * @param InLifetime seconds an entry is valid for, 0 to never expire
+	 */
+	void Init(int32 InMaxEntries, float InLifetime);
+
+	void Reset();
+
+	bool IsEnabled() const { return MaxEntries > 0; }
+
+	/**
+	 * @brief
+	 * @param Key
+	 * @param TileIndex tile of the cover point
+	 * @param OutResult
+	 * @return false if there is no valid entry for the key
+	 */
+	bool Find(const FCoverQueryCacheKey& Key, TileIndexType TileIndex, ECoverQueryResult& OutResult) const;
+
+	/**
+	 * @brief
+	 * @param Key
+	 * @param TileIndex tile of the cover point
+	 * @param CoverLocation location of the cover point
+	 * @param TargetLocation eye location of the target the cover point was evaluated against
+	 * @param Result
+	 */
+	void Add(const FCoverQueryCacheKey& Key, TileIndexType TileIndex, const FVector& CoverLocation, const FVector& TargetLocation, ECoverQueryResult Result);
+
+	void Add(const TArray<FCoverQueryCacheInsert>& Inserts);
+
+	/**
+	 * @brief drop the entries of the cover points in the tile, called when the tile's cover is regenerated
+	 * @param TileIndex
+	 */
+	void InvalidateTile(TileIndexType TileIndex);
+
+	/**
+	 * @brief drop the entries whose cover point to target line crosses the area, their sweeps may hit the changed geometry.
+	 * Goes through all the entries, called once per regenerated tile
+	 * @param Area
+	 */
+	void InvalidateArea(const FBox& Area);
+
+	SIZE_T GetAllocatedSize() const;
+
+protected:
+	struct FEntry
+	{
+		ECoverQueryResult Result;
+		TileIndexType TileIndex;
+
+		// TileGenerations of the tile when the entry was added
+		uint32 TileGeneration;
+		double Time;
+
+		FVector CoverLocation;
+		FVector TargetLocation;
+
+		// Set by InvalidateArea, the entry is kept in place until it's overwritten or evicted
+		bool bInvalidated;
+	};
+
+	uint32 GetTileGeneration(TileIndexType TileIndex) const;
+
+	/**
+	 * @brief add or overwrite the entry, Lock must be held for writing
+	 */
+	void AddLocked(const FCoverQueryCacheKey& Key, TileIndexType TileIndex, const FVector& CoverLocation, const FVector& TargetLocation,
+		ECoverQueryResult Result, double Time);
+
+	void UpdateMemoryStats() const;
+
+	int32 MaxEntries;
+
+	float Lifetime;
+
+	mutable FRWLock Lock;
+
+	TMap<FCoverQueryCacheKey, FEntry> Entries;
+
+	// Keys in the order they were added, the oldest is overwritten when the cache is full
+	TArray<FCoverQueryCacheKey> EvictionRing;
+
+	int32 EvictionRingNext;
+
+	// Incremented whenever the tile's cover is regenerated, entries with an older generation are stale
+	TMap<TileIndexType, uint32> TileGenerations;
+};
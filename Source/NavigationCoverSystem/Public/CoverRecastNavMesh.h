@@ -5,9 +5,173 @@
 #include "CoreMinimal.h"
 #include "CoverOctree.h"
 #include "CoverOctreeController.h"
+#include "CoverInvalidationNotifier.h"
+#include "CoverNavMeshTileSnapshot.h"
+#include "CoverQuery.h"
+#include "CoverQueryResultCache.h"
+#include "CoverReservationGrid.h"
+#include "CoverThreatMap.h"
+#include "CoverVisibilityTable.h"
+#include "Containers/Queue.h"
 #include "NavMesh/RecastNavMesh.h"
 #include "CoverRecastNavMesh.generated.h"
 
+/**
+ * Dirty areas that caused a navmesh tile to be rebuilt.
+ * If bFullTile is set the whole tile has to be regenerated, otherwise only the edges intersecting Areas
+ */
+struct FCoverTileDirtyAreas
+{
+	TArray<FBox> Areas;
+
+	bool bFullTile;
+
+	FCoverTileDirtyAreas()
+		: bFullTile(false)
+	{
+	}
+
+	void MarkFullTile()
+	{
+		bFullTile = true;
+		Areas.Empty();
+	}
+
+	void Append(const FCoverTileDirtyAreas& Other)
+	{
+		if (bFullTile)
+			return;
+
+		if (Other.bFullTile)
+		{
+			MarkFullTile();
+			return;
+		}
+
+		for (const FBox& Area : Other.Areas)
+		{
+			AddArea(Area);
+		}
+	}
+
+	/**
+	 * @brief add a dirty area, merged with the areas it overlaps so that their edges are only regenerated once
+	 */
+	void AddArea(FBox Area)
+	{
+		if (bFullTile)
+			return;
+
+		// the merged area can overlap areas that the original one didn't
+		for (int32 AreaIdx = Areas.Num() - 1; AreaIdx >= 0; --AreaIdx)
+		{
+			if (Areas[AreaIdx].Intersect(Area))
+			{
+				Area += Areas[AreaIdx];
+				Areas.RemoveAtSwap(AreaIdx, 1, false);
+				AreaIdx = Areas.Num();
+			}
+		}
+
+		Areas.Add(Area);
+	}
+};
+
+/**
+ * Detail the cover of a navmesh tile is generated at, see ACoverRecastNavMesh::bEnableCoverLod
+ */
+enum class ECoverTileLod : uint8
+{
+	None,	//no cover, the tile is further than CoverLodCoarseDistance from every relevance source
+	Coarse,	//cover points CoverLodCoarseStepMultiplier times further apart along the edges
+	Fine	//cover points CoverPointMinDistance apart
+};
+
+/**
+ * A rebuilt navmesh tile waiting for its cover to be regenerated, see ACoverRecastNavMesh::TileUpdateDebounce
+ */
+struct FCoverPendingTileUpdate
+{
+	FCoverTileDirtyAreas DirtyAreas;
+
+	// The tile as of its last rebuild, the cover is generated from it instead of the live navmesh
+	TSharedPtr<const FCoverNavMeshTileSnapshot, ESPMode::ThreadSafe> Snapshot;
+
+	FBox Bounds;
+
+	// FPlatformTime::Seconds() of the first and the last rebuilds since the cover was last regenerated
+	double FirstUpdateTime;
+	double LastUpdateTime;
+
+	FCoverPendingTileUpdate()
+		: Bounds(ForceInit), FirstUpdateTime(0.0), LastUpdateTime(0.0)
+	{
+	}
+};
+
+/**
+ * The cover generated for a navmesh tile by a worker, waiting to be swapped into the octree, see ACoverRecastNavMesh::EnqueueTileCommit
+ */
+struct FCoverTileCommit
+{
+	// Area of the tile the stale cover points are removed from
+	FBox Area;
+
+	uint32 TileIndex;
+
+	// Empty if the whole tile was regenerated
+	TArray<FBox> DirtyAreas;
+
+	TArray<FDataTransferObjectCoverData> CoverPoints;
+
+	// New NodeRefs of the cover points kept during a partial regeneration, by location
+	TArray<TPair<FVector, NavNodeRef>> KeptNodeRefs;
+
+	// FPlatformTime::Seconds() when the commit was queued
+	double EnqueueTime;
+
+	// Stamped when the tile's regeneration was launched, commits overtaken by a later generation of the tile are discarded.
+	// 0 if it wasn't launched by ACoverRecastNavMesh::RegenerateCoverPoints, always applied then
+	uint32 Generation;
+
+	FCoverTileCommit()
+		: Area(ForceInit), TileIndex(0), EnqueueTime(0.0), Generation(0)
+	{
+	}
+};
+
+/**
+ * Order of the cover regenerations of a navmesh tile, see FCoverTileCommit::Generation
+ */
+struct FCoverTileGeneration
+{
+	// Latest regeneration launched for the whole tile, including dropping its cover
+	uint32 LatestFull;
+
+	// Latest regeneration applied to the octree
+	uint32 LastCommitted;
+
+	FCoverTileGeneration()
+		: LatestFull(0), LastCommitted(0)
+	{
+	}
+};
+
+/**
+ * A navmesh poly reached by ACoverRecastNavMesh::FindReachablePolys
+ */
+struct FCoverPolyReach
+{
+	// Path cost from the start location to EntryLocation
+	float Cost;
+
+	// Where the cheapest path enters the poly, the middle of the portal it crossed or the start location
+	FVector EntryLocation;
+
+	// Query filter cost of travelling one unit of distance on the poly, its area cost plus any cost the filter adds
+	float CostPerUnit;
+};
+
 /**
  * 
  */
@@ -25,6 +189,8 @@ public:
 	
 	virtual void PostRegisterAllComponents() override;
 
+	virtual void BeginDestroy() override;
+
 	//~ Begin ANavigationData Interface
 	
 	/** called after regenerating tiles */
@@ -37,6 +203,9 @@ public:
 
 	/** Triggers rebuild in case navigation supports it */
 	virtual void RebuildAll() override;
+
+	/** Rebuilds navigation data in specified areas, stores the areas so we only regenerate cover around them */
+	virtual void RebuildDirtyAreas(const TArray<FNavigationDirtyArea>& DirtyAreas) override;
 	
 	//~ End ANavigationData Interface
 	
@@ -49,29 +218,211 @@ public:
 	
 	// AABB used to filter out cover points on the edges of the map.
 	FBox MapBounds;
+
+	/**
+	 * Only regenerate cover for the navmesh edges that intersect the dirty areas which caused a tile rebuild,
+	 * instead of the whole tile. The rest of the tile's cover points are kept.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation")
+	bool bRegenerateDirtyAreasOnly;
+
+	/**
+	 * Distance added around each dirty area when picking the edges to regenerate.
+	 * Should be at least the cover scan reach so that cover generated by the dirty object is picked up.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation", meta = (EditCondition = "bRegenerateDirtyAreasOnly", ClampMin = "0.0"))
+	float DirtyAreaMargin;
+
+	/**
+	 * Seconds a rebuilt tile must go without being rebuilt again before its cover is regenerated,
+	 * so a tile rebuilt repeatedly by a moving obstacle or by streaming is only regenerated once per burst
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation", meta = (ClampMin = "0.0"))
+	float TileUpdateDebounce;
+
+	/**
+	 * Max seconds between the first rebuild of a tile and the regeneration of its cover, even if the tile keeps being rebuilt.
+	 * 0 to regenerate on the next frame
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation", meta = (ClampMin = "0.0"))
+	float TileUpdateMaxLatency;
+
+	/**
+	 * Regenerate neighbouring rebuilt tiles together: they wait until none of them was rebuilt for TileUpdateDebounce,
+	 * or until the oldest one reaches TileUpdateMaxLatency. Keeps the edges along tile borders from being generated against a stale neighbour
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation")
+	bool bCoalesceNeighbourTiles;
+
+	/**
+	 * Max milliseconds per frame spent swapping the cover generated by the workers into the octree, under a single write lock.
+	 * At least one tile is committed per frame. 0 to commit every finished tile on the frame it's done
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation", meta = (ClampMin = "0.0"))
+	float TileCommitBudget;
+
+	/**
+	 * Sweep the directional protection masks of each cover point during generation,
+	 * lets UEnvQueryTest_Cover skip its cover sweeps. Costs up to 64 sweeps per cover point.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation")
+	bool bGenerateCoverProtectionMasks;
+
+	/**
+	 * Trace the line of sight between cover points within CoverVisibilityRange of each other on a background task,
+	 * lets UEnvQueryTest_Cover skip its line of sight sweeps when the target is near a cover point.
+	 * Costs 4 sweeps per pair of cover points.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation")
+	bool bBuildCoverVisibilityTable;
+
+	/** Max distance between two cover points in the visibility table */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation", meta = (EditCondition = "bBuildCoverVisibilityTable", ClampMin = "0.0"))
+	float CoverVisibilityRange;
+
+	/** Max number of UEnvQueryTest_Cover results cached, 0 to disable the cache */
+	UPROPERTY(EditAnywhere, Category = "Cover Query Cache", meta = (ClampMin = "0"))
+	int32 CoverQueryCacheMaxEntries;
+
+	/**
+	 * Seconds a cached result stays valid, 0 to keep it until the tile regenerates or it's evicted.
+	 * Covers changes that don't rebuild the nav mesh, like a moving actor that doesn't affect navigation.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover Query Cache", meta = (ClampMin = "0.0"))
+	float CoverQueryCacheLifetime;
+
+	/** Polys further than this from a threat aren't exposed to it, 0 to disable the threat map used by UCoverNavigationQueryFilter */
+	UPROPERTY(EditAnywhere, Category = "Cover Threats", meta = (ClampMin = "0.0"))
+	float CoverThreatRange;
+
+	/** A threat that moved less than this keeps its exposed polys */
+	UPROPERTY(EditAnywhere, Category = "Cover Threats", meta = (ClampMin = "0.0"))
+	float CoverThreatUpdateDistance;
+
+	/**
+	 * Holding a cover point also blocks the cover points within this distance of it, so agents don't bunch up at the same cover object.
+	 * 0 to only block the held cover point.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover Reservation", meta = (ClampMin = "0.0"))
+	float CoverReservationRadius;
+
+	/**
+	 * Generate the cover of the tiles far from the relevance sources at a coarser step, or not at all,
+	 * and refine it as they approach. Only in game worlds, the editor always generates fine cover
+	 */
+	UPROPERTY(EditAnywhere, Category = "Cover LOD")
+	bool bEnableCoverLod;
+
+	/** Tiles within this distance of a relevance source get fine cover */
+	UPROPERTY(EditAnywhere, Category = "Cover LOD", meta = (EditCondition = "bEnableCoverLod", ClampMin = "0.0"))
+	float CoverLodFineDistance;
+
+	/** Tiles within this distance of a relevance source get coarse cover, the ones further away get none */
+	UPROPERTY(EditAnywhere, Category = "Cover LOD", meta = (EditCondition = "bEnableCoverLod", ClampMin = "0.0"))
+	float CoverLodCoarseDistance;
+
+	/** Coarse cover points are CoverPointMinDistance times this apart */
+	UPROPERTY(EditAnywhere, Category = "Cover LOD", meta = (EditCondition = "bEnableCoverLod", ClampMin = "1.0"))
+	float CoverLodCoarseStepMultiplier;
+
+	/** A tile keeps its LOD until the sources are this much further than the distance that refined it, so it isn't regenerated back and forth */
+	UPROPERTY(EditAnywhere, Category = "Cover LOD", meta = (EditCondition = "bEnableCoverLod", ClampMin = "0.0"))
+	float CoverLodHysteresis;
+
+	/** Seconds between two checks of the tile LODs against the relevance sources */
+	UPROPERTY(EditAnywhere, Category = "Cover LOD", meta = (EditCondition = "bEnableCoverLod", ClampMin = "0.0"))
+	float CoverLodUpdateInterval;
+
+	/** Every pawn is a relevance source, on top of the ones added with AddCoverRelevanceSource */
+	UPROPERTY(EditAnywhere, Category = "Cover LOD", meta = (EditCondition = "bEnableCoverLod"))
+	bool bPawnsAreCoverRelevanceSources;
 	
 protected:
-	TSet<uint32> UpdatedTilesIntervalBuffer;
+	/**
+	 * Rebuilt tiles whose cover hasn't been regenerated yet, by tile index
+	 */
+	TMap<uint32, FCoverPendingTileUpdate> PendingTileUpdates;
 
-	TSet<uint32> UpdatedTilesUntilFinishedBuffer;
+	/**
+	 * Bounds of the dirty areas passed to RebuildDirtyAreas that haven't been matched to all of their tiles yet,
+	 * cleared once navmesh generation has finished
+	 */
+	TArray<FBox> PendingDirtyAreas;
+
+	/**
+	 * @brief get the dirty areas that overlap the tile, expanded by DirtyAreaMargin
+	 * @param TileIdx 
+	 * @return the dirty areas of the tile, bFullTile if there was no matching dirty area
+	 */
+	FCoverTileDirtyAreas GetTileDirtyAreas(uint32 TileIdx) const;
+
+	FDelegateHandle TileUpdateTickerHandle;
+
+	bool TickTileUpdates(float DeltaTime);
+
+	/**
+	 * LOD each tile's cover was last generated at, by tile index
+	 */
+	TMap<uint32, ECoverTileLod> TileCoverLods;
+
+	/**
+	 * Game thread only, the workers finish in any order. By tile index, never reset so in-flight commits stay ordered
+	 */
+	TMap<uint32, FCoverTileGeneration> TileCoverGenerations;
+
+	uint32 LastTileCoverGeneration;
+
+	/**
+	 * @brief stamp a regeneration of the tile, called when it's launched
+	 * @param TileIdx
+	 * @param bFullTile whether it replaces all the tile's cover points
+	 * @return the generation to put in its FCoverTileCommit
+	 */
+	uint32 NextTileCoverGeneration(uint32 TileIdx, bool bFullTile);
+
+	TArray<TWeakObjectPtr<const AActor>> CoverRelevanceSources;
+
+	double LastCoverLodUpdateTime;
 
 	/**
-	 * Lock used for interval-buffered tile updates.
-	 * this is probably not needed
+	 * @brief queue the tiles whose LOD doesn't match the distance to the relevance sources anymore for regeneration
 	 */
-	//FCriticalSection TileUpdateLockObject;
+	void UpdateCoverLods();
 
-	static const float TileBufferInterval;
+	void GetCoverRelevanceLocations(TArray<FVector>& OutLocations) const;
 
-	FTimerHandle TileUpdateTimerHandle;
+	/**
+	 * @brief 
+	 * @param TileBounds 
+	 * @param CurrentLod the tile's LOD, kept within CoverLodHysteresis of its distance
+	 * @param RelevanceLocations see GetCoverRelevanceLocations
+	 * @return Fine if bEnableCoverLod is off or outside of game worlds
+	 */
+	ECoverTileLod GetDesiredTileLod(const FBox& TileBounds, ECoverTileLod CurrentLod, const TArray<FVector>& RelevanceLocations) const;
 
+	/**
+	 * @brief regenerate the cover of the pending tiles that are done being rebuilt or have waited TileUpdateMaxLatency,
+	 * neighbouring tiles together if bCoalesceNeighbourTiles
+	 */
 	void ProcessQueuedTiles();
 
 	/**
 	 * @brief start async workers to regenerate the cover points for the 
-	 * @param UpdatedTiles updated tiles idx 
+	 * @param UpdatedTiles updated tiles idx and their snapshot and dirty areas
 	 */
-	void RegenerateCoverPoints(const TSet<uint32>& UpdatedTiles);
+	void RegenerateCoverPoints(const TMap<uint32, FCoverPendingTileUpdate>& UpdatedTiles);
+
+	/**
+	 * Tiles generated by the workers, the game thread is the only consumer
+	 */
+	TQueue<FCoverTileCommit, EQueueMode::Mpsc> TileCommitQueue;
+
+	/**
+	 * @brief apply the queued tile commits under one write lock, until TileCommitBudget runs out.
+	 * Commits overtaken by a later full regeneration of their tile are discarded, those that finished after a newer commit
+	 * of their tile are discarded and their areas regenerated again
+	 */
+	void DrainTileCommits();
 	
 	/**
 	 * Thread lock for CoverOctree and ElementToIDLockObject
@@ -80,6 +431,36 @@ protected:
 
 	FCoverOctreeController CoverOctreeController;
 
+	/**
+	 * Line of sight between cover points, updated with the octree. Has its own lock.
+	 */
+	FCoverVisibilityTable CoverVisibilityTable;
+
+	/**
+	 * Cover test results, has its own lock. Mutable since it's filled by the queries
+	 */
+	mutable FCoverQueryResultCache CoverQueryResultCache;
+
+	/**
+	 * Per poly exposure to the threats, has its own lock. Mutable since threats are registered by gameplay code
+	 */
+	mutable FCoverThreatMap CoverThreatMap;
+
+	/**
+	 * Cover queries made outside of EQS, has its own lock. Mutable since queries are submitted by the agents
+	 */
+	mutable FCoverQueryScheduler CoverQueryScheduler;
+
+	/**
+	 * Areas around the held cover points, has its own lock. Always changed under the cover data write lock, along with bTaken
+	 */
+	FCoverReservationGrid CoverReservationGrid;
+
+	/**
+	 * Changes to the cover points watched by their holders, has its own lock. Mutable since the holders subscribe to it
+	 */
+	mutable FCoverInvalidationNotifier CoverInvalidationNotifier;
+
 	void ConstructCoverOctree();
 
 	/**
@@ -91,19 +472,27 @@ protected:
 	static FBox EnlargeAABB(const FBox Box, float Multiplier = 1.0f);
 	
 public:
+	/**
+	 * @brief Thread-safe, lock-free. Queue the cover generated for a tile, it's swapped into the octree on the game thread
+	 * with the other finished tiles, instead of every worker taking the write lock
+	 * @param Commit 
+	 */
+	void EnqueueTileCommit(FCoverTileCommit&& Commit);
+
 	/**
 	 * @brief Adds a set of cover points to the octree in a single, thread-safe batch.
 	 * @param CoverPoints 
 	 */
-	void AddCoverPoints(const TArray<FDataTransferObjectCoverData>& CoverPoints) const;
+	void AddCoverPoints(const TArray<FDataTransferObjectCoverData>& CoverPoints);
 	
 	/**
 	 * @brief Removes cover points within the specified area that don't fall on the navmesh or don't have an owner anymore.
 	 * Useful for trimming areas around deleted objects and dynamically placed ones.
 	 * @param Area
 	 * @param StaleTileIndex 
+	 * @param DirtyAreas if not empty, only the cover points of StaleTileIndex inside these areas are removed
 	 */
-	void RemoveStaleCoverPoints(FBox Area, const TileIndexType StaleTileIndex);
+	void RemoveStaleCoverPoints(FBox Area, const TileIndexType StaleTileIndex, const TArray<FBox>& DirtyAreas = TArray<FBox>());
 
 	
 	/**
@@ -111,8 +500,17 @@ public:
 	 * @param Area 
 	 * @param StaleTileIndex 
 	 * @param CoverPoints 
+	 * @param DirtyAreas if not empty, only the cover points of StaleTileIndex inside these areas are removed
+	 */
+	void RemoveStaleAndAddCoverPoints(FBox Area, const TileIndexType StaleTileIndex, const TArray<FDataTransferObjectCoverData>& CoverPoints,
+		const TArray<FBox>& DirtyAreas = TArray<FBox>());
+
+	/**
+	 * @brief Update the NodeRef of cover points that were kept during a partial tile regeneration,
+	 * the poly refs of a rebuilt tile change even if the polys didn't
+	 * @param NodeRefs cover point location to new NodeRef
 	 */
-	void RemoveStaleAndAddCoverPoints(FBox Area, const TileIndexType StaleTileIndex, const TArray<FDataTransferObjectCoverData>& CoverPoints);
+	void UpdateCoverPointNodeRefs(const TArray<TPair<FVector, NavNodeRef>>& NodeRefs) const;
 
 protected:
 
@@ -120,14 +518,21 @@ protected:
 	 * @brief  Adds a set of cover points to the octree in a single, not thread-safe
 	 * @param CoverPoints 
 	 */
-	void Internal_AddCoverPoints(const TArray<FDataTransferObjectCoverData>& CoverPoints) const;
+	void Internal_AddCoverPoints(const TArray<FDataTransferObjectCoverData>& CoverPoints);
 	
 	/**
 	 * @brief non thread-safe remove stale cover
 	 * @param Area 
 	 * @param StaleTileIndex 
+	 * @param DirtyAreas 
+	 */
+	void Internal_RemoveStaleCoverPoints(FBox Area, const TileIndexType StaleTileIndex, const TArray<FBox>& DirtyAreas);
+
+	/**
+	 * @brief non thread-safe UpdateCoverPointNodeRefs
+	 * @param NodeRefs 
 	 */
-	void Internal_RemoveStaleCoverPoints(FBox Area, const TileIndexType StaleTileIndex);
+	void Internal_UpdateCoverPointNodeRefs(const TArray<TPair<FVector, NavNodeRef>>& NodeRefs) const;
 
 public:
 	/**
@@ -148,8 +553,138 @@ public:
 	template<class T>
 	void FindCoverPoints(const FSphere& QuerySphere, TArray<T>& OutCoverPoints) const;
 
+	/**
+	 * @brief Thread-safe, calls Func for the cover points that intersect the supplied sphere until it returns false.
+	 * The cover data is locked for reading during the traversal, Func must not modify the cover points.
+	 * @param QuerySphere 
+	 * @param Func bool(const FCoverPointOctreeElement&)
+	 */
+	template<typename FuncType>
+	void ForEachCoverPoint(const FSphere& QuerySphere, const FuncType& Func) const;
+
 	bool GetCoverPointOctreeElement(FCoverPointOctreeElement& OutElement, const FVector& ElementLocation) const;
 
+	bool GetCoverPointOctreeElement(FCoverPointOctreeElement& OutElement, const FCoverHandle& Handle) const;
+
+	/**
+	 * @brief Thread-safe, mark the cover point as taken by a unit and reserve the CoverReservationRadius around it.
+	 * The reservation lasts until ReleaseCover or until the cover point is removed by a tile regeneration
+	 * @param Handle 
+	 * @param Holder optional, the holder's own reservations are ignored by IsCoverAreaReserved and don't block it from holding nearby cover
+	 * @return false if it was already taken, is in the area reserved by another holder's cover point or doesn't exist anymore
+	 */
+	bool HoldCover(const FCoverHandle& Handle, const UObject* Holder = nullptr);
+
+	/**
+	 * @brief Thread-safe, release a cover point taken with HoldCover. Not needed once the cover point is removed, its reservation is released with it
+	 * @param Handle 
+	 * @return false if it wasn't taken or doesn't exist anymore
+	 */
+	bool ReleaseCover(const FCoverHandle& Handle);
+
+	/**
+	 * @brief Thread-safe, O(1), whether a cover point at Location can't be held because it's in the area reserved around a held cover point.
+	 * Cheap enough to prefilter generated cover points before they are tested.
+	 * @param Location 
+	 * @param IgnoredHolder optional, the cover held by it doesn't count, e.g. the querier's current cover
+	 */
+	bool IsCoverAreaReserved(const FVector& Location, const UObject* IgnoredHolder = nullptr) const;
+
+	/**
+	 * @brief Thread-safe, IsCoverAreaReserved ignoring the cover held by several holders, e.g. the members of a squad
+	 * @param Location 
+	 * @param IgnoredHolders 
+	 */
+	bool IsCoverAreaReserved(const FVector& Location, const TArray<const UObject*>& IgnoredHolders) const;
+
+	/**
+	 * @brief Thread-safe, whether the cover point is held by the holder with HoldCover
+	 * @param Handle 
+	 * @param Holder 
+	 */
+	bool IsCoverHeldBy(const FCoverHandle& Handle, const UObject* Holder) const;
+
+	/**
+	 * @brief Thread-safe, finds the closest cover point to the location
+	 * @param OutElement 
+	 * @param Location 
+	 * @param MaxDistance 
+	 * @return false if there are no cover points within MaxDistance
+	 */
+	bool FindNearestCoverPoint(FCoverPointOctreeElement& OutElement, const FVector& Location, float MaxDistance) const;
+
+	/**
+	 * @brief Bounded Dijkstra over the navmesh polys, from the poly under StartLocation.
+	 * Paths go through the middle of the portals between polys and cost what the query filter charges pathfinding for them:
+	 * the area costs, the area change costs and any virtual cost such as UCoverNavigationQueryFilter's. Polys the filter excludes are never entered.
+	 * Not thread-safe with navmesh rebuilds, call from the game thread.
+	 * @param StartLocation 
+	 * @param MaxCost polys more expensive to reach than this aren't reached
+	 * @param OutReachedPolys 
+	 * @param QueryFilter optional, the nav mesh's default filter if not set
+	 * @return false if StartLocation isn't on the navmesh
+	 */
+	bool FindReachablePolys(const FVector& StartLocation, float MaxCost, TMap<NavNodeRef, FCoverPolyReach>& OutReachedPolys,
+		FSharedConstNavQueryFilter QueryFilter = nullptr) const;
+
+	/**
+	 * @brief Thread-safe, finds the cover points generated on the navmesh polys through the poly index, without a spatial query
+	 * @param PolyRefs 
+	 * @param OutCoverPoints 
+	 */
+	void FindCoverPointsOnPolys(const TArray<NavNodeRef>& PolyRefs, TArray<FCoverPointOctreeElement>& OutCoverPoints) const;
+
+	/**
+	 * @brief Thread-safe, number of cover points generated on the poly, for cover density data
+	 */
+	int32 GetNumCoverPointsOnPoly(NavNodeRef PolyRef) const;
+
+	/**
+	 * @brief finds the cover points on the polys of the path corridor
+	 * @param Path 
+	 * @param OutCoverPoints 
+	 */
+	void FindCoverPointsAlongPath(const FNavMeshPath& Path, TArray<FCoverPointOctreeElement>& OutCoverPoints) const;
+
+	/**
+	 * @brief finds the cover points on the polys at most MaxPolyDistance links away from StartPoly
+	 * Not thread-safe with navmesh rebuilds, call from the game thread.
+	 * @param StartPoly 
+	 * @param MaxPolyDistance 0 for the start poly only
+	 * @param OutCoverPoints 
+	 */
+	void FindCoverPointsNearPoly(NavNodeRef StartPoly, int32 MaxPolyDistance, TArray<FCoverPointOctreeElement>& OutCoverPoints) const;
+
+	/**
+	 * @brief finds the cover points on the polys of the nav area, goes through every indexed poly
+	 * @param AreaClass 
+	 * @param OutCoverPoints 
+	 */
+	void FindCoverPointsInNavArea(TSubclassOf<UNavArea> AreaClass, TArray<FCoverPointOctreeElement>& OutCoverPoints) const;
+
+	const FCoverVisibilityTable& GetCoverVisibilityTable() const { return CoverVisibilityTable; }
+
+	FCoverQueryResultCache& GetCoverQueryResultCache() const { return CoverQueryResultCache; }
+
+	/** Threats to path around with UCoverNavigationQueryFilter, add, update and remove them from the game thread */
+	FCoverThreatMap& GetCoverThreatMap() const { return CoverThreatMap; }
+
+	/** Submit cover queries from any thread, they complete on the game thread */
+	FCoverQueryScheduler& GetCoverQueryScheduler() const { return CoverQueryScheduler; }
+
+	const FCoverReservationGrid& GetCoverReservationGrid() const { return CoverReservationGrid; }
+
+	/** Watch the held cover points to be told once per frame when they are removed or change, instead of validating them with queries */
+	FCoverInvalidationNotifier& GetCoverInvalidationNotifier() const { return CoverInvalidationNotifier; }
+
+	/** Game thread only, tiles near the source get fine cover if bEnableCoverLod */
+	void AddCoverRelevanceSource(const AActor* Source);
+
+	void RemoveCoverRelevanceSource(const AActor* Source);
+
+	/** Game thread only, None if the tile's cover hasn't been generated yet */
+	ECoverTileLod GetTileCoverLod(uint32 TileIdx) const { return TileCoverLods.FindRef(TileIdx); }
+
 	/** Retrieves center of the specified polygon. Returns false on error. */
 	bool GetPolyEdges(NavNodeRef PolyID, TArray<FVector>& NavMeshEdgeVerts) const;
 };
@@ -172,4 +707,14 @@ void ACoverRecastNavMesh::FindCoverPoints(const FSphere& QuerySphere, TArray<T>&
 		FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_ReadOnly);
 		CoverOctreeController.FindElementsInNavOctree(QuerySphere, OutCoverPoints);
 	}
+}
+
+template <typename FuncType>
+void ACoverRecastNavMesh::ForEachCoverPoint(const FSphere& QuerySphere, const FuncType& Func) const
+{
+	if (CoverOctreeController.IsValid())
+	{
+		FRWScopeLock CoverDataLock(CoverDataLockObject, FRWScopeLockType::SLT_ReadOnly);
+		CoverOctreeController.ForEachElementInNavOctree(QuerySphere, Func);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CoverOctree.h"
+
+/**
+ * Areas around the cover points held with ACoverRecastNavMesh::HoldCover.
+ * Cover points are CoverPointMinDistance apart along the edges, so the neighbours of a held cover point are effectively the same spot:
+ * a reservation blocks every cover point within the exclusion radius, not just its own.
+ * Reservations are bucketed in a grid of ExclusionRadius sized cells, checking an area only looks at the 27 cells around it,
+ * each holding a handful of reservations at most since they can't be closer than the exclusion radius.
+ * Thread-safe.
+ */
+class NAVIGATIONCOVERSYSTEM_API FCoverReservationGrid
+{
+public:
+	FCoverReservationGrid();
+
+	/**
+	 * @brief drop the reservations and set the exclusion radius
+	 * @param InExclusionRadius 0 disables the grid, only the held cover point is then blocked
+	 */
+	void Init(float InExclusionRadius);
+
+	void Reset();
+
+	bool IsEnabled() const { return ExclusionRadius > 0.0f; }
+
+	/**
+	 * @brief reserve the area around the cover point, unless it overlaps the area of another holder
+	 * @param Handle
+	 * @param Location of the cover point
+	 * @param HolderId unique id of the holder, 0 if unknown. An unknown holder's area can't overlap any other
+	 * @return false if the area is already reserved
+	 */
+	bool Reserve(const FCoverHandle& Handle, const FVector& Location, uint32 HolderId = 0);
+
+	/**
+	 * @brief release the area reserved for the cover point
+	 * @return false if it wasn't reserved
+	 */
+	bool Release(const FCoverHandle& Handle);
+
+	/**
+	 * @brief O(1), whether a cover point at Location is within the exclusion radius of a reserved one
+	 * @param Location
+	 * @param IgnoredHolderId the reservations of this holder are ignored, 0 to check them all
+	 */
+	bool IsReserved(const FVector& Location, uint32 IgnoredHolderId = 0) const;
+
+	/**
+	 * @brief IsReserved ignoring the reservations of several holders, e.g. the members of a squad
+	 * @param Location
+	 * @param IgnoredHolderIds
+	 */
+	bool IsReserved(const FVector& Location, const TArray<uint32>& IgnoredHolderIds) const;
+
+	int32 GetNumReservations() const;
+
+	SIZE_T GetAllocatedSize() const;
+
+protected:
+	struct FReservation
+	{
+		FVector Location;
+		FCoverHandle Handle;
+		uint32 HolderId;
+	};
+
+	FIntVector GetCell(const FVector& Location) const;
+
+	/**
+	 * @brief IsReserved, Lock must be held
+	 * @param IsIgnoredHolder bool(uint32 HolderId), whether the reservations of the holder are ignored
+	 */
+	template<typename PredicateType>
+	bool IsReservedLocked(const FVector& Location, const PredicateType& IsIgnoredHolder) const;
+
+	float ExclusionRadius;
+
+	mutable FRWLock Lock;
+
+	TMap<FIntVector, TArray<FReservation, TInlineAllocator<2>>> Cells;
+
+	// Cell of each reservation, by handle id
+	TMap<uint32, FIntVector> HandleToCell;
+};
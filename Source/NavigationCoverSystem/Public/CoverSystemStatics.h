@@ -16,11 +16,59 @@ DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Cover / GenerateCoverInBounds"), STAT_G
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Historical Count"), STAT_GenerateCoverHistoricalCount, STATGROUP_CoverSystem);
 DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Generate Cover - Total Time Spent"), STAT_GenerateCoverAverageTime, STATGROUP_CoverSystem);
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Active Tasks"), STAT_TaskCount, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Coalesced Tile Updates"), STAT_CoverTileUpdatesCoalesced, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Regenerated Tiles"), STAT_CoverTilesRegenerated, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Tile Batches"), STAT_CoverTileBatches, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Tile Snapshots"), STAT_CoverTileSnapshots, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Fine Tiles"), STAT_CoverLodFineTiles, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Coarse Tiles"), STAT_CoverLodCoarseTiles, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - LOD Changes"), STAT_CoverLodChanges, STATGROUP_CoverSystem);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Cover / Commit Tiles"), STAT_CoverCommitTiles, STATGROUP_CoverSystem, NAVIGATIONCOVERSYSTEM_API);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Queued Tile Commits"), STAT_CoverTileCommitsQueued, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Committed Tiles"), STAT_CoverTileCommits, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generate Cover - Discarded Out-Of-Order Commits"), STAT_CoverTileCommitsDiscarded, STATGROUP_CoverSystem);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Generate Cover - Commit Queue Latency (ms)"), STAT_CoverTileCommitLatency, STATGROUP_CoverSystem);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Generate Cover - Commit Drain Cost (ms)"), STAT_CoverTileCommitDrainCost, STATGROUP_CoverSystem);
 
 DECLARE_CYCLE_STAT_EXTERN(TEXT("Find Cover"), STAT_FindCover, STATGROUP_CoverSystem, NAVIGATIONCOVERSYSTEM_API);
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Find Cover - Historical Count"), STAT_FindCoverHistoricalCount, STATGROUP_CoverSystem);
 DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Find Cover - Total Time Spent"), STAT_FindCoverTotalTimeSpent, STATGROUP_CoverSystem);
 
+// sweeps saved by the prefilter ~= prefiltered pairs * sweeps / evaluated pairs
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Test - Sweeps"), STAT_CoverTestSweeps, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Test - Evaluated Pairs"), STAT_CoverTestEvaluatedPairs, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Test - Prefiltered By Range"), STAT_CoverTestPrefilterRange, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Test - Prefiltered By Force Field"), STAT_CoverTestPrefilterForceField, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Test - Prefiltered By Facing"), STAT_CoverTestPrefilterFacing, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Test - Prefiltered By Elevation"), STAT_CoverTestPrefilterElevation, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Test - Skipped Pairs"), STAT_CoverTestSkippedPairs, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Test - Async Sweeps"), STAT_CoverTestAsyncSweeps, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Test - Blocking Sweeps In Async Mode"), STAT_CoverTestBlockingSweeps, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Test - Squad Shared Scores"), STAT_CoverTestSquadSharedScores, STATGROUP_CoverSystem);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Query Cache - Hits"), STAT_CoverQueryCacheHits, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Query Cache - Misses"), STAT_CoverQueryCacheMisses, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Query Cache - Evictions"), STAT_CoverQueryCacheEvictions, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Query Cache - Entries"), STAT_CoverQueryCacheEntries, STATGROUP_CoverSystem);
+DECLARE_MEMORY_STAT(TEXT("Cover Query Cache - Memory"), STAT_CoverQueryCacheMemory, STATGROUP_CoverSystem);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cover Query - Process"), STAT_CoverQueryProcess, STATGROUP_CoverSystem, NAVIGATIONCOVERSYSTEM_API);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Query - Queries"), STAT_CoverQueryQueries, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Query - Traversals"), STAT_CoverQueryTraversals, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Query - Evaluations"), STAT_CoverQueryEvaluations, STATGROUP_CoverSystem);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cover Crowd - Process"), STAT_CoverCrowdProcess, STATGROUP_CoverSystem, NAVIGATIONCOVERSYSTEM_API);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Crowd - Processed Entities"), STAT_CoverCrowdEntities, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Crowd - Traversals"), STAT_CoverCrowdTraversals, STATGROUP_CoverSystem);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Cover Crowd - Microseconds Per Entity"), STAT_CoverCrowdCostPerEntity, STATGROUP_CoverSystem);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Reservation - Reservations"), STAT_CoverReservations, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Reservation - Rejected"), STAT_CoverReservationsRejected, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Reservation - Prefiltered Cover Points"), STAT_CoverReservationsPrefiltered, STATGROUP_CoverSystem);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Invalidation - Invalidations"), STAT_CoverInvalidations, STATGROUP_CoverSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cover Invalidation - Batches"), STAT_CoverInvalidationBatches, STATGROUP_CoverSystem);
+
 /**
  * 
  */
@@ -44,6 +92,30 @@ public:
 	 */
 	static float SmallestAgentHeight;
 
+	/**
+	 * Height above the ground that the cover needs to reach to protect a standing agent.
+	 * Should normally be the standing eye height of the agents (Capsule Half Height + Base Eye Height)
+	 */
+	static float StandingCoverHeight;
+
+	/**
+	 * Height above the ground used to generate the crouch protection masks of cover points.
+	 * Should normally be the crouched eye height of the agents (Crouched Half Height + Crouched Eye Height)
+	 */
+	static float CrouchCoverHeight;
+
+	/**
+	 * How close the cover object must be to a cover point to protect it, used to generate the protection masks.
+	 * Should match UEnvQueryTest_Cover::CoverPointMaxObjectHitDistance
+	 */
+	static float CoverProtectionDistance;
+
+	/**
+	 * How far an agent leans out of cover to fire, used to generate the lean availability of cover points.
+	 * Should match UEnvQueryTest_Cover::CoverOutOffset
+	 */
+	static float CoverLeanOffset;
+
 	/**
 	 * @brief 
 	 * @param Vector direction vector
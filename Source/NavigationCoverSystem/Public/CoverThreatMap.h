@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CoverOctree.h"
+
+/**
+ * Number of threats a cover point is in range of and exposed to
+ */
+struct FCoverPointThreats
+{
+	int32 NumInRange;
+
+	int32 NumExposed;
+
+	FCoverPointThreats()
+		: NumInRange(0), NumExposed(0)
+	{
+	}
+};
+
+/**
+ * Exposure of the navmesh polys and cover points to a set of threat positions, shared by every agent facing the same threats.
+ * Read by UCoverNavigationQueryFilter to make paths favour cover, and by UEnvQueryTest_CoverThreatExposure to score cover in O(1).
+ * A cover point within range of a threat is exposed to it unless it's protected in the direction of the threat at its cover height,
+ * which is looked up in the cover point metadata instead of traced. A poly is exposed unless one of its cover points is protected at standing height.
+ * Only the polys and cover points around a threat are recomputed when it moves, or when the cover around it changed.
+ * Thread-safe, but a threat should only be updated from one thread at a time, the game thread also updates the threats whose cover changed.
+ */
+class NAVIGATIONCOVERSYSTEM_API FCoverThreatMap
+{
+public:
+	FCoverThreatMap();
+
+	/**
+	 * @brief start accepting threats
+	 * @param InNavMesh the nav mesh that owns the cover points and polys
+	 * @param InRange polys further than this from a threat aren't exposed to it
+	 * @param InUpdateDistance a threat that moved less than this keeps its exposed polys
+	 */
+	void Init(class ACoverRecastNavMesh* InNavMesh, float InRange, float InUpdateDistance);
+
+	/**
+	 * @brief remove all threats and stop accepting new ones
+	 */
+	void Reset();
+
+	bool IsEnabled() const { return NavMesh != nullptr && Range > 0.0f; }
+
+	/**
+	 * @brief add a threat and compute the polys exposed to it
+	 * @param Location
+	 * @return id of the threat, INDEX_NONE if the map is disabled
+	 */
+	int32 AddThreat(const FVector& Location);
+
+	/**
+	 * @brief move a threat, its exposed polys are only recomputed if it moved more than UpdateDistance or its area was invalidated
+	 * @param ThreatId
+	 * @param Location
+	 */
+	void UpdateThreat(int32 ThreatId, const FVector& Location);
+
+	void RemoveThreat(int32 ThreatId);
+
+	int32 GetNumThreats() const;
+
+	/**
+	 * @brief fraction of the threats the poly is exposed to
+	 * @param PolyRef
+	 * @return 0 if the poly is out of range of every threat or there are no threats
+	 */
+	float GetPolyExposure(NavNodeRef PolyRef) const;
+
+	/**
+	 * @brief fraction of the threats the cover point is exposed to
+	 * @param Handle
+	 * @return 0 if the cover point is out of range of every threat or there are no threats
+	 */
+	float GetCoverPointExposure(const FCoverHandle& Handle) const;
+
+	/**
+	 * @brief number of threats the cover point is in range of and exposed to
+	 * @param Handle
+	 * @param OutThreats
+	 * @return false if the cover point isn't in range of any threat
+	 */
+	bool GetCoverPointThreats(const FCoverHandle& Handle, FCoverPointThreats& OutThreats) const;
+
+	/**
+	 * @brief the cover in the area changed, the threats in range of it are recomputed on their next update or by UpdateDirtyThreats
+	 * @param Area
+	 */
+	void InvalidateArea(const FBox& Area);
+
+	/**
+	 * @brief recompute the threats whose cover changed, so threats that don't move aren't left with stale exposure.
+	 * Called by the nav mesh once per frame after committing the regenerated tiles, must not be called with the cover data lock held
+	 */
+	void UpdateDirtyThreats();
+
+	SIZE_T GetAllocatedSize() const;
+
+protected:
+	struct FThreat
+	{
+		// Location the exposed polys were computed from
+		FVector Location;
+
+		TArray<NavNodeRef> ExposedPolys;
+
+		// Handle ids of the cover points in range, the first NumExposedCoverPoints are exposed
+		TArray<uint32> CoverPointsInRange;
+
+		int32 NumExposedCoverPoints;
+
+		// The cover in range changed since ExposedPolys were computed
+		bool bDirty;
+	};
+
+	/**
+	 * @brief find the polys and cover points in range of the threat's location and which of them are exposed to it
+	 * @param OutThreat Location must be set
+	 */
+	void ComputeExposure(FThreat& OutThreat) const;
+
+	// not thread-safe
+	void AddExposure(const FThreat& Threat);
+
+	// not thread-safe
+	void RemoveExposure(const FThreat& Threat);
+
+	class ACoverRecastNavMesh* NavMesh;
+
+	float Range;
+
+	float UpdateDistance;
+
+	mutable FRWLock ThreatsLock;
+
+	TMap<int32, FThreat> Threats;
+
+	int32 NextThreatId;
+
+	// Number of threats each poly is exposed to, polys exposed to none aren't stored
+	TMap<NavNodeRef, int32> PolyExposedThreats;
+
+	// Threat counts of the cover points in range of at least one threat, by handle id
+	TMap<uint32, FCoverPointThreats> CoverPointThreats;
+};
@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CoverOctree.h"
+
+enum class ECoverVisibility : uint8
+{
+	Unknown,	//not in the table, i.e. out of range, not built yet or the table doesn't match the requested height/channel
+	Visible,	//line of sight between the cover points
+	Hidden		//line of sight blocked
+};
+
+/**
+ * Visibility from a cover point to the cover points within range of it.
+ * Two bits per neighbour, line of sight from this point's standing and crouch height to the neighbour's standing height.
+ */
+struct FCoverVisibilityRow
+{
+public:
+	// Handle ids of the neighbours, sorted
+	TArray<uint32> NeighbourIds;
+
+	// Bits 2 * i and 2 * i + 1 are the standing and crouch visibility of NeighbourIds[i]
+	TBitArray<> VisibilityBits;
+
+	/**
+	 * @brief add or update a neighbour
+	 * @param NeighbourId 
+	 * @param bStandingVisible line of sight from this point's standing height
+	 * @param bCrouchVisible line of sight from this point's crouch height
+	 */
+	void Set(uint32 NeighbourId, bool bStandingVisible, bool bCrouchVisible);
+
+	void Remove(uint32 NeighbourId);
+
+	bool Contains(uint32 NeighbourId) const;
+
+	ECoverVisibility Get(uint32 NeighbourId, ECoverHeight FromHeight) const;
+};
+
+/**
+ * Sparse, precomputed cover point to cover point visibility, used to answer line of sight queries between cover points without tracing.
+ * Targets are snapped to their nearest cover point to use it.
+ * Rows are traced on a background task as cover points are added, and removed with their cover points,
+ * so only the tiles whose cover changed are rebuilt.
+ * Thread-safe.
+ */
+class NAVIGATIONCOVERSYSTEM_API FCoverVisibilityTable
+{
+public:
+	FCoverVisibilityTable();
+
+	~FCoverVisibilityTable();
+
+	/**
+	 * @brief start accepting cover points
+	 * @param InNavMesh the nav mesh that owns the cover points, used to find the neighbours and for tracing
+	 * @param InRange max distance between two cover points in the table
+	 * @param InTraceChannel channel to trace the line of sight on
+	 */
+	void Init(class ACoverRecastNavMesh* InNavMesh, float InRange, ECollisionChannel InTraceChannel);
+
+	/**
+	 * @brief clear the table and stop accepting cover points, waits for the running build task to stop
+	 */
+	void Reset();
+
+	bool IsEnabled() const { return NavMesh != nullptr; }
+
+	/**
+	 * @brief queue newly added cover points, their rows and their entries in the neighbours' rows are traced on a background task
+	 * @param CoverPoints 
+	 */
+	void AddCoverPoints(const TArray<FCoverPointOctreeElement>& CoverPoints);
+
+	/**
+	 * @brief remove the rows of the cover points and their entries from the neighbours' rows
+	 * @param Handles 
+	 */
+	void RemoveCoverPoints(const TArray<FCoverHandle>& Handles);
+
+	/**
+	 * @brief look up the line of sight from a cover point to the standing height of another
+	 * @param From 
+	 * @param To 
+	 * @param FromHeight height above the ground at From, must be within HeightTolerance of the standing or crouch height of the table
+	 * @param HeightTolerance 
+	 * @param TraceChannel must match the channel the table was traced on
+	 * @return Unknown if the pair isn't in the table or the height/channel don't match
+	 */
+	ECoverVisibility GetVisibility(const FCoverHandle& From, const FCoverHandle& To, float FromHeight, float HeightTolerance, ECollisionChannel TraceChannel) const;
+
+	/**
+	 * @brief Memory used by the rows
+	 */
+	SIZE_T GetAllocatedSize() const;
+
+protected:
+	friend class FCoverVisibilityTableBuildTask;
+
+	/**
+	 * @brief trace the rows of the pending cover points until there are none left, called from the build task
+	 */
+	void BuildPendingCoverPoints();
+
+	/**
+	 * @brief trace the row of the cover point, and its entry in the neighbours' rows
+	 * @param CoverPoint 
+	 */
+	void BuildCoverPoint(const FCoverPointOctreeElement& CoverPoint);
+
+	/**
+	 * @brief start the build task if it isn't running and there are pending cover points
+	 */
+	void StartBuildTask();
+
+	class ACoverRecastNavMesh* NavMesh;
+
+	float Range;
+
+	// Heights above the ground the table was traced at, see UCoverSystemStatics
+	float StandingHeight;
+	float CrouchHeight;
+
+	ECollisionChannel TraceChannel;
+
+	mutable FRWLock RowsLock;
+
+	TMap<FCoverHandle, FCoverVisibilityRow> Rows;
+
+	// Cover points that have been added and not removed yet, guarded by RowsLock
+	TSet<FCoverHandle> LiveHandles;
+
+	FCriticalSection PendingLock;
+
+	TArray<FCoverPointOctreeElement> PendingCoverPoints;
+
+	// Only one build task runs at a time, guarded by PendingLock
+	bool bBuildTaskRunning;
+
+	FThreadSafeBool bCancelBuild;
+};
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "CoverOctree.h"
+#include "CoverNavMeshTileSnapshot.h"
 
 /**
  * 
@@ -15,7 +16,8 @@ class FNavmeshCoverPointGeneratorAsyncTask : public FNonAbandonableTask
 	FNavmeshCoverPointGeneratorAsyncTask();
 	
 	FNavmeshCoverPointGeneratorAsyncTask(float InCoverPointMinDistance,	float InSmallestAgentHeight, float InCoverPointGroundOffset,
-		FBox InMapBounds, int32 InNavmeshTileIndex, class ACoverRecastNavMesh* InNav);
+		FBox InMapBounds, const TSharedRef<const FCoverNavMeshTileSnapshot, ESPMode::ThreadSafe>& InSnapshot, const TArray<FBox>& InDirtyAreas,
+		uint32 InGeneration, class ACoverRecastNavMesh* InNav);
 	
 private:
 	// Minimum distance between cover points.
@@ -36,6 +38,24 @@ private:
 	// Height of the smallest actor that will ever fit under an overhanging cover. Should normally be the CROUCHED height of the smallest actor in the game. Not counting bunnies. Bunnies are useless.
 	const float SmallestAgentHeight;
 
+	// Height above the ground the cover needs to reach to protect a standing agent. See UCoverSystemStatics::StandingCoverHeight
+	const float StandingCoverHeight;
+
+	// Height above the ground used for the crouch protection masks. See UCoverSystemStatics::CrouchCoverHeight
+	const float CrouchCoverHeight;
+
+	// How far an agent leans out of cover. See UCoverSystemStatics::CoverLeanOffset
+	const float CoverLeanOffset;
+
+	// Whether to sweep the directional protection masks of each cover point. See ACoverRecastNavMesh::bGenerateCoverProtectionMasks
+	const bool bGenerateProtectionMasks;
+
+	// How close the cover object must be to protect a direction. See UCoverSystemStatics::CoverProtectionDistance
+	const float CoverProtectionDistance;
+
+	// How far behind the cover point the standing height is traced. Same reach as the protection masks and the cover test's sweep
+	const float HeightTraceDistance;
+
 	// A small Z-axis offset applied to each cover point. This is to prevent small irregularities in the navmesh from registering as cover.
 	const float CoverPointGroundOffset;
 
@@ -49,6 +69,15 @@ private:
 	// The bounding box to generate cover points in.
 	const int32 NavmeshTileIndex;
 
+	// Copy of the tile taken when it was rebuilt, the polys and navmesh projections are read from it instead of the live navmesh.
+	const TSharedPtr<const FCoverNavMeshTileSnapshot, ESPMode::ThreadSafe> Snapshot;
+
+	// Areas of the tile that need regenerating, already expanded by the margin. Empty to regenerate the whole tile.
+	const TArray<FBox> DirtyAreas;
+
+	// FCoverTileCommit::Generation of the commit, stamped by the nav mesh when the task was launched
+	const uint32 Generation;
+
 	// The nav mesh that called this.
 	class ACoverRecastNavMesh* NavRef;
 
@@ -58,6 +87,21 @@ private:
 
 	FVector GetEdgeDir(const FVector& EdgeStartVertex, const FVector& EdgeEndVertex) const;
 
+	/**
+	 * @brief check if the edge needs to be processed, i.e. it intersects one of the dirty areas
+	 * @param EdgeStartVertex 
+	 * @param EdgeEndVertex 
+	 * @return true if the whole tile is being regenerated or the edge intersects a dirty area
+	 */
+	bool IsEdgeDirty(const FVector& EdgeStartVertex, const FVector& EdgeEndVertex) const;
+
+	/**
+	 * @brief find the new NodeRefs of the tile's cover points which are kept during a partial regeneration
+	 * @param NavMeshTileArea the AABB of the tile
+	 * @param OutNodeRefs cover point location to new NodeRef
+	 */
+	void GetKeptCoverPointNodeRefs(const FBox& NavMeshTileArea, TArray<TPair<FVector, NavNodeRef>>& OutNodeRefs) const;
+
 	// Uses navmesh ray casts to scan for cover from TraceStart to TraceEnd.
 	// Builds an FDataTransferObjectCoverData for transferring the results over to the cover octree.
 	// Returns true if cover was found, false if not.
@@ -73,6 +117,23 @@ private:
 	 */
 	bool ScanForCoverNavMeshProjection(FDataTransferObjectCoverData& OutCoverData, const NavNodeRef& NodeRef, const FVector& TraceStart, const FVector& TraceDirection) const;
 
+	/**
+	 * @brief Traces the static data of a cover point, so it doesn't need to be traced again at query time
+	 * @param CoverLocation location of the cover point, offset from the ground by CoverPointGroundOffset
+	 * @param FacingNormal direction from the cover object towards the cover point on the XY plane
+	 * @param bCliffEdge the cover point is on the edge of a cliff instead of next to a cover object
+	 * @return cover height and lean availability, lean availability is only traced for standing cover
+	 */
+	FCoverPointMetadata GenerateCoverMetadata(const FVector& CoverLocation, const FVector& FacingNormal, bool bCliffEdge) const;
+
+	/**
+	 * @brief Sweeps each yaw sector around the cover point at crouch and standing height and stores which ones the cover object protects
+	 * @param Metadata the metadata of the cover point, the standing masks are only generated for standing cover
+	 * @param CoverLocation location of the cover point, offset from the ground by CoverPointGroundOffset
+	 * @param CoverObject the object that generated the cover point
+	 */
+	void GenerateProtectionMasks(FCoverPointMetadata& Metadata, const FVector& CoverLocation, const AActor* CoverObject) const;
+
 	/**
 	 * @brief check for cover on either side of the edge
 	 * @param OutCoverPointsOfActors